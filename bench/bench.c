@@ -0,0 +1,247 @@
+#include "bench.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MIN_BENCH_NS 200000000LL
+#define MAX_RESULTS 256
+#define NAME_LEN 96
+
+typedef struct
+{
+    char name[NAME_LEN];
+    double ns_per_op;
+    long iters;
+} BenchResult;
+
+static BenchResult results[MAX_RESULTS];
+static int result_count = 0;
+static const char* name_filter = NULL;
+static int saved_stdout = -1;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void bench_silence_stdout(int silence)
+{
+    fflush(stdout);
+    if (silence && saved_stdout < 0) {
+        saved_stdout = dup(STDOUT_FILENO);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+    } else if (!silence && saved_stdout >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        saved_stdout = -1;
+    }
+}
+
+static long long timed_batch(BenchFn fn, BenchResetFn reset, void* arg, long iters)
+{
+    bench_silence_stdout(1);
+    if (reset)
+        reset(arg);
+    long long start = now_ns();
+    fn(iters, arg);
+    long long elapsed = now_ns() - start;
+    bench_silence_stdout(0);
+    return elapsed;
+}
+
+static void record_result(const char* name, long long elapsed, long iters)
+{
+    BenchResult* r = &results[result_count++];
+    snprintf(r->name, NAME_LEN, "%s", name);
+    r->ns_per_op = (double)elapsed / iters;
+    r->iters = iters;
+    printf("%s\t%.1f\t%ld\n", r->name, r->ns_per_op, r->iters);
+    fflush(stdout);
+}
+
+// Grows the batch until it runs for MIN_BENCH_NS. Batches capped by
+// max_iters are repeated (each after a reset) until the time is reached.
+void bench_run_with_reset(const char* name, BenchFn fn, BenchResetFn reset, void* arg, long max_iters)
+{
+    if (name_filter && !strstr(name, name_filter))
+        return;
+    if (result_count >= MAX_RESULTS)
+        return;
+
+    long iters = 1;
+    long long elapsed = 0;
+    while (1) {
+        elapsed = timed_batch(fn, reset, arg, iters);
+        if (elapsed >= MIN_BENCH_NS || (max_iters > 0 && iters >= max_iters))
+            break;
+        long next = iters * 2;
+        if (elapsed > 0 && elapsed < MIN_BENCH_NS / 2)
+            next = (long)(iters * (double)MIN_BENCH_NS / elapsed * 1.2);
+        if (max_iters > 0 && next > max_iters)
+            next = max_iters;
+        iters = next > iters ? next : iters + 1;
+    }
+
+    long total_iters = iters;
+    while (elapsed < MIN_BENCH_NS) {
+        elapsed += timed_batch(fn, reset, arg, iters);
+        total_iters += iters;
+    }
+    record_result(name, elapsed, total_iters);
+}
+
+void bench_run(const char* name, BenchFn fn, void* arg, long max_iters)
+{
+    bench_run_with_reset(name, fn, NULL, arg, max_iters);
+}
+
+cJSON* bench_make_question_bank(int count)
+{
+    static const char* stems[] = {
+        "Which of the following statements about TCP congestion control is correct when packet loss is detected?",
+        "Thủ đô của Việt Nam là gì? Chọn đáp án đúng nhất trong các phương án dưới đây.",
+        "Given the function f(x) = 3x^2 - 2x + 1, what is the value of the derivative at x = 2?",
+        "In the C language, what does the \"static\" keyword mean for a variable declared at file scope?",
+    };
+    cJSON* bank = cJSON_CreateArray();
+    for (int i = 0; i < count; i++) {
+        char text[256];
+        snprintf(text, sizeof(text), "Q%d. %s", i + 1, stems[i % 4]);
+        cJSON* q = cJSON_CreateObject();
+        cJSON_AddStringToObject(q, "question", text);
+        cJSON* options = cJSON_AddArrayToObject(q, "options");
+        for (int k = 0; k < 4; k++) {
+            char option[64];
+            snprintf(option, sizeof(option), "Option %c for question %d", 'A' + k, i + 1);
+            cJSON_AddItemToArray(options, cJSON_CreateString(option));
+        }
+        cJSON_AddNumberToObject(q, "correct_index", i % 4);
+        cJSON_AddItemToArray(bank, q);
+    }
+    return bank;
+}
+
+static int load_baseline(const char* path, BenchResult* base, int max)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        return -1;
+
+    int count = 0;
+    char line[256];
+    while (count < max && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#')
+            continue;
+        char* name = strtok(line, "\t");
+        char* ns = strtok(NULL, "\t");
+        if (!name || !ns)
+            continue;
+        snprintf(base[count].name, NAME_LEN, "%s", name);
+        base[count].ns_per_op = atof(ns);
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+// Prints the delta against a stored run; returns the number of regressions
+static int compare_with_baseline(const char* path, double threshold_pct)
+{
+    static BenchResult base[MAX_RESULTS];
+    int base_count = load_baseline(path, base, MAX_RESULTS);
+    if (base_count < 0) {
+        fprintf(stderr, "Cannot read baseline %s\n", path);
+        return -1;
+    }
+
+    int regressions = 0;
+    printf("# compare\tbaseline_ns\tcurrent_ns\tdelta_pct\tverdict\n");
+    for (int i = 0; i < result_count; i++) {
+        const BenchResult* cur = &results[i];
+        const BenchResult* old = NULL;
+        for (int j = 0; j < base_count; j++) {
+            if (strcmp(base[j].name, cur->name) == 0) {
+                old = &base[j];
+                break;
+            }
+        }
+        if (!old || old->ns_per_op <= 0) {
+            printf("%s\t-\t%.1f\t-\tnew\n", cur->name, cur->ns_per_op);
+            continue;
+        }
+        double delta = (cur->ns_per_op - old->ns_per_op) / old->ns_per_op * 100.0;
+        const char* verdict = "ok";
+        if (delta > threshold_pct) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (delta < -threshold_pct) {
+            verdict = "faster";
+        }
+        printf("%s\t%.1f\t%.1f\t%+.1f\t%s\n", cur->name, old->ns_per_op, cur->ns_per_op, delta, verdict);
+    }
+    return regressions;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-f filter] [-o output.tsv] [-c baseline.tsv] [-t threshold_pct]\n"
+            "  -f filter     only run benchmarks whose name contains filter\n"
+            "  -o file       also write results as TSV (use to store a baseline)\n"
+            "  -c file       compare against a stored baseline, exit 1 on regression\n"
+            "  -t pct        regression threshold in percent (default 10)\n",
+            prog);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* output_path = NULL;
+    const char* baseline_path = NULL;
+    double threshold = 10.0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:o:c:t:h")) != -1) {
+        switch (opt) {
+        case 'f': name_filter = optarg; break;
+        case 'o': output_path = optarg; break;
+        case 'c': baseline_path = optarg; break;
+        case 't': threshold = atof(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    printf("# name\tns_per_op\titers\n");
+    run_codec_benchmarks();
+    run_net_benchmarks();
+    run_storage_benchmarks();
+    run_auth_benchmarks();
+    run_engine_benchmarks();
+
+    if (output_path) {
+        FILE* f = fopen(output_path, "w");
+        if (!f) {
+            perror(output_path);
+            return 1;
+        }
+        fprintf(f, "# name\tns_per_op\titers\n");
+        for (int i = 0; i < result_count; i++)
+            fprintf(f, "%s\t%.1f\t%ld\n", results[i].name, results[i].ns_per_op, results[i].iters);
+        fclose(f);
+    }
+
+    if (baseline_path) {
+        int regressions = compare_with_baseline(baseline_path, threshold);
+        if (regressions != 0)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "cJSON.h"
+
+// fn runs the measured operation iters times; arg is passed through.
+typedef void (*BenchFn)(long iters, void* arg);
+// reset restores fixture state before every timed batch, outside the timing
+typedef void (*BenchResetFn)(void* arg);
+
+void bench_run(const char* name, BenchFn fn, void* arg, long max_iters);
+void bench_run_with_reset(const char* name, BenchFn fn, BenchResetFn reset, void* arg, long max_iters);
+void bench_silence_stdout(int silence);
+
+// Realistic question bank with the shape the client imports
+cJSON* bench_make_question_bank(int count);
+
+void run_codec_benchmarks(void);
+void run_net_benchmarks(void);
+void run_storage_benchmarks(void);
+void run_auth_benchmarks(void);
+void run_engine_benchmarks(void);
+
+#endif
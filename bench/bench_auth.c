@@ -0,0 +1,96 @@
+#define _GNU_SOURCE
+#include "auth_pool.h"
+#include "bench.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_BATCH 64
+#define POOL_ITERATIONS 1000
+
+typedef struct
+{
+    unsigned long iterations;
+    char stored[PASSWORD_HASH_MAX];
+} AuthCase;
+
+static void bench_password_hash(long iters, void* arg)
+{
+    AuthCase* c = arg;
+    for (long i = 0; i < iters; i++) {
+        if (password_hash("correct horse battery staple", c->iterations, c->stored) != 0)
+            abort();
+    }
+}
+
+static void bench_password_verify(long iters, void* arg)
+{
+    AuthCase* c = arg;
+    for (long i = 0; i < iters; i++) {
+        if (!password_verify("correct horse battery staple", c->stored))
+            abort();
+    }
+}
+
+// Verifications go out in batches, like a burst of logins, and each batch is
+// waited for through the wakeup fd as the event loop would
+static void bench_pool_verify(long iters, void* arg)
+{
+    AuthCase* c = arg;
+    long done = 0;
+    while (done < iters) {
+        int batch = iters - done < POOL_BATCH ? (int)(iters - done) : POOL_BATCH;
+        for (int i = 0; i < batch; i++) {
+            AuthJob* job = auth_job_new(AUTH_VERIFY, i, 0, "student", "correct horse battery staple");
+            memcpy(job->stored, c->stored, sizeof(job->stored));
+            if (auth_pool_submit(job) != 0)
+                abort();
+        }
+        int pending = batch;
+        struct pollfd pfd = { auth_pool_fd(), POLLIN, 0 };
+        while (pending > 0) {
+            poll(&pfd, 1, -1);
+            for (AuthJob* job = auth_pool_take_done(); job;) {
+                AuthJob* next = job->next;
+                if (!job->ok)
+                    abort();
+                auth_job_free(job);
+                job = next;
+                pending--;
+            }
+        }
+        done += batch;
+    }
+}
+
+void run_auth_benchmarks(void)
+{
+    static const unsigned long iteration_counts[] = { 1000, PASSWORD_DEFAULT_ITERATIONS };
+    static const char* worker_counts[] = { "1", "4" };
+    char name[96];
+    AuthCase c;
+
+    for (size_t i = 0; i < sizeof(iteration_counts) / sizeof(iteration_counts[0]); i++) {
+        c.iterations = iteration_counts[i];
+        snprintf(name, sizeof(name), "auth/password_hash/iterations_%lu", c.iterations);
+        bench_run(name, bench_password_hash, &c, 0);
+        snprintf(name, sizeof(name), "auth/password_verify/iterations_%lu", c.iterations);
+        bench_run(name, bench_password_verify, &c, 0);
+    }
+
+    c.iterations = POOL_ITERATIONS;
+    password_hash("correct horse battery staple", c.iterations, c.stored);
+    for (size_t i = 0; i < sizeof(worker_counts) / sizeof(worker_counts[0]); i++) {
+        setenv("QUIZZIE_AUTH_WORKERS", worker_counts[i], 1);
+        bench_silence_stdout(1);
+        int rc = auth_pool_start();
+        bench_silence_stdout(0);
+        if (rc != 0)
+            continue;
+        snprintf(name, sizeof(name), "auth/pool_verify/workers_%s", worker_counts[i]);
+        bench_run(name, bench_pool_verify, &c, 0);
+        auth_pool_stop();
+    }
+    unsetenv("QUIZZIE_AUTH_WORKERS");
+}
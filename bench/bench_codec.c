@@ -0,0 +1,155 @@
+#include "bench.h"
+#include "json_keys.h"
+#include "json_writer.h"
+#include "protocol.h"
+#include "request.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    cJSON* tree;
+    char* text;
+    size_t text_len;
+} CodecCase;
+
+static void bench_parse(long iters, void* arg)
+{
+    CodecCase* c = arg;
+    for (long i = 0; i < iters; i++)
+        cJSON_Delete(cJSON_Parse(c->text));
+}
+
+static void bench_parse_insitu(long iters, void* arg)
+{
+    CodecCase* c = arg;
+    for (long i = 0; i < iters; i++) {
+        // In-situ parsing consumes its buffer, so the copy is part of the cost
+        char* buffer = cJSON_malloc(c->text_len);
+        memcpy(buffer, c->text, c->text_len);
+        cJSON_Delete(cJSON_ParseInSitu(buffer, c->text_len));
+    }
+}
+
+static void bench_print_unformatted(long iters, void* arg)
+{
+    CodecCase* c = arg;
+    for (long i = 0; i < iters; i++)
+        free(cJSON_PrintUnformatted(c->tree));
+}
+
+static void bench_json_writer(long iters, void* arg)
+{
+    CodecCase* c = arg;
+    JsonWriter w;
+    json_writer_init(&w);
+    for (long i = 0; i < iters; i++) {
+        json_writer_begin_frame(&w, MSG_TYPE_RES);
+        json_writer_item(&w, c->tree);
+    }
+    json_writer_free(&w);
+}
+
+static void bench_print_formatted(long iters, void* arg)
+{
+    CodecCase* c = arg;
+    for (long i = 0; i < iters; i++)
+        free(cJSON_Print(c->tree));
+}
+
+static const char* create_room_request = "{\"action\":\"CREATE_ROOM\",\"data\":{\"room_name\":\"Midterm\","
+                                         "\"start_time\":1700000000,\"end_time\":1700005400,\"question_bank_id\":\"bank_1\","
+                                         "\"num_questions\":40,\"allowed_attempts\":1}}";
+
+// The seven lookups handle_create_room does, by name and by precomputed hash
+static void bench_lookup_by_name(long iters, void* arg)
+{
+    cJSON* req = arg;
+    for (long i = 0; i < iters; i++) {
+        cJSON* data = cJSON_GetObjectItem(req, JSON_KEY_DATA);
+        cJSON_GetObjectItem(data, JSON_KEY_ROOM_NAME);
+        cJSON_GetObjectItem(data, JSON_KEY_START_TIME);
+        cJSON_GetObjectItem(data, JSON_KEY_END_TIME);
+        cJSON_GetObjectItem(data, JSON_KEY_QUESTION_BANK_ID);
+        cJSON_GetObjectItem(data, JSON_KEY_NUM_QUESTIONS);
+        cJSON_GetObjectItem(data, JSON_KEY_ALLOWED_ATTEMPTS);
+    }
+}
+
+static void bench_lookup_hashed(long iters, void* arg)
+{
+    cJSON* req = arg;
+    for (long i = 0; i < iters; i++) {
+        cJSON* data = json_get(req, KEY_DATA);
+        json_get(data, KEY_ROOM_NAME);
+        json_get(data, KEY_START_TIME);
+        json_get(data, KEY_END_TIME);
+        json_get(data, KEY_QUESTION_BANK_ID);
+        json_get(data, KEY_NUM_QUESTIONS);
+        json_get(data, KEY_ALLOWED_ATTEMPTS);
+    }
+}
+
+// One pass over data filling a Room, validation and defaults included
+static void bench_decode_schema(long iters, void* arg)
+{
+    cJSON* req = arg;
+    Room room;
+    for (long i = 0; i < iters; i++)
+        request_decode(&create_room_schema, json_get(req, KEY_DATA), &room);
+}
+
+// Shaped like a GET_ROOM_STATS payload: integers plus a few fractional averages
+static cJSON* make_results(int count)
+{
+    cJSON* results = cJSON_CreateArray();
+    for (int i = 0; i < count; i++) {
+        cJSON* obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(obj, "username", "student");
+        cJSON_AddNumberToObject(obj, "score", i % 41);
+        cJSON_AddNumberToObject(obj, "timestamp", 1700000000 + i);
+        cJSON_AddNumberToObject(obj, "average_score", (i % 41) / 3.0);
+        cJSON_AddItemToArray(results, obj);
+    }
+    return results;
+}
+
+void run_codec_benchmarks(void)
+{
+    cJSON* req = cJSON_Parse(create_room_request);
+    bench_run("codec/lookup/by_name", bench_lookup_by_name, req, 0);
+    bench_run("codec/lookup/hashed", bench_lookup_hashed, req, 0);
+    bench_run("codec/lookup/schema_decode", bench_decode_schema, req, 0);
+    cJSON_Delete(req);
+
+    CodecCase numbers;
+    numbers.tree = make_results(1000);
+    bench_run("codec/print_unformatted/results_1000", bench_print_unformatted, &numbers, 0);
+    bench_run("codec/json_writer/results_1000", bench_json_writer, &numbers, 0);
+    cJSON_Delete(numbers.tree);
+
+    static const int sizes[] = { 10, 1000, 10000 };
+    char name[96];
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        CodecCase c;
+        c.tree = bench_make_question_bank(sizes[i]);
+        c.text = cJSON_PrintUnformatted(c.tree);
+        c.text_len = strlen(c.text);
+
+        snprintf(name, sizeof(name), "codec/parse/bank_%d", sizes[i]);
+        bench_run(name, bench_parse, &c, 0);
+        snprintf(name, sizeof(name), "codec/parse_insitu/bank_%d", sizes[i]);
+        bench_run(name, bench_parse_insitu, &c, 0);
+        snprintf(name, sizeof(name), "codec/print_unformatted/bank_%d", sizes[i]);
+        bench_run(name, bench_print_unformatted, &c, 0);
+        snprintf(name, sizeof(name), "codec/json_writer/bank_%d", sizes[i]);
+        bench_run(name, bench_json_writer, &c, 0);
+        snprintf(name, sizeof(name), "codec/print/bank_%d", sizes[i]);
+        bench_run(name, bench_print_formatted, &c, 0);
+
+        free(c.text);
+        cJSON_Delete(c.tree);
+    }
+}
@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+#include "bench.h"
+#include "qbk.h"
+#include "storage_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The same workload through each storage engine's vtable, each in a fresh
+// data directory, without storage.c's caches in front
+#define ENGINE_ROOM_ID "room_bench"
+#define ENGINE_USERS 10000
+#define ENGINE_RESULTS 10000
+#define ENGINE_SNAPSHOT_BATCH 100
+
+typedef struct
+{
+    const StorageEngine* engine;
+    Room room;
+    RoomResult* results;
+    long next_seq;
+    char bank_id[64];
+} EngineCase;
+
+static void fill_results(EngineCase* c, int count)
+{
+    for (int i = 0; i < count; i++) {
+        RoomResult* r = &c->results[i];
+        memset(r, 0, sizeof(*r));
+        strcpy(r->room_id, ENGINE_ROOM_ID);
+        snprintf(r->username, sizeof(r->username), "student_%05ld", c->next_seq % 100000);
+        r->score = (int)(c->next_seq % 41);
+        r->timestamp = 1700000000L + c->next_seq;
+        r->seq = ++c->next_seq;
+    }
+}
+
+// bank, if given, is stored by the same snapshot
+static int write_snapshot(EngineCase* c, int count, const StorageBankChange* bank)
+{
+    fill_results(c, count);
+    StorageSnapshot snapshot = {
+        .lsn = (uint64_t)c->next_seq,
+        .rooms = &c->room,
+        .room_count = 1,
+        .results = c->results,
+        .result_count = count,
+        .banks = bank,
+        .bank_count = bank ? 1 : 0,
+    };
+    void* job = c->engine->prepare_snapshot(&snapshot);
+    if (!job)
+        return -1;
+    int rc = c->engine->write_snapshot(job);
+    c->engine->free_snapshot(job);
+    return rc;
+}
+
+// One snapshot thread pass: the room plus a batch of new results, durably
+static void bench_snapshot(long iters, void* arg)
+{
+    EngineCase* c = arg;
+    for (long i = 0; i < iters; i++)
+        if (write_snapshot(c, ENGINE_SNAPSHOT_BATCH, NULL) != 0)
+            abort();
+}
+
+static void count_result(const RoomResult* result, void* ctx)
+{
+    (void)result;
+    (*(long*)ctx)++;
+}
+
+static void bench_for_each_result(long iters, void* arg)
+{
+    EngineCase* c = arg;
+    long count = 0;
+    for (long i = 0; i < iters; i++)
+        c->engine->for_each_result(ENGINE_ROOM_ID, count_result, &count);
+}
+
+static int count_users(const StorageUser* users, int count, int expected, void* ctx)
+{
+    (void)users;
+    (void)expected;
+    *(long*)ctx += count;
+    return 0;
+}
+
+static void bench_load_users(long iters, void* arg)
+{
+    EngineCase* c = arg;
+    long count = 0;
+    for (long i = 0; i < iters; i++)
+        c->engine->load_users(count_users, &count);
+}
+
+// A bank cache miss: fetch the bytes and hand them back
+static void bench_load_bank(long iters, void* arg)
+{
+    EngineCase* c = arg;
+    StorageBank bank;
+    for (long i = 0; i < iters; i++) {
+        if (c->engine->load_bank(c->bank_id, &bank) != 0)
+            abort();
+        c->engine->release_bank(&bank);
+    }
+}
+
+static void write_users_file(int count)
+{
+    FILE* f = fopen("data/users.txt", "w");
+    if (!f)
+        return;
+    for (int i = 0; i < count; i++)
+        fprintf(f, "student_%07d:secret:participant\n", i);
+    fclose(f);
+}
+
+static void run_engine(const StorageEngine* engine, const char* bank, size_t bank_size)
+{
+    char name[96];
+    char dir[] = "/tmp/quizzie-engine-XXXXXX";
+    char cwd[512];
+    if (!getcwd(cwd, sizeof(cwd)) || !mkdtemp(dir) || chdir(dir) != 0) {
+        perror("engine bench setup");
+        return;
+    }
+
+    // Users come in the way a deployment's first start brings them
+    mkdir("data", 0777);
+    write_users_file(ENGINE_USERS);
+    bench_silence_stdout(1);
+    int rc = engine->open();
+    bench_silence_stdout(0);
+    if (rc != 0) {
+        fprintf(stderr, "Could not open the %s engine\n", engine->name);
+        goto out;
+    }
+
+    EngineCase c;
+    memset(&c, 0, sizeof(c));
+    c.engine = engine;
+    c.results = calloc(ENGINE_RESULTS, sizeof(RoomResult));
+    strcpy(c.room.id, ENGINE_ROOM_ID);
+    strcpy(c.room.name, "Engine bench");
+    strcpy(c.room.status, "OPEN");
+    strcpy(c.room.question_bank_id, "engine_bank");
+    c.room.num_questions = 40;
+    c.room.allowed_attempts = 1;
+    strcpy(c.bank_id, "engine_bank");
+    StorageBankChange bank_change = { c.bank_id, bank, bank_size };
+    if (!c.results || write_snapshot(&c, ENGINE_RESULTS, &bank_change) != 0) {
+        fprintf(stderr, "Could not fill the %s engine\n", engine->name);
+        free(c.results);
+        engine->close();
+        goto out;
+    }
+
+    snprintf(name, sizeof(name), "engine/%s/load_users/users_%d", engine->name, ENGINE_USERS);
+    bench_run(name, bench_load_users, &c, 0);
+    snprintf(name, sizeof(name), "engine/%s/for_each_result/results_%d", engine->name, ENGINE_RESULTS);
+    bench_run(name, bench_for_each_result, &c, 0);
+    snprintf(name, sizeof(name), "engine/%s/load_bank/bank_1000", engine->name);
+    bench_run(name, bench_load_bank, &c, 0);
+    // Every pass grows the stored results, so passes are capped
+    snprintf(name, sizeof(name), "engine/%s/snapshot/batch_%d", engine->name, ENGINE_SNAPSHOT_BATCH);
+    bench_run(name, bench_snapshot, &c, 64);
+
+    engine->close();
+    free(c.results);
+
+out:
+    if (chdir(cwd) == 0) {
+        char cmd[600];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+        if (system(cmd) != 0)
+            fprintf(stderr, "Failed to clean up %s\n", dir);
+    }
+}
+
+void run_engine_benchmarks(void)
+{
+    cJSON* questions = bench_make_question_bank(1000);
+    size_t size = 0;
+    char* bank = qbk_encode(questions, &size);
+    cJSON_Delete(questions);
+    if (!bank)
+        return;
+    run_engine(&storage_engine_files, bank, size);
+    run_engine(&storage_engine_paged, bank, size);
+#ifdef QUIZZIE_SQLITE
+    run_engine(&storage_engine_sqlite, bank, size);
+#endif
+    free(bank);
+}
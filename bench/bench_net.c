@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef struct
+{
+    int fds[2];
+    cJSON* payload;
+} FramingCase;
+
+// One request/response leg: frame, write, read back and parse
+static void bench_round_trip(long iters, void* arg)
+{
+    FramingCase* c = arg;
+    char msg_type[4];
+    for (long i = 0; i < iters; i++) {
+        cJSON* received = NULL;
+        if (send_packet(c->fds[0], MSG_TYPE_RES, c->payload) != 0)
+            abort();
+        if (receive_packet(c->fds[1], msg_type, &received) != 0)
+            abort();
+        cJSON_Delete(received);
+    }
+}
+
+static cJSON* make_login_request(void)
+{
+    cJSON* req = cJSON_CreateObject();
+    cJSON_AddStringToObject(req, JSON_KEY_ACTION, ACTION_LOGIN);
+    cJSON* data = cJSON_AddObjectToObject(req, JSON_KEY_DATA);
+    cJSON_AddStringToObject(data, JSON_KEY_USERNAME, "participant_00042");
+    cJSON_AddStringToObject(data, JSON_KEY_PASSWORD, "correct horse battery staple");
+    return req;
+}
+
+static cJSON* make_bank_response(int questions)
+{
+    cJSON* resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "SUCCESS");
+    cJSON_AddItemToObject(resp, JSON_KEY_DATA, bench_make_question_bank(questions));
+    return resp;
+}
+
+void run_net_benchmarks(void)
+{
+    FramingCase c;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, c.fds) != 0) {
+        perror("socketpair");
+        return;
+    }
+    // The whole frame must fit in the socket buffer since one thread does both ends
+    int buf_size = 4 * MAX_PAYLOAD_SIZE;
+    setsockopt(c.fds[0], SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+    setsockopt(c.fds[1], SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+
+    c.payload = make_login_request();
+    bench_run("net/round_trip/login_request", bench_round_trip, &c, 0);
+    cJSON_Delete(c.payload);
+
+    c.payload = make_bank_response(10);
+    bench_run("net/round_trip/bank_10", bench_round_trip, &c, 0);
+    cJSON_Delete(c.payload);
+
+    c.payload = make_bank_response(400);
+    bench_run("net/round_trip/bank_400", bench_round_trip, &c, 0);
+    cJSON_Delete(c.payload);
+
+    close(c.fds[0]);
+    close(c.fds[1]);
+}
@@ -0,0 +1,476 @@
+#define _GNU_SOURCE
+#include "bench.h"
+#include "journal.h"
+#include "storage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BENCH_ROOMS_FILE "data/rooms.json"
+#define BENCH_RESULTS_DIR "data/results/"
+#define BENCH_ROOM_ID "room_bench"
+
+typedef struct
+{
+    int size;
+    int batch; // results per group commit
+    cJSON* bank;
+    char id[64];
+} StorageCase;
+
+static void write_json(const char* path, cJSON* root)
+{
+    char* text = cJSON_Print(root);
+    FILE* f = fopen(path, "w");
+    if (f) {
+        fputs(text, f);
+        fclose(f);
+    }
+    free(text);
+    cJSON_Delete(root);
+}
+
+static void make_room(Room* room, int i)
+{
+    memset(room, 0, sizeof(*room));
+    snprintf(room->id, sizeof(room->id), "room_%d", 1700000000 + i);
+    snprintf(room->name, sizeof(room->name), "Midterm exam section %d", i);
+    room->start_time = 1700000000L + i * 3600L;
+    room->end_time = room->start_time + 5400;
+    snprintf(room->question_bank_id, sizeof(room->question_bank_id), "bank_%d", i % 8);
+    strcpy(room->status, "OPEN");
+    room->num_questions = 40;
+    room->allowed_attempts = 1;
+}
+
+static void write_rooms_file(void* arg)
+{
+    StorageCase* c = arg;
+    cJSON* rooms = cJSON_CreateArray();
+    for (int i = 0; i < c->size; i++) {
+        Room room;
+        make_room(&room, i);
+        cJSON* obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(obj, "id", room.id);
+        cJSON_AddStringToObject(obj, "name", room.name);
+        cJSON_AddNumberToObject(obj, "start_time", room.start_time);
+        cJSON_AddNumberToObject(obj, "end_time", room.end_time);
+        cJSON_AddStringToObject(obj, "question_bank_id", room.question_bank_id);
+        cJSON_AddStringToObject(obj, "status", room.status);
+        cJSON_AddNumberToObject(obj, "num_questions", room.num_questions);
+        cJSON_AddNumberToObject(obj, "allowed_attempts", room.allowed_attempts);
+        cJSON_AddItemToArray(rooms, obj);
+    }
+    write_json(BENCH_ROOMS_FILE, rooms);
+    storage_load_rooms(BENCH_ROOMS_FILE);
+    snprintf(c->id, sizeof(c->id), "room_%d", 1700000000 + c->size - 1);
+}
+
+static void write_results_file(void* arg)
+{
+    StorageCase* c = arg;
+    // Compacts results journaled by the previous batch before the file is replaced
+    storage_flush();
+    FILE* f = fopen(BENCH_RESULTS_DIR BENCH_ROOM_ID ".ndjson", "w");
+    if (!f)
+        return;
+    for (int i = 0; i < c->size; i++)
+        fprintf(f, "{\"username\":\"student_%05d\",\"score\":%d,\"timestamp\":%d}\n", i, i % 41, 1700000000 + i);
+    fclose(f);
+}
+
+static void bench_get_rooms(long iters, void* arg)
+{
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        cJSON* rooms = cJSON_CreateArray();
+        storage_get_rooms(rooms);
+        cJSON_Delete(rooms);
+    }
+}
+
+static void count_room(const Room* room, void* ctx)
+{
+    (void)room;
+    (*(long*)ctx)++;
+}
+
+// A LIST_ROOMS page from the middle of the list, filtered by status
+static void bench_list_rooms_page(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    Room middle;
+    make_room(&middle, c->size / 2);
+    char cursor[STORAGE_CURSOR_SIZE], next[STORAGE_CURSOR_SIZE];
+    snprintf(cursor, sizeof(cursor), "%ld:%s", middle.start_time, middle.id);
+    RoomPageQuery query = { .status = "OPEN", .cursor = cursor, .limit = 20 };
+    long count = 0;
+    for (long i = 0; i < iters; i++)
+        storage_list_rooms_page(&query, count_room, &count, next);
+}
+
+static void bench_get_room(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    for (long i = 0; i < iters; i++)
+        cJSON_Delete(storage_get_room(c->id));
+}
+
+static void bench_update_room_status(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    for (long i = 0; i < iters; i++)
+        storage_update_room_status(c->id, (i & 1) ? "OPEN" : "CLOSED");
+}
+
+static void bench_save_delete_room(long iters, void* arg)
+{
+    (void)arg;
+    Room room;
+    make_room(&room, 999999);
+    for (long i = 0; i < iters; i++) {
+        storage_save_room(&room);
+        storage_delete_room(room.id);
+    }
+}
+
+// The write-behind cost one mutation eventually pays
+static void bench_flush_rooms(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    for (long i = 0; i < iters; i++) {
+        storage_update_room_status(c->id, (i & 1) ? "OPEN" : "CLOSED");
+        storage_flush();
+    }
+}
+
+static void bench_save_result(long iters, void* arg)
+{
+    (void)arg;
+    RoomResult result;
+    memset(&result, 0, sizeof(result));
+    strcpy(result.room_id, BENCH_ROOM_ID);
+    strcpy(result.username, "student_late");
+    result.score = 30;
+    result.timestamp = 1700009999;
+    for (long i = 0; i < iters; i++)
+        storage_save_result(&result);
+}
+
+// Per-record cost when a group commit (one write + fdatasync) covers `batch` results
+static void bench_group_commit(long iters, void* arg)
+{
+    int batch = ((StorageCase*)arg)->batch;
+    RoomResult result;
+    memset(&result, 0, sizeof(result));
+    strcpy(result.room_id, BENCH_ROOM_ID);
+    strcpy(result.username, "student_late");
+    result.score = 30;
+    result.timestamp = 1700009999;
+    for (long i = 0; i < iters; i++) {
+        storage_save_result(&result);
+        if ((i + 1) % batch == 0 || i + 1 == iters)
+            journal_sync();
+    }
+}
+
+static void bench_get_room_results(long iters, void* arg)
+{
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        cJSON* results = cJSON_CreateArray();
+        storage_get_room_results(BENCH_ROOM_ID, results);
+        cJSON_Delete(results);
+    }
+}
+
+static void count_result(const RoomResult* result, void* ctx)
+{
+    (void)result;
+    (*(long*)ctx)++;
+}
+
+// What SUBMIT_RESULT's attempt check does: stream the file without building a tree
+static void bench_for_each_room_result(long iters, void* arg)
+{
+    (void)arg;
+    long count = 0;
+    for (long i = 0; i < iters; i++)
+        storage_for_each_room_result(BENCH_ROOM_ID, count_result, &count);
+}
+
+// After the first call per room, what a dashboard polling GET_ROOM_STATS costs
+static void bench_get_room_stats(long iters, void* arg)
+{
+    (void)arg;
+    for (long i = 0; i < iters; i++)
+        storage_get_room_stats(BENCH_ROOM_ID);
+}
+
+// Results of a room of their own, so no index built for another size is reused
+static void write_page_results_file(StorageCase* c)
+{
+    char path[128];
+    snprintf(c->id, sizeof(c->id), "room_page_%d", c->size);
+    snprintf(path, sizeof(path), BENCH_RESULTS_DIR "%s.ndjson", c->id);
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return;
+    for (int i = 0; i < c->size; i++)
+        fprintf(f, "{\"username\":\"student_%05d\",\"score\":%d,\"timestamp\":%d}\n", i, i % 41, 1700000000 + i);
+    fclose(f);
+}
+
+// A GET_ROOM_STATS results page by score from the middle of the room
+static void bench_room_results_page(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    char cursor[STORAGE_CURSOR_SIZE], next[STORAGE_CURSOR_SIZE];
+    snprintf(cursor, sizeof(cursor), "20:%d", c->size / 2);
+    ResultPageQuery query = { .by_score = 1, .cursor = cursor, .limit = 50 };
+    long count = 0;
+    for (long i = 0; i < iters; i++)
+        storage_room_results_page(c->id, &query, count_result, &count, next);
+}
+
+typedef struct
+{
+    Ranking* ranking;
+    int users;
+} RankingCase;
+
+static void count_rank_entry(long rank, const char* username, int score, long timestamp, void* ctx)
+{
+    (void)username;
+    (void)score;
+    (void)timestamp;
+    *(long*)ctx += rank;
+}
+
+// A submission that may move a user up the leaderboard
+static void bench_ranking_update(long iters, void* arg)
+{
+    RankingCase* c = arg;
+    char name[32];
+    for (long i = 0; i < iters; i++) {
+        snprintf(name, sizeof(name), "student_%07ld", (i * 7919) % c->users);
+        ranking_update(c->ranking, name, (int)(i % 41), 1700000000L + i);
+    }
+}
+
+// GET_LEADERBOARD's "my rank" plus a top-10 window
+static void bench_ranking_query(long iters, void* arg)
+{
+    RankingCase* c = arg;
+    char name[32];
+    long count = 0;
+    for (long i = 0; i < iters; i++) {
+        snprintf(name, sizeof(name), "student_%07ld", (i * 7919) % c->users);
+        count += ranking_rank(c->ranking, name);
+        ranking_range(c->ranking, 1, 10, count_rank_entry, &count);
+    }
+}
+
+static void bench_save_question_bank(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    for (long i = 0; i < iters; i++)
+        storage_save_question_bank(c->id, c->bank);
+}
+
+static void bench_get_question_bank(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    QbkView bank;
+    for (long i = 0; i < iters; i++)
+        storage_get_question_bank(c->id, &bank);
+}
+
+static void bench_export_question_bank(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    const char* json;
+    size_t len;
+    for (long i = 0; i < iters; i++)
+        storage_export_question_bank(c->id, &json, &len);
+}
+
+// One question out of the bank, as the editor would fetch it
+static void bench_get_question(long iters, void* arg)
+{
+    StorageCase* c = arg;
+    QbkView bank;
+    for (long i = 0; i < iters; i++) {
+        if (storage_get_question_bank(c->id, &bank) != 0 || bank.count == 0)
+            return;
+        cJSON_Delete(qbk_question_to_json(&bank, (uint32_t)((i * 7919) % bank.count)));
+    }
+}
+
+static void bench_list_question_banks(long iters, void* arg)
+{
+    (void)arg;
+    for (long i = 0; i < iters; i++) {
+        cJSON* banks = cJSON_CreateArray();
+        storage_list_question_banks(banks);
+        cJSON_Delete(banks);
+    }
+}
+
+#define LOGIN_NAMES 4096
+
+// Logins cycle through random users so large tables are not served from a warm cache line
+static char login_names[LOGIN_NAMES][32];
+
+static void bench_get_password(long iters, void* arg)
+{
+    (void)arg;
+    for (long i = 0; i < iters; i++)
+        storage_get_password(login_names[i & (LOGIN_NAMES - 1)]);
+}
+
+static void bench_load_users(long iters, void* arg)
+{
+    (void)arg;
+    for (long i = 0; i < iters; i++)
+        storage_load_users("data/users.txt");
+}
+
+static void write_users_file(int count)
+{
+    FILE* f = fopen("data/users.txt", "w");
+    if (!f)
+        return;
+    for (int i = 0; i < count; i++)
+        fprintf(f, "student_%07d:secret:participant\n", i);
+    fclose(f);
+}
+
+void run_storage_benchmarks(void)
+{
+    static const int room_sizes[] = { 10, 100, 1000 };
+    static const int result_sizes[] = { 10, 1000, 10000 };
+    static const int bank_sizes[] = { 10, 1000, 20000 };
+    char name[96];
+
+    char dir[] = "/tmp/quizzie-bench-XXXXXX";
+    char cwd[512];
+    if (!getcwd(cwd, sizeof(cwd)) || !mkdtemp(dir) || chdir(dir) != 0) {
+        perror("storage bench setup");
+        return;
+    }
+
+    mkdir("data", 0777);
+    mkdir(BENCH_RESULTS_DIR, 0777);
+    write_users_file(100);
+    bench_silence_stdout(1);
+    storage_init();
+    bench_silence_stdout(0);
+
+    StorageCase c;
+    memset(&c, 0, sizeof(c));
+
+    static const int user_sizes[] = { 100, 10000, 1000000 };
+    for (size_t i = 0; i < sizeof(user_sizes) / sizeof(user_sizes[0]); i++) {
+        write_users_file(user_sizes[i]);
+        storage_load_users("data/users.txt");
+        unsigned int seed = 12345;
+        for (int n = 0; n < LOGIN_NAMES; n++) {
+            seed = seed * 1103515245 + 12345;
+            snprintf(login_names[n], sizeof(login_names[n]), "student_%07d", (int)((seed >> 8) % user_sizes[i]));
+        }
+        snprintf(name, sizeof(name), "storage/get_password/users_%d", user_sizes[i]);
+        bench_run(name, bench_get_password, &c, 0);
+        snprintf(name, sizeof(name), "storage/load_users/users_%d", user_sizes[i]);
+        bench_run(name, bench_load_users, &c, 0);
+    }
+
+    for (size_t i = 0; i < sizeof(room_sizes) / sizeof(room_sizes[0]); i++) {
+        c.size = room_sizes[i];
+        write_rooms_file(&c);
+
+        snprintf(name, sizeof(name), "storage/get_rooms/rooms_%d", c.size);
+        bench_run(name, bench_get_rooms, &c, 0);
+        snprintf(name, sizeof(name), "storage/list_rooms_page/rooms_%d", c.size);
+        bench_run(name, bench_list_rooms_page, &c, 0);
+        snprintf(name, sizeof(name), "storage/get_room/rooms_%d", c.size);
+        bench_run(name, bench_get_room, &c, 0);
+        snprintf(name, sizeof(name), "storage/update_room_status/rooms_%d", c.size);
+        bench_run(name, bench_update_room_status, &c, 0);
+        snprintf(name, sizeof(name), "storage/save_delete_room/rooms_%d", c.size);
+        bench_run(name, bench_save_delete_room, &c, 0);
+        snprintf(name, sizeof(name), "storage/flush_rooms/rooms_%d", c.size);
+        bench_run(name, bench_flush_rooms, &c, 0);
+    }
+
+    // Appends grow the file, so batches are capped and the file is rewritten before each
+    for (size_t i = 0; i < sizeof(result_sizes) / sizeof(result_sizes[0]); i++) {
+        c.size = result_sizes[i];
+        long cap = c.size / 10 > 16 ? c.size / 10 : 16;
+
+        snprintf(name, sizeof(name), "storage/save_result/results_%d", c.size);
+        bench_run_with_reset(name, bench_save_result, write_results_file, &c, cap);
+        write_results_file(&c);
+        snprintf(name, sizeof(name), "storage/get_room_results/results_%d", c.size);
+        bench_run(name, bench_get_room_results, &c, 0);
+        snprintf(name, sizeof(name), "storage/for_each_room_result/results_%d", c.size);
+        bench_run(name, bench_for_each_room_result, &c, 0);
+        snprintf(name, sizeof(name), "storage/get_room_stats/results_%d", c.size);
+        bench_run(name, bench_get_room_stats, &c, 0);
+        write_page_results_file(&c);
+        snprintf(name, sizeof(name), "storage/room_results_page/results_%d", c.size);
+        bench_run(name, bench_room_results_page, &c, 0);
+    }
+
+    static const int commit_batches[] = { 1, 16, 128 };
+    c.size = 10;
+    for (size_t i = 0; i < sizeof(commit_batches) / sizeof(commit_batches[0]); i++) {
+        c.batch = commit_batches[i];
+        snprintf(name, sizeof(name), "storage/group_commit/batch_%d", c.batch);
+        bench_run_with_reset(name, bench_group_commit, write_results_file, &c, 1024);
+    }
+
+    for (size_t i = 0; i < sizeof(bank_sizes) / sizeof(bank_sizes[0]); i++) {
+        c.size = bank_sizes[i];
+        c.bank = bench_make_question_bank(c.size);
+        snprintf(c.id, sizeof(c.id), "bench_bank_%d", c.size);
+
+        snprintf(name, sizeof(name), "storage/save_question_bank/bank_%d", c.size);
+        bench_run(name, bench_save_question_bank, &c, 0);
+        snprintf(name, sizeof(name), "storage/get_question_bank/bank_%d", c.size);
+        bench_run(name, bench_get_question_bank, &c, 0);
+        snprintf(name, sizeof(name), "storage/export_question_bank/bank_%d", c.size);
+        bench_run(name, bench_export_question_bank, &c, 0);
+        snprintf(name, sizeof(name), "storage/get_question/bank_%d", c.size);
+        bench_run(name, bench_get_question, &c, 0);
+
+        cJSON_Delete(c.bank);
+        c.bank = NULL;
+    }
+    // Named after the banks actually stored, the sizes above
+    cJSON* banks = cJSON_CreateArray();
+    storage_list_question_banks(banks);
+    snprintf(name, sizeof(name), "storage/list_question_banks/banks_%d", cJSON_GetArraySize(banks));
+    cJSON_Delete(banks);
+    bench_run(name, bench_list_question_banks, &c, 0);
+
+    static const int ranking_sizes[] = { 100, 10000, 1000000 };
+    for (size_t i = 0; i < sizeof(ranking_sizes) / sizeof(ranking_sizes[0]); i++) {
+        RankingCase rc = { ranking_create(), ranking_sizes[i] };
+        bench_ranking_update(ranking_sizes[i], &rc);
+        snprintf(name, sizeof(name), "storage/ranking_update/users_%d", rc.users);
+        bench_run(name, bench_ranking_update, &rc, 0);
+        snprintf(name, sizeof(name), "storage/ranking_query/users_%d", rc.users);
+        bench_run(name, bench_ranking_query, &rc, 0);
+        ranking_free(rc.ranking);
+    }
+
+    if (chdir(cwd) == 0) {
+        char cmd[600];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+        if (system(cmd) != 0)
+            fprintf(stderr, "Failed to clean up %s\n", dir);
+    }
+}
@@ -6,6 +6,9 @@
 struct cJSON;
 
 void ui_show_admin_dashboard(GtkWidget** window, GtkWidget** status_label, const char* username);
-void ui_admin_update_room_list(struct cJSON* rooms_array);
+// Shows a page of rooms and asks for the next one while next_cursor is set
+void ui_admin_update_room_list(struct cJSON* rooms_array, const char* next_cursor);
+// Stops following pages after an error, so refresh works again
+void ui_admin_room_list_failed(void);
 
 #endif
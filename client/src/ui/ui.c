@@ -188,12 +188,14 @@ static void handle_server_message(char* msg_type, cJSON* payload)
             // Check if it is a room list response (data is array)
             cJSON* data = cJSON_GetObjectItem(payload, JSON_KEY_DATA);
             if (data && cJSON_IsArray(data)) {
-                ui_admin_update_room_list(data);
+                cJSON* next = cJSON_GetObjectItem(payload, JSON_KEY_NEXT_CURSOR);
+                ui_admin_update_room_list(data, cJSON_IsString(next) ? next->valuestring : NULL);
             } else if (msg && strlen(msg) > 0) {
                 show_message(msg, GTK_MESSAGE_INFO);
             }
         }
     } else if (strcmp(msg_type, MSG_TYPE_ERR) == 0) {
+        ui_admin_room_list_failed();
         show_message(msg, GTK_MESSAGE_ERROR);
     }
 }
@@ -22,6 +22,8 @@ static void show_question_bank_editor(GtkWidget* parent, const char* bank_id);
 
 // Global reference for list store
 static GtkListStore* room_store;
+// Set while the later pages of a room list are still being fetched
+static gboolean room_list_following;
 extern int ui_get_socket(); // defined in ui.c
 
 void ui_show_admin_dashboard(GtkWidget** window, GtkWidget** status_label, const char* username)
@@ -103,18 +105,33 @@ static void on_logout_clicked(GtkWidget* widget, gpointer data)
     home_controller_on_logout();
 }
 
-static void on_refresh_clicked(GtkWidget* widget, gpointer data)
+// The server answers a page at a time; a cursor asks for the page after it
+static int send_list_rooms(const char* cursor)
 {
-    (void)widget;
-    (void)data;
     int s = ui_get_socket();
     if (s < 0)
-        return;
+        return -1;
 
     cJSON* req = cJSON_CreateObject();
     cJSON_AddStringToObject(req, "action", "LIST_ROOMS");
-    send_packet(s, "REQ", req);
+    if (cursor) {
+        cJSON* d = cJSON_CreateObject();
+        cJSON_AddStringToObject(d, "cursor", cursor);
+        cJSON_AddItemToObject(req, "data", d);
+    }
+    int rc = send_packet(s, "REQ", req);
     cJSON_Delete(req);
+    return rc;
+}
+
+static void on_refresh_clicked(GtkWidget* widget, gpointer data)
+{
+    (void)widget;
+    (void)data;
+    // A list still coming in would get the new first page mixed into it
+    if (room_list_following)
+        return;
+    send_list_rooms(NULL);
 }
 
 static void on_create_room_clicked(GtkWidget* widget, gpointer data)
@@ -729,6 +746,47 @@ static void on_delete_room_confirm(GtkWidget* btn, gpointer data)
     gtk_widget_destroy(msg);
 }
 
+static void send_room_stats(const char* room_id, const char* cursor)
+{
+    cJSON* req = cJSON_CreateObject();
+    cJSON_AddStringToObject(req, "action", "GET_ROOM_STATS");
+    cJSON* d = cJSON_CreateObject();
+    cJSON_AddStringToObject(d, "room_id", room_id);
+    if (cursor)
+        cJSON_AddStringToObject(d, "cursor", cursor);
+    cJSON_AddItemToObject(req, "data", d);
+    send_packet(ui_get_socket(), "REQ", req);
+    cJSON_Delete(req);
+}
+
+// Adds a page of results to the store; returns the cursor of the next page
+// (g_free it), or NULL after the last one
+static char* append_room_results(GtkListStore* res_store, cJSON* data)
+{
+    cJSON* results = cJSON_GetObjectItem(data, "results");
+    cJSON* res;
+    cJSON_ArrayForEach(res, results)
+    {
+        cJSON* u = cJSON_GetObjectItem(res, "username");
+        cJSON* s = cJSON_GetObjectItem(res, "score");
+        cJSON* tm = cJSON_GetObjectItem(res, "timestamp");
+
+        char time_str[32] = "Unknown";
+        if (tm) {
+            time_t t = (time_t)tm->valuedouble;
+            if (t == 0)
+                t = time(NULL);
+            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M", localtime(&t));
+        }
+
+        gtk_list_store_insert_with_values(
+            res_store, NULL, -1, 0, u ? u->valuestring : "?", 1, s ? s->valueint : 0, 2, time_str, -1);
+    }
+
+    cJSON* next = cJSON_GetObjectItem(data, JSON_KEY_NEXT_CURSOR);
+    return cJSON_IsString(next) ? g_strdup(next->valuestring) : NULL;
+}
+
 static void show_room_details_dialog(GtkWidget* parent, const char* room_id, const char* room_name)
 {
     GtkWidget* dialog = gtk_dialog_new_with_buttons("Room Details", GTK_WINDOW(parent),
@@ -815,16 +873,11 @@ static void show_room_details_dialog(GtkWidget* parent, const char* room_id, con
     gtk_container_add(GTK_CONTAINER(frame), scroll);
 
     // Fetch Data
-    cJSON* req = cJSON_CreateObject();
-    cJSON_AddStringToObject(req, "action", "GET_ROOM_STATS");
-    cJSON* d = cJSON_CreateObject();
-    cJSON_AddStringToObject(d, "room_id", room_id);
-    cJSON_AddItemToObject(req, "data", d);
-    send_packet(ui_get_socket(), "REQ", req);
-    cJSON_Delete(req);
+    send_room_stats(room_id, NULL);
 
     char type[4];
     cJSON* resp = NULL;
+    char* cursor = NULL;
     if (receive_packet(ui_get_socket(), type, &resp) == 0 && strcmp(type, "RES") == 0) {
         cJSON* data = cJSON_GetObjectItem(resp, "data");
         if (data) {
@@ -882,28 +935,24 @@ static void show_room_details_dialog(GtkWidget* parent, const char* room_id, con
             gtk_label_set_text(GTK_LABEL(lblStats), stat_str);
 
             // 3. Results
-            cJSON* results = cJSON_GetObjectItem(data, "results");
-            cJSON* res;
-            cJSON_ArrayForEach(res, results)
-            {
-                cJSON* u = cJSON_GetObjectItem(res, "username");
-                cJSON* s = cJSON_GetObjectItem(res, "score");
-                cJSON* tm = cJSON_GetObjectItem(res, "timestamp");
-
-                char time_str[32] = "Unknown";
-                if (tm) {
-                    time_t t = (time_t)tm->valuedouble;
-                    if (t == 0)
-                        t = time(NULL);
-                    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M", localtime(&t));
-                }
-
-                gtk_list_store_insert_with_values(res_store, NULL, -1, 0, u ? u->valuestring : "?", 1,
-                    s ? s->valueint : 0, 2, time_str, -1);
-            }
+            cursor = append_room_results(res_store, data);
         }
-        cJSON_Delete(resp);
     } // TODO: Handle error case (e.g. show "Failed to load")
+    cJSON_Delete(resp);
+
+    // Results come a page at a time; fetch the rest so none are left out
+    while (cursor) {
+        send_room_stats(room_id, cursor);
+        g_free(cursor);
+        cursor = NULL;
+        resp = NULL;
+        if (receive_packet(ui_get_socket(), type, &resp) == 0 && strcmp(type, "RES") == 0) {
+            cJSON* data = cJSON_GetObjectItem(resp, "data");
+            if (data)
+                cursor = append_room_results(res_store, data);
+        }
+        cJSON_Delete(resp);
+    }
 
     // 4. Actions
     GtkWidget* bbox = gtk_button_box_new(GTK_ORIENTATION_HORIZONTAL);
@@ -938,11 +987,15 @@ static void on_room_details_clicked(GtkWidget* widget, gpointer data)
     }
 }
 
-void ui_admin_update_room_list(cJSON* rooms_array)
+void ui_admin_update_room_list(cJSON* rooms_array, const char* next_cursor)
 {
+    gboolean following = room_list_following;
+    room_list_following = FALSE;
     if (!room_store)
         return;
-    gtk_list_store_clear(room_store);
+    // Later pages add to the rows the first one started
+    if (!following)
+        gtk_list_store_clear(room_store);
 
     cJSON* room;
     cJSON_ArrayForEach(room, rooms_array)
@@ -967,4 +1020,12 @@ void ui_admin_update_room_list(cJSON* rooms_array)
                 num ? num->valueint : 0, 6, att ? att->valueint : 0, -1);
         }
     }
+
+    if (next_cursor && send_list_rooms(next_cursor) == 0)
+        room_list_following = TRUE;
+}
+
+void ui_admin_room_list_failed(void)
+{
+    room_list_following = FALSE;
 }
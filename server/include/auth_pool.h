@@ -0,0 +1,51 @@
+#ifndef AUTH_POOL_H
+#define AUTH_POOL_H
+
+#include "cJSON.h"
+#include "password.h"
+
+// Password hashing off the event loop. A fixed set of worker threads takes
+// jobs from a queue; finished jobs collect in a done list and a byte on a
+// pipe wakes the loop, which polls auth_pool_fd() and then takes the list.
+// Workers only run password.c: no cJSON, no storage, no client state.
+//   QUIZZIE_AUTH_WORKERS       thread count, 0 = one per online CPU
+//   QUIZZIE_PBKDF2_ITERATIONS  cost of new hashes; stored ones keep their own
+
+typedef enum
+{
+    AUTH_VERIFY, // ok = password matches stored
+    AUTH_HASH // ok = stored was filled with a new hash of password
+} AuthJobType;
+
+typedef struct AuthJob
+{
+    AuthJobType type;
+    int client_idx; // who waits for the answer, -1 = nobody
+    unsigned long client_gen; // tells a reused client slot from the one that asked
+    char* username;
+    char* password;
+    char stored[PASSWORD_HASH_MAX];
+    int ok;
+    int rehashed; // a plaintext password verified and stored now holds its hash
+    unsigned long long submitted_us; // set by the pool
+    struct AuthJob* next;
+} AuthJob;
+
+int auth_pool_start(void); // 0 on success
+void auth_pool_stop(void); // queued jobs are dropped
+int auth_pool_fd(void);
+// Verified in place of an unknown user's hash so the reply takes as long; a match
+// against it must still be rejected
+const char* auth_pool_unknown_user_hash(void);
+
+AuthJob* auth_job_new(AuthJobType type, int client_idx, unsigned long client_gen, const char* username,
+                      const char* password);
+void auth_job_free(AuthJob* job);
+// Takes ownership of the job. 0 on success.
+int auth_pool_submit(AuthJob* job);
+// Finished jobs in completion order, linked through next; the caller frees them
+AuthJob* auth_pool_take_done(void);
+
+cJSON* auth_pool_stats_to_json(void);
+
+#endif
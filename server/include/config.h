@@ -0,0 +1,8 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+// Runtime tunables are read from QUIZZIE_* environment variables.
+long config_get_long(const char* name, long default_value);
+const char* config_get_str(const char* name, const char* default_value);
+
+#endif
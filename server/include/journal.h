@@ -0,0 +1,90 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Append-only write-ahead log. Each record is a fixed header followed by
+// its payload; the CRC covers lsn, type and payload, so replay stops at the
+// first torn or corrupt record and the file is truncated back to it.
+// Headers are in host byte order: the log is not meant to move between machines.
+
+typedef enum
+{
+    JOURNAL_ROOM_PUT = 1, // payload: room record JSON
+    JOURNAL_ROOM_DELETE = 2, // payload: {"id": ...}
+    JOURNAL_RESULT_ADD = 3, // payload: result record JSON
+    JOURNAL_USER_PUT = 4, // payload: {"username", "password", "role"}
+    JOURNAL_BANK_PUT = 5, // payload: bank id, '\0', qbk bytes
+    JOURNAL_BANK_DELETE = 6 // payload: bank id
+} JournalRecordType;
+
+// When appended records are forced to disk:
+//   always    written and fsynced before journal_append() returns
+//   group     buffered, then committed with one write and one fsync once the
+//             oldest has waited the group window or the batch is full
+//   interval  written at once, fsynced at most every QUIZZIE_JOURNAL_FSYNC_MS
+typedef enum
+{
+    JOURNAL_FSYNC_ALWAYS,
+    JOURNAL_FSYNC_GROUP,
+    JOURNAL_FSYNC_INTERVAL
+} JournalFsyncPolicy;
+
+typedef struct
+{
+    uint32_t length; // payload bytes
+    uint32_t crc;
+    uint64_t lsn;
+    uint8_t type;
+} __attribute__((packed)) JournalRecordHeader;
+
+typedef struct
+{
+    unsigned long long appends;
+    unsigned long long bytes;
+    unsigned long long writes;
+    unsigned long long syncs; // commits
+    unsigned long long rotations;
+    unsigned long long synced_records; // over syncs gives the average batch
+    unsigned long long max_batch;
+    unsigned long long commit_wait_us; // first append of a batch to its fsync
+    unsigned long long max_commit_wait_us;
+} JournalStats;
+
+// Called for each intact record in order
+typedef void (*JournalReplayFn)(uint64_t lsn, int type, const char* payload, size_t len, void* ctx);
+
+int journal_open(const char* path, JournalFsyncPolicy policy, long interval_ms);
+// Group policy: how long the first record of a batch may wait, and the batch size that commits at once
+void journal_set_group_commit(long window_us, int max_records);
+void journal_close(void);
+// Returns the record's lsn, 0 on failure (nothing is left behind in the file).
+// Under the group policy the record is only queued; it is durable once
+// journal_durable_lsn() reaches its lsn.
+uint64_t journal_append(int type, const char* payload, size_t len);
+// Writes any queued records and fsyncs
+int journal_sync(void);
+uint64_t journal_durable_lsn(void);
+// Moves the current log to old_path and starts an empty one in its place
+int journal_rotate(const char* old_path);
+
+// The lsn the next append gets; replay moves it past everything it saw
+uint64_t journal_next_lsn(void);
+void journal_set_next_lsn(uint64_t lsn);
+size_t journal_size(void);
+
+// Group commits and interval syncs; journal_timeout_ms() is -1 while nothing is owed
+void journal_tick(void);
+int journal_timeout_ms(void);
+
+// Replays path, returning the number of records or -1 if it cannot be read.
+// A missing file replays nothing.
+long journal_replay(const char* path, JournalReplayFn fn, void* ctx);
+
+JournalFsyncPolicy journal_parse_policy(const char* name);
+const char* journal_policy_name(JournalFsyncPolicy policy);
+void journal_get_stats(JournalStats* out);
+uint32_t journal_crc32(uint32_t crc, const void* data, size_t len);
+
+#endif
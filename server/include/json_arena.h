@@ -0,0 +1,33 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include "cJSON.h"
+#include <stddef.h>
+
+// Per-request bump allocator installed as the cJSON allocator. Between
+// json_arena_begin() and json_arena_end() every cJSON node, string and
+// print buffer comes from the arena and frees are no-ops; json_arena_end()
+// drops them all at once. QUIZZIE_JSON_ARENA=0 falls back to malloc/free
+// (allocation counters keep working for comparisons).
+typedef struct
+{
+    unsigned long long heap_mallocs;
+    unsigned long long heap_frees;
+    unsigned long long arena_allocs;
+    unsigned long long arena_bytes;
+    unsigned long long chunk_mallocs;
+    unsigned long long requests;
+    size_t peak_request_bytes;
+} JsonArenaStats;
+
+void json_arena_init(void);
+void json_arena_begin(void);
+void json_arena_end(void);
+int json_arena_active(void);
+void json_arena_get_stats(JsonArenaStats* out);
+cJSON* json_arena_stats_to_json(void);
+
+// Trees released by json_arena_end() need no cJSON_Delete walk
+void json_release(cJSON* item);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef JSON_KEYS_H
+#define JSON_KEYS_H
+
+#include "cJSON.h"
+#include "protocol.h"
+
+// Protocol keys with their hashes computed once, so lookups compare
+// integers before strings. Lookups are case sensitive.
+typedef enum
+{
+#define X(id, name) id,
+    PROTOCOL_KEY_LIST(X)
+#undef X
+    KEY_COUNT
+} JsonKey;
+
+cJSON* json_get(const cJSON* object, JsonKey key);
+const char* json_key_name(JsonKey key);
+unsigned int json_key_hash(JsonKey key);
+
+#endif
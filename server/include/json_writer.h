@@ -0,0 +1,58 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include "cJSON.h"
+#include <stddef.h>
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+// Streaming JSON writer that serializes a response straight into a
+// growable per-connection output buffer. The 7-byte frame header is
+// reserved up front by json_writer_begin_frame() and patched by
+// json_writer_send(), so a whole frame goes out in one send().
+//
+//   json_writer_begin_frame(w, MSG_TYPE_RES);
+//   json_writer_begin_object(w);
+//   json_writer_key(w, JSON_KEY_STATUS);
+//   json_writer_string(w, "SUCCESS");
+//   json_writer_end_object(w);
+//   json_writer_send(w, fd);
+typedef struct
+{
+    char* buf;
+    size_t len;
+    size_t cap;
+    int depth;
+    unsigned char has_items[JSON_WRITER_MAX_DEPTH]; // per open container: a comma is due
+    int after_key;
+    int failed; // allocation failure or nesting overflow, the frame is dropped
+} JsonWriter;
+
+void json_writer_init(JsonWriter* w);
+void json_writer_free(JsonWriter* w);
+
+void json_writer_begin_frame(JsonWriter* w, const char* msg_type);
+// Patches the header; the frame is then buf[0..len). -1 if writing failed
+// or the payload exceeds MAX_PAYLOAD_SIZE.
+int json_writer_finish(JsonWriter* w);
+// Sends an ERR frame instead of one that json_writer_finish() refuses
+int json_writer_send(JsonWriter* w, int sock);
+
+void json_writer_begin_object(JsonWriter* w);
+void json_writer_end_object(JsonWriter* w);
+void json_writer_begin_array(JsonWriter* w);
+void json_writer_end_array(JsonWriter* w);
+void json_writer_key(JsonWriter* w, const char* key);
+
+void json_writer_string(JsonWriter* w, const char* value);
+void json_writer_int(JsonWriter* w, long value);
+void json_writer_number(JsonWriter* w, double value);
+void json_writer_bool(JsonWriter* w, int value);
+void json_writer_null(JsonWriter* w);
+
+// Embeds a value that is already serialized, copied as is
+void json_writer_raw(JsonWriter* w, const char* json, size_t len);
+// Embeds an existing tree (e.g. one loaded from storage) without printing it separately
+void json_writer_item(JsonWriter* w, const cJSON* item);
+
+#endif
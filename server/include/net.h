@@ -7,5 +7,6 @@
 int net_listen(int port);
 int send_packet(int sock, const char* msg_type, cJSON* payload);
 int receive_packet(int sock, char* msg_type_out, cJSON** payload_out);
+int send_frame(int sock, const char* frame, size_t len); // an already framed packet
 
 #endif
@@ -0,0 +1,65 @@
+#ifndef PAGEDB_H
+#define PAGEDB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-file paged key-value store: a copy-on-write B+tree of byte-string
+// keys over 4 KB pages, read through a fixed-size buffer cache.
+//
+// Pages of the last commit are never written over. A write transaction
+// copies the pages it changes (a page already copied by the same
+// transaction is changed in place), and commit writes the new pages, syncs,
+// then writes the meta page naming the new root into the slot the previous
+// commit did not use and syncs again. After a crash, open() picks the
+// newest meta page whose checksum holds, so a commit is all or nothing.
+// Pages freed by a transaction are reused once it has committed; the free
+// list is rebuilt at open by walking the tree.
+//
+// One write transaction at a time (begin blocks); reads may run from other
+// threads meanwhile and see the transaction's changes as they are made.
+
+#define PAGEDB_PAGE_SIZE 4096
+#define PAGEDB_MAX_KEY 256
+#define PAGEDB_MAX_INLINE_VALUE 768 // longer values go to overflow pages
+
+typedef struct PageDb PageDb;
+
+typedef struct
+{
+    unsigned long long reads; // pages read from the file
+    unsigned long long writes; // pages written, meta pages excluded
+    unsigned long long hits; // page requests served by the cache
+    unsigned long long commits;
+    unsigned long long txn;
+    unsigned int pages; // file size in pages
+    unsigned int free_pages;
+    unsigned int cache_pages;
+} PageDbStats;
+
+// Return nonzero to stop the scan
+typedef int (*PageDbScanFn)(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx);
+
+PageDb* pagedb_open(const char* path, int cache_pages);
+void pagedb_close(PageDb* db);
+
+void pagedb_begin(PageDb* db);
+// Makes the transaction durable along with user_lsn, an lsn the caller wants kept with it. 0 on success.
+int pagedb_commit(PageDb* db, uint64_t user_lsn);
+void pagedb_rollback(PageDb* db);
+uint64_t pagedb_user_lsn(PageDb* db);
+
+// Writes need an open transaction. 0 on success, -1 on error, get/delete return 1 if the key is absent.
+int pagedb_put(PageDb* db, const void* key, size_t key_len, const void* value, size_t value_len);
+int pagedb_delete(PageDb* db, const void* key, size_t key_len);
+// *value is malloc'd
+int pagedb_get(PageDb* db, const void* key, size_t key_len, void** value, size_t* value_len);
+
+// Keys >= from in order, until fn returns nonzero. Values are only valid during the call.
+int pagedb_scan(PageDb* db, const void* from, size_t from_len, PageDbScanFn fn, void* ctx);
+// Calls fn with the greatest key < below, if any. 1 if there is none.
+int pagedb_last_below(PageDb* db, const void* below, size_t below_len, PageDbScanFn fn, void* ctx);
+
+void pagedb_get_stats(PageDb* db, PageDbStats* out);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef PASSWORD_H
+#define PASSWORD_H
+
+#include <stddef.h>
+
+// Salted password hashes, stored in users.txt as
+//   pbkdf2-sha256$<iterations>$<salt hex>$<key hex>
+// A stored password without the prefix is a legacy plaintext one. Every
+// function here is pure (no globals), so the auth workers call them freely.
+
+#define PASSWORD_HASH_MAX 128 // longest stored form, including the NUL
+#define PASSWORD_SALT_LEN 16
+#define PASSWORD_KEY_LEN 32
+#define PASSWORD_DEFAULT_ITERATIONS 100000
+
+void password_sha256(const void* data, size_t len, unsigned char out[32]);
+void password_pbkdf2_sha256(const char* password, size_t password_len, const unsigned char* salt,
+                            size_t salt_len, unsigned long iterations, unsigned char* out, size_t out_len);
+
+// Hashes with a fresh random salt. 0 on success.
+int password_hash(const char* password, unsigned long iterations, char out[PASSWORD_HASH_MAX]);
+// 1 if password matches the stored form (hashed or plaintext), compared in constant time
+int password_verify(const char* password, const char* stored);
+int password_is_hashed(const char* stored);
+
+#endif
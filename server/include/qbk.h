@@ -0,0 +1,78 @@
+#ifndef QBK_H
+#define QBK_H
+
+#include "cJSON.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary question bank (.qbk), laid out to be used straight from an mmap:
+//
+//   QbkHeader
+//   QbkQuestion[count]       fixed width, question k is at a known offset
+//   QbkString[option_count]  every question's options, back to back
+//   string heap              UTF-8, each string NUL terminated
+//
+// String offsets are relative to the heap. Keys other than question,
+// options and correct_index (or those with unexpected types) are kept as a
+// JSON object in `extra` so exporting gives back what was imported.
+// Integers are in host byte order, like the journal.
+
+#define QBK_MAGIC "QBK1"
+#define QBK_VERSION 1
+#define QBK_NO_ANSWER INT32_MIN // correct_index of a question without a numeric one
+
+enum
+{
+    QBK_HAS_TEXT = 1,
+    QBK_HAS_OPTIONS = 2
+};
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t option_count;
+    uint64_t heap_size;
+} QbkHeader;
+
+typedef struct
+{
+    uint32_t text;
+    uint32_t text_len;
+    uint32_t options; // first entry in the option table
+    uint32_t option_count;
+    int32_t correct_index;
+    uint32_t flags;
+    uint32_t extra; // JSON object text, extra_len 0 = none
+    uint32_t extra_len;
+} QbkQuestion;
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t len;
+} QbkString;
+
+// A validated bank; the pointers borrow the buffer passed to qbk_view_open().
+// Question k is questions[k], its options are options[q->options ...] and
+// strings are at heap + offset.
+typedef struct
+{
+    uint32_t count;
+    const QbkQuestion* questions;
+    const QbkString* options;
+    const char* heap;
+} QbkView;
+
+// Encodes a JSON questions array, NULL if it is not an array of objects.
+// The buffer is malloc'd.
+char* qbk_encode(const cJSON* questions, size_t* size);
+// Checks every offset once, so reads through the view need no checks. 0 on success.
+int qbk_view_open(QbkView* view, const void* data, size_t size);
+
+// The JSON export for the editor
+cJSON* qbk_question_to_json(const QbkView* view, uint32_t k);
+cJSON* qbk_to_json(const QbkView* view);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+// A room's leaderboard: each user's best result, ordered by score (higher
+// first), then time (earlier first), then username. An order-statistic skip
+// list whose links count the entries they skip, so inserts, updates, a
+// user's rank and the entry at a rank are all O(log n).
+
+typedef struct Ranking Ranking;
+
+// rank starts at 1; username is only valid during the call
+typedef void (*RankingFn)(long rank, const char* username, int score, long timestamp, void* ctx);
+
+Ranking* ranking_create(void);
+void ranking_free(Ranking* ranking);
+
+// Keeps the result if it beats the user's best. 1 if it did, 0 if not, -1 on allocation failure.
+int ranking_update(Ranking* ranking, const char* username, int score, long timestamp);
+
+long ranking_count(const Ranking* ranking);
+// 0 if the user has no result
+long ranking_rank(const Ranking* ranking, const char* username);
+// Calls fn for up to count entries from rank first on, in order
+void ranking_range(const Ranking* ranking, long first, long count, RankingFn fn, void* ctx);
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include "cJSON.h"
+#include "json_keys.h"
+#include "storage.h"
+#include <stddef.h>
+
+// Declarative request schemas. Each action lists its fields once as
+//   X(member, key, type, required, default)
+// and request_decode() walks the `data` object a single time, matching
+// children by key hash, type checking them and filling a typed struct.
+//
+// Types:
+//   STRING  const char*, borrowed from the payload (valid until json_release)
+//   TEXT    char array member, copied and truncated to fit
+//   INT     int
+//   LONG    long
+//   ARRAY   cJSON*, borrowed
+// Missing optional numbers take `default`, missing optional pointers are NULL.
+
+typedef enum
+{
+    FIELD_STRING,
+    FIELD_TEXT,
+    FIELD_INT,
+    FIELD_LONG,
+    FIELD_ARRAY
+} FieldType;
+
+typedef struct
+{
+    JsonKey key;
+    FieldType type;
+    size_t offset;
+    size_t size; // member size, bounds TEXT copies
+    int required;
+    long def;
+} FieldSpec;
+
+typedef struct
+{
+    const FieldSpec* fields;
+    int count; // at most 32, decode tracks seen fields in a bitmask
+    size_t struct_size;
+    const char* error; // sent to the client when decoding fails
+} RequestSchema;
+
+// Struct members for schemas that decode into their own generated struct
+#define FIELD_CTYPE_STRING const char*
+#define FIELD_CTYPE_INT int
+#define FIELD_CTYPE_LONG long
+#define FIELD_CTYPE_ARRAY cJSON*
+#define REQUEST_MEMBER(member, key, type, required, def) FIELD_CTYPE_##type member;
+
+#define FIELD_SPEC(struct_type, member, key, type, required, def) \
+    { key, FIELD_##type, offsetof(struct_type, member), sizeof(((struct_type*)0)->member), required, def },
+
+#define CREDENTIALS_FIELDS(X)                    \
+    X(username, KEY_USERNAME, STRING, 1, 0)      \
+    X(password, KEY_PASSWORD, STRING, 1, 0)
+
+// CREATE_ROOM fills a storage Room directly; id and status are set by the handler
+#define CREATE_ROOM_FIELDS(X)                                 \
+    X(name, KEY_ROOM_NAME, TEXT, 1, 0)                        \
+    X(start_time, KEY_START_TIME, LONG, 1, 0)                 \
+    X(end_time, KEY_END_TIME, LONG, 1, 0)                     \
+    X(question_bank_id, KEY_QUESTION_BANK_ID, TEXT, 1, 0)     \
+    X(num_questions, KEY_NUM_QUESTIONS, INT, 0, 10)           \
+    X(allowed_attempts, KEY_ALLOWED_ATTEMPTS, INT, 0, 1)
+
+// A room as stored in data/rooms.json
+#define ROOM_RECORD_FIELDS(X)                                 \
+    X(id, KEY_ID, TEXT, 1, 0)                                 \
+    X(name, KEY_NAME, TEXT, 0, 0)                             \
+    X(start_time, KEY_START_TIME, LONG, 0, 0)                 \
+    X(end_time, KEY_END_TIME, LONG, 0, 0)                     \
+    X(question_bank_id, KEY_QUESTION_BANK_ID, TEXT, 0, 0)     \
+    X(status, KEY_STATUS, TEXT, 0, 0)                         \
+    X(num_questions, KEY_NUM_QUESTIONS, INT, 0, 10)           \
+    X(allowed_attempts, KEY_ALLOWED_ATTEMPTS, INT, 0, 1)
+
+// A result as journaled and stored in data/results/<room>.json
+#define RESULT_RECORD_FIELDS(X)                               \
+    X(room_id, KEY_ROOM_ID, TEXT, 0, 0)                       \
+    X(username, KEY_USERNAME, TEXT, 1, 0)                     \
+    X(score, KEY_SCORE, INT, 0, 0)                            \
+    X(timestamp, KEY_TIMESTAMP, LONG, 0, 0)                   \
+    X(seq, KEY_SEQ, LONG, 0, 0)
+
+// A user as journaled
+#define USER_RECORD_FIELDS(X)                                 \
+    X(username, KEY_USERNAME, STRING, 1, 0)                   \
+    X(password, KEY_PASSWORD, STRING, 1, 0)                   \
+    X(role, KEY_ROLE, STRING, 0, 0)
+
+#define IMPORT_QUESTIONS_FIELDS(X)               \
+    X(bank_name, KEY_BANK_NAME, STRING, 1, 0)    \
+    X(questions, KEY_QUESTIONS, ARRAY, 1, 0)
+
+#define BANK_REF_FIELDS(X) \
+    X(bank_id, KEY_BANK_ID, STRING, 1, 0)
+
+#define UPDATE_QUESTION_BANK_FIELDS(X)           \
+    X(bank_id, KEY_BANK_ID, STRING, 1, 0)        \
+    X(questions, KEY_QUESTIONS, ARRAY, 1, 0)
+
+#define ROOM_REF_FIELDS(X) \
+    X(room_id, KEY_ROOM_ID, STRING, 1, 0)
+
+// Pages of rooms by start time: limit (0 = the largest page), cursor from
+// the previous page, status, and start times in [from, to) (0 = unbounded)
+#define LIST_ROOMS_FIELDS(X)                               \
+    X(limit, KEY_LIMIT, INT, 0, 0)                         \
+    X(cursor, KEY_CURSOR, STRING, 0, 0)                    \
+    X(status, KEY_STATUS, STRING, 0, 0)                    \
+    X(from, KEY_FROM, LONG, 0, 0)                          \
+    X(to, KEY_TO, LONG, 0, 0)
+
+// include_results: 0 leaves the result list out, for dashboards polling the stats;
+// results come a page at a time (limit 0 = the largest page), order "time"
+// (default) or "score"
+#define ROOM_STATS_FIELDS(X)                               \
+    X(room_id, KEY_ROOM_ID, STRING, 1, 0)                  \
+    X(include_results, KEY_INCLUDE_RESULTS, INT, 0, 1)     \
+    X(limit, KEY_LIMIT, INT, 0, 0)                         \
+    X(cursor, KEY_CURSOR, STRING, 0, 0)                    \
+    X(order, KEY_ORDER, STRING, 0, 0)
+
+// limit: top entries, around: entries on each side of the user's own rank;
+// username picks another user, admins only
+#define LEADERBOARD_FIELDS(X)                              \
+    X(room_id, KEY_ROOM_ID, STRING, 1, 0)                  \
+    X(limit, KEY_LIMIT, INT, 0, 10)                        \
+    X(around, KEY_AROUND, INT, 0, 2)                       \
+    X(username, KEY_USERNAME, STRING, 0, 0)
+
+#define SUBMIT_RESULT_FIELDS(X)                  \
+    X(room_id, KEY_ROOM_ID, STRING, 1, 0)        \
+    X(answers, KEY_ANSWERS, ARRAY, 1, 0)
+
+typedef struct { CREDENTIALS_FIELDS(REQUEST_MEMBER) } CredentialsRequest;
+typedef struct { USER_RECORD_FIELDS(REQUEST_MEMBER) } UserRecord;
+typedef struct { IMPORT_QUESTIONS_FIELDS(REQUEST_MEMBER) } ImportQuestionsRequest;
+typedef struct { BANK_REF_FIELDS(REQUEST_MEMBER) } BankRefRequest;
+typedef struct { UPDATE_QUESTION_BANK_FIELDS(REQUEST_MEMBER) } UpdateQuestionBankRequest;
+typedef struct { ROOM_REF_FIELDS(REQUEST_MEMBER) } RoomRefRequest;
+typedef struct { LIST_ROOMS_FIELDS(REQUEST_MEMBER) } ListRoomsRequest;
+typedef struct { ROOM_STATS_FIELDS(REQUEST_MEMBER) } RoomStatsRequest;
+typedef struct { LEADERBOARD_FIELDS(REQUEST_MEMBER) } LeaderboardRequest;
+typedef struct { SUBMIT_RESULT_FIELDS(REQUEST_MEMBER) } SubmitResultRequest;
+
+extern const RequestSchema login_schema;
+extern const RequestSchema register_schema;
+extern const RequestSchema create_room_schema; // decodes into Room
+extern const RequestSchema room_record_schema; // decodes into Room
+extern const RequestSchema result_record_schema; // decodes into RoomResult
+extern const RequestSchema user_record_schema;
+extern const RequestSchema import_questions_schema;
+extern const RequestSchema get_question_bank_schema;
+extern const RequestSchema update_question_bank_schema;
+extern const RequestSchema delete_question_bank_schema;
+extern const RequestSchema list_rooms_schema;
+extern const RequestSchema room_stats_schema;
+extern const RequestSchema delete_room_schema;
+extern const RequestSchema leaderboard_schema;
+extern const RequestSchema submit_result_schema;
+
+// Fills *out (schema->struct_size bytes) from data. Returns NULL on success,
+// otherwise the schema's error message. Unknown keys are ignored and the
+// first occurrence of a duplicated key wins, as with cJSON_GetObjectItem.
+const char* request_decode(const RequestSchema* schema, const cJSON* data, void* out);
+
+#endif
@@ -2,6 +2,9 @@
 #define STORAGE_H
 
 #include "cJSON.h"
+#include "qbk.h"
+#include "ranking.h"
+#include <stddef.h>
 
 typedef struct
 {
@@ -16,19 +19,69 @@ typedef struct
 } Room;
 
 // User Management
+// Users are held in a hash table keyed by username; storage_load_users() replaces them.
+// Passwords are stored as given, normally a password_hash() string (see password.h);
+// checking one is left to the caller so it can run off the event loop.
+// Changes are journaled like rooms; storage_add_user() returns -2 for a
+// taken username and -3 when the journal append fails.
 void storage_init();
 int storage_load_users(const char* filename);
-int storage_check_credentials(const char* username, const char* password);
+const char* storage_get_password(const char* username); // NULL if there is no such user
+int storage_set_password(const char* username, const char* password);
 int storage_add_user(const char* username, const char* password, const char* role);
 int storage_user_exists(const char* username);
 const char* storage_get_role(const char* username);
 
 // Room Management
+// Rooms are held in memory; every mutation is journaled before it is applied
+int storage_load_rooms(const char* filename); // replaces the in-memory rooms, not journaled
 int storage_save_room(const Room* room);
+int storage_room_exists(const char* room_id);
 int storage_get_rooms(cJSON* rooms_array);
 int storage_update_room_status(const char* room_id, const char* status);
 int storage_delete_room(const char* room_id);
 cJSON* storage_get_room(const char* room_id);
+int storage_get_room_info(const char* room_id, Room* room);
+unsigned long storage_rooms_version(void); // changes whenever the room list does
+
+// A page of rooms ordered by start_time, then id, read from a sorted index
+// that is rebuilt after the room list changes. Cursors are opaque strings.
+#define STORAGE_CURSOR_SIZE 64
+
+typedef void (*StorageRoomFn)(const Room* room, void* ctx);
+
+typedef struct
+{
+    const char* status; // NULL = any
+    long from; // start_time >= from
+    long to; // start_time < to, 0 = no bound
+    const char* cursor; // NULL = first page, else a next cursor from before
+    int limit;
+} RoomPageQuery;
+
+// Calls fn for each room of the page (none if limit <= 0) and fills next with the cursor of the
+// following one, "" after the last page. -1 if the cursor is malformed.
+int storage_list_rooms_page(const RoomPageQuery* query, StorageRoomFn fn, void* ctx, char next[STORAGE_CURSOR_SIZE]);
+
+// Journal fsyncs and snapshot compaction run from storage_tick() once due;
+// storage_flush_timeout_ms() says when (-1 = nothing pending), suitable for poll().
+// storage_flush() waits for a running snapshot and writes a fresh one.
+//   QUIZZIE_JOURNAL_FSYNC     always | group (default) | interval
+//   QUIZZIE_JOURNAL_FSYNC_MS  interval policy period (1000)
+//   QUIZZIE_GROUP_COMMIT_US   group policy: longest a record waits for its batch (1000)
+//   QUIZZIE_GROUP_COMMIT_MAX  group policy: batch size that commits at once (256)
+//   QUIZZIE_SNAPSHOT_BYTES    journal size that triggers a snapshot (4 MB)
+//   QUIZZIE_SNAPSHOT_MS       oldest unsnapshotted change before one is taken (30 s)
+int storage_flush(void);
+int storage_flush_timeout_ms(void);
+void storage_tick(void);
+// Whether the mutation journaled as seq may be acknowledged; under the group
+// policy that is after the commit covering it, which storage_tick() performs
+int storage_is_durable(long seq);
+// Commits what is journaled now instead of when the policy would
+int storage_sync(void);
+cJSON* storage_journal_stats_to_json(void);
+cJSON* storage_engine_stats_to_json(void);
 
 // Result Management
 typedef struct
@@ -37,16 +90,64 @@ typedef struct
     char username[32];
     int score;
     long timestamp;
+    long seq; // journal lsn, set by storage_save_result
 } RoomResult;
 
-int storage_save_result(const RoomResult* result);
+typedef void (*StorageResultFn)(const RoomResult* result, void* ctx);
+
+int storage_save_result(RoomResult* result);
 int storage_get_room_results(const char* room_id, cJSON* results_array);
+// Streams a room's results in submission order without building a tree
+int storage_for_each_room_result(const char* room_id, StorageResultFn fn, void* ctx);
+
+// Per-room aggregates, built from the room's results on first use and then
+// kept current as results are saved, so later queries are O(1)
+#define ROOM_STATS_SCORE_SLOTS 128
+
+typedef struct
+{
+    long count;
+    long long sum;
+    double sum_squares;
+    int min_score;
+    int max_score;
+    unsigned int histogram[ROOM_STATS_SCORE_SLOTS]; // results per score, the last slot also counts higher ones
+} RoomStats;
+
+// Valid until the next storage call; NULL if it could not be allocated
+const RoomStats* storage_get_room_stats(const char* room_id);
+// The room's leaderboard (see ranking.h), kept current the same way; NULL
+// if it could not be allocated or the id is too long to have results
+const Ranking* storage_get_room_ranking(const char* room_id);
+// Results the user has in the room, from per-user counts kept the same way
+int storage_count_attempts(const char* room_id, const char* username);
+
+// A page of the room's results, in submission order or by score (higher
+// first, then submission order), from an in-memory index of the room's
+// results kept current the same way. Cursors and next as for rooms.
+typedef struct
+{
+    int by_score;
+    const char* cursor;
+    int limit;
+} ResultPageQuery;
+
+int storage_room_results_page(const char* room_id, const ResultPageQuery* query, StorageResultFn fn, void* ctx,
+                              char next[STORAGE_CURSOR_SIZE]);
 
 // Question Management
+// Banks are .qbk files served from a cache of their mappings, up to
+// QUIZZIE_BANK_CACHE_BYTES (64 MB), least recently used evicted first.
+// Views and exports are borrowed until the next question bank call.
+// Saves and deletes are journaled; until the next snapshot the bank is
+// served from the bytes kept in memory.
 int storage_save_question_bank(const char* bank_name, cJSON* questions);
 int storage_list_question_banks(cJSON* banks_array);
-int storage_get_question_bank(const char* bank_id, cJSON** questions);
+int storage_get_question_bank(const char* bank_id, QbkView* bank);
+// The bank as a JSON questions array, unformatted, for the editor
+int storage_export_question_bank(const char* bank_id, const char** json, size_t* len);
 int storage_update_question_bank(const char* bank_id, cJSON* questions);
 int storage_delete_question_bank(const char* bank_id);
+cJSON* storage_bank_cache_stats_to_json(void);
 
 #endif
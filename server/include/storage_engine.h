@@ -0,0 +1,111 @@
+#ifndef STORAGE_ENGINE_H
+#define STORAGE_ENGINE_H
+
+#include "cJSON.h"
+#include "storage.h"
+#include <stdint.h>
+
+// Where storage.c keeps its data between runs. storage.c owns the in-memory
+// users and rooms, the journal, pending results and the bank cache; an engine
+// loads that state at startup, persists snapshots of it and serves stored
+// results and banks. Everything runs on the event loop except
+// write_snapshot, which runs on the snapshot thread and must not use cJSON.
+// The loop never writes to an engine: user and bank changes are journaled
+// too and reach the engine with the next snapshot.
+//   QUIZZIE_STORAGE_ENGINE   files | paged | sqlite (only with make SQLITE=1)
+// The default is files, or sqlite when it is built in.
+
+typedef struct
+{
+    const char* name;
+    size_t name_len;
+    const char* password;
+    size_t password_len;
+    const char* role; // NULL = default role
+    size_t role_len;
+} StorageUser;
+
+// Users arrive in batches of at most STORAGE_USER_BATCH, valid for the call;
+// expected is the engine's guess of the total (0 = unknown) so the table can
+// be sized once
+#define STORAGE_USER_BATCH 16
+typedef int (*StorageUserFn)(const StorageUser* users, int count, int expected, void* ctx);
+typedef void (*StorageNameFn)(const char* name, void* ctx);
+
+typedef struct
+{
+    const char* id;
+    const void* data; // qbk bytes, NULL = deleted
+    size_t size;
+} StorageBankChange;
+
+// The state a snapshot persists, as of lsn. Results are the pending ones up
+// to lsn, grouped by room in seq order; the engine skips any it already holds.
+// Users and banks are the ones changed since the last snapshot, in their
+// current state. All of it is borrowed for the prepare_snapshot call.
+typedef struct
+{
+    uint64_t lsn;
+    const Room* rooms;
+    int room_count;
+    const RoomResult* results;
+    int result_count;
+    const StorageUser* users;
+    int user_count;
+    const StorageBankChange* banks;
+    int bank_count;
+} StorageSnapshot;
+
+typedef struct
+{
+    const void* data; // qbk bytes
+    size_t size;
+    void* handle; // for release_bank
+    uint64_t stamp[3]; // what was loaded, for bank_is_current
+} StorageBank;
+
+typedef struct
+{
+    const char* name;
+    int (*open)(void); // 0 on success
+    void (*close)(void);
+    uint64_t (*checkpoint_lsn)(void); // journal lsn the stored snapshot covers
+
+    int (*load_users)(StorageUserFn fn, void* ctx);
+    int (*load_rooms)(StorageRoomFn fn, void* ctx);
+    // Stored results in submission order; returns the highest seq stored
+    long (*for_each_result)(const char* room_id, StorageResultFn fn, void* ctx);
+    int (*list_result_rooms)(StorageNameFn fn, void* ctx);
+
+    // prepare copies what it needs on the loop, write runs on the snapshot
+    // thread and records the lsn last, free runs on the loop afterwards
+    void* (*prepare_snapshot)(const StorageSnapshot* snapshot);
+    int (*write_snapshot)(void* job);
+    void (*free_snapshot)(void* job);
+
+    int (*load_bank)(const char* bank_id, StorageBank* bank);
+    // Whether anything is stored under bank_id, readable or not, so a corrupt bank can still be deleted
+    int (*bank_exists)(const char* bank_id);
+    void (*release_bank)(StorageBank* bank);
+    // NULL when banks only change through snapshots
+    int (*bank_is_current)(const char* bank_id, const StorageBank* bank);
+    int (*list_banks)(StorageNameFn fn, void* ctx);
+
+    cJSON* (*stats_to_json)(void); // NULL = nothing to report
+} StorageEngine;
+
+extern const StorageEngine storage_engine_files;
+extern const StorageEngine storage_engine_paged;
+#ifdef QUIZZIE_SQLITE
+extern const StorageEngine storage_engine_sqlite;
+#endif
+
+// Shared with the engines by storage.c
+cJSON* storage_room_to_json(const Room* room);
+cJSON* storage_result_to_json(const RoomResult* result, int with_seq);
+
+// The files engine's readers, also behind storage_load_users/storage_load_rooms
+int storage_file_scan_users(const char* path, StorageUserFn fn, void* ctx);
+int storage_file_scan_rooms(const char* path, StorageRoomFn fn, void* ctx);
+
+#endif
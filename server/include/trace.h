@@ -0,0 +1,20 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Opt-in request tracing exported as Chrome/Perfetto trace-event JSON.
+//   QUIZZIE_TRACE_SAMPLE   trace one request in N (0 = off)
+//   QUIZZIE_TRACE_SLOW_US  also keep every request slower than this
+//   QUIZZIE_TRACE_EVENTS   per-thread ring buffer capacity
+//   QUIZZIE_TRACE_FILE     dump target, written on SIGUSR1 or trace_dump()
+
+void trace_init(void);
+void trace_request_begin(void);
+void trace_request_end(const char* label);
+uint64_t trace_span_begin(void);
+void trace_span_end(const char* name, uint64_t start);
+int trace_dump(const char* path);
+void trace_handle_pending_dump(void);
+
+#endif
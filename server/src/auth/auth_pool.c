@@ -0,0 +1,261 @@
+#include "auth_pool.h"
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_WORKERS 64
+
+static pthread_t workers[MAX_WORKERS];
+static int worker_count = 0;
+static unsigned long iterations = PASSWORD_DEFAULT_ITERATIONS;
+static int wake_pipe[2] = { -1, -1 };
+static char unknown_user_hash[PASSWORD_HASH_MAX];
+
+// Both lists and the stats are guarded by lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static AuthJob* queue_head;
+static AuthJob* queue_tail;
+static AuthJob* done_head;
+static AuthJob* done_tail;
+static int stopping = 0;
+
+typedef struct
+{
+    unsigned long long submitted;
+    unsigned long long completed;
+    int queued;
+    int max_queued;
+    unsigned long long work_us;
+    unsigned long long wait_us;
+    unsigned long long max_wait_us;
+} AuthPoolStats;
+
+static AuthPoolStats stats;
+
+static unsigned long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void run_job(AuthJob* job)
+{
+    if (job->type == AUTH_VERIFY) {
+        job->ok = password_verify(job->password, job->stored);
+        // Plaintext left by an old users file is replaced on the first good login
+        if (job->ok && !password_is_hashed(job->stored))
+            job->rehashed = password_hash(job->password, iterations, job->stored) == 0;
+    } else {
+        job->ok = password_hash(job->password, iterations, job->stored) == 0;
+    }
+    // The plaintext is not needed past this point
+    memset(job->password, 0, strlen(job->password));
+}
+
+static void* worker_main(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    while (1) {
+        while (!queue_head && !stopping)
+            pthread_cond_wait(&work_ready, &lock);
+        if (stopping)
+            break;
+        AuthJob* job = queue_head;
+        queue_head = job->next;
+        if (!queue_head)
+            queue_tail = NULL;
+        stats.queued--;
+        unsigned long long started = now_us();
+        unsigned long long waited = started - job->submitted_us;
+        stats.wait_us += waited;
+        if (waited > stats.max_wait_us)
+            stats.max_wait_us = waited;
+        pthread_mutex_unlock(&lock);
+
+        run_job(job);
+        job->next = NULL;
+
+        pthread_mutex_lock(&lock);
+        stats.work_us += now_us() - started;
+        stats.completed++;
+        int was_empty = done_head == NULL;
+        if (done_tail)
+            done_tail->next = job;
+        else
+            done_head = job;
+        done_tail = job;
+        // One byte per empty-to-non-empty change; the loop takes everything on wakeup
+        if (was_empty && write(wake_pipe[1], "", 1) < 0 && errno != EAGAIN)
+            perror("auth wake");
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+int auth_pool_start(void)
+{
+    if (worker_count > 0)
+        return 0;
+    long n = config_get_long("QUIZZIE_AUTH_WORKERS", 0);
+    if (n <= 0)
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n <= 0)
+        n = 1;
+    if (n > MAX_WORKERS)
+        n = MAX_WORKERS;
+    long iter = config_get_long("QUIZZIE_PBKDF2_ITERATIONS", PASSWORD_DEFAULT_ITERATIONS);
+    if (iter > 0)
+        iterations = (unsigned long)iter;
+
+    // Callers reject a match against it, so the password hashed does not matter
+    if (password_hash("unknown user", iterations, unknown_user_hash) != 0 || pipe(wake_pipe) != 0)
+        return -1;
+    for (int i = 0; i < 2; i++)
+        fcntl(wake_pipe[i], F_SETFL, fcntl(wake_pipe[i], F_GETFL) | O_NONBLOCK);
+
+    stopping = 0;
+    for (int i = 0; i < n; i++) {
+        if (pthread_create(&workers[worker_count], NULL, worker_main, NULL) != 0)
+            break;
+        worker_count++;
+    }
+    if (worker_count == 0) {
+        close(wake_pipe[0]);
+        close(wake_pipe[1]);
+        wake_pipe[0] = wake_pipe[1] = -1;
+        return -1;
+    }
+    printf("Auth pool: %d workers, %lu PBKDF2 iterations.\n", worker_count, iterations);
+    return 0;
+}
+
+static void free_list(AuthJob* job)
+{
+    while (job) {
+        AuthJob* next = job->next;
+        auth_job_free(job);
+        job = next;
+    }
+}
+
+void auth_pool_stop(void)
+{
+    if (worker_count == 0)
+        return;
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_broadcast(&work_ready);
+    pthread_mutex_unlock(&lock);
+    for (int i = 0; i < worker_count; i++)
+        pthread_join(workers[i], NULL);
+    worker_count = 0;
+
+    free_list(queue_head);
+    free_list(done_head);
+    queue_head = queue_tail = done_head = done_tail = NULL;
+    stats.queued = 0;
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    wake_pipe[0] = wake_pipe[1] = -1;
+}
+
+int auth_pool_fd(void)
+{
+    return wake_pipe[0];
+}
+
+const char* auth_pool_unknown_user_hash(void)
+{
+    return unknown_user_hash;
+}
+
+AuthJob* auth_job_new(AuthJobType type, int client_idx, unsigned long client_gen, const char* username,
+                      const char* password)
+{
+    AuthJob* job = calloc(1, sizeof(AuthJob));
+    if (!job)
+        return NULL;
+    job->type = type;
+    job->client_idx = client_idx;
+    job->client_gen = client_gen;
+    job->username = strdup(username);
+    job->password = strdup(password);
+    if (!job->username || !job->password) {
+        auth_job_free(job);
+        return NULL;
+    }
+    return job;
+}
+
+void auth_job_free(AuthJob* job)
+{
+    if (!job)
+        return;
+    if (job->password)
+        memset(job->password, 0, strlen(job->password));
+    free(job->password);
+    free(job->username);
+    free(job);
+}
+
+int auth_pool_submit(AuthJob* job)
+{
+    if (worker_count == 0)
+        return -1;
+    job->next = NULL;
+    job->submitted_us = now_us();
+    pthread_mutex_lock(&lock);
+    if (queue_tail)
+        queue_tail->next = job;
+    else
+        queue_head = job;
+    queue_tail = job;
+    stats.submitted++;
+    if (++stats.queued > stats.max_queued)
+        stats.max_queued = stats.queued;
+    pthread_cond_signal(&work_ready);
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+AuthJob* auth_pool_take_done(void)
+{
+    // Drain the pipe before taking the list: a job finished in between is
+    // either taken now or wakes the loop again, never lost
+    char buf[64];
+    while (read(wake_pipe[0], buf, sizeof(buf)) > 0)
+        ;
+    pthread_mutex_lock(&lock);
+    AuthJob* jobs = done_head;
+    done_head = done_tail = NULL;
+    pthread_mutex_unlock(&lock);
+    return jobs;
+}
+
+cJSON* auth_pool_stats_to_json(void)
+{
+    pthread_mutex_lock(&lock);
+    AuthPoolStats snapshot = stats;
+    pthread_mutex_unlock(&lock);
+
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "workers", worker_count);
+    cJSON_AddNumberToObject(obj, "iterations", (double)iterations);
+    cJSON_AddNumberToObject(obj, "submitted", (double)snapshot.submitted);
+    cJSON_AddNumberToObject(obj, "completed", (double)snapshot.completed);
+    cJSON_AddNumberToObject(obj, "queued", snapshot.queued);
+    cJSON_AddNumberToObject(obj, "max_queued", snapshot.max_queued);
+    cJSON_AddNumberToObject(obj, "work_us", (double)snapshot.work_us);
+    cJSON_AddNumberToObject(obj, "wait_us", (double)snapshot.wait_us);
+    cJSON_AddNumberToObject(obj, "max_wait_us", (double)snapshot.max_wait_us);
+    return obj;
+}
@@ -0,0 +1,319 @@
+#include "password.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HASH_PREFIX "pbkdf2-sha256$"
+#define MAX_ITERATIONS 100000000UL
+
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t length; // bytes hashed so far
+    unsigned char block[64];
+    size_t used;
+} Sha256;
+
+static const uint32_t round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_compress(uint32_t state[8], const unsigned char block[64])
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8
+               | block[i * 4 + 3];
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + round_constants[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static void sha256_init(Sha256* ctx)
+{
+    static const uint32_t initial[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+static void sha256_update(Sha256* ctx, const void* data, size_t len)
+{
+    const unsigned char* p = data;
+    ctx->length += len;
+    while (len > 0) {
+        size_t n = 64 - ctx->used;
+        if (n > len)
+            n = len;
+        memcpy(ctx->block + ctx->used, p, n);
+        ctx->used += n;
+        p += n;
+        len -= n;
+        if (ctx->used == 64) {
+            sha256_compress(ctx->state, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+static void store_state(const uint32_t state[8], unsigned char* out)
+{
+    for (int i = 0; i < 8; i++) {
+        out[i * 4] = (unsigned char)(state[i] >> 24);
+        out[i * 4 + 1] = (unsigned char)(state[i] >> 16);
+        out[i * 4 + 2] = (unsigned char)(state[i] >> 8);
+        out[i * 4 + 3] = (unsigned char)state[i];
+    }
+}
+
+static void sha256_final(Sha256* ctx, unsigned char out[32])
+{
+    uint64_t bits = ctx->length * 8;
+    unsigned char pad = 0x80;
+    sha256_update(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->used != 56)
+        sha256_update(ctx, &pad, 1);
+    unsigned char len_be[8];
+    for (int i = 0; i < 8; i++)
+        len_be[i] = (unsigned char)(bits >> (56 - i * 8));
+    sha256_update(ctx, len_be, 8);
+    store_state(ctx->state, out);
+}
+
+void password_sha256(const void* data, size_t len, unsigned char out[32])
+{
+    Sha256 ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, out);
+}
+
+// HMAC keyed once: the inner and outer states after the padded key block
+typedef struct
+{
+    Sha256 inner;
+    Sha256 outer;
+} HmacKey;
+
+static void hmac_init(HmacKey* key, const char* secret, size_t len)
+{
+    unsigned char block[64];
+    memset(block, 0, sizeof(block));
+    if (len > sizeof(block))
+        password_sha256(secret, len, block);
+    else
+        memcpy(block, secret, len);
+
+    unsigned char pad[64];
+    for (int i = 0; i < 64; i++)
+        pad[i] = block[i] ^ 0x36;
+    sha256_init(&key->inner);
+    sha256_update(&key->inner, pad, sizeof(pad));
+    for (int i = 0; i < 64; i++)
+        pad[i] = block[i] ^ 0x5c;
+    sha256_init(&key->outer);
+    sha256_update(&key->outer, pad, sizeof(pad));
+}
+
+static void hmac(const HmacKey* key, const void* data, size_t len, const void* data2, size_t len2,
+                 unsigned char out[32])
+{
+    Sha256 ctx = key->inner;
+    sha256_update(&ctx, data, len);
+    if (len2)
+        sha256_update(&ctx, data2, len2);
+    unsigned char inner[32];
+    sha256_final(&ctx, inner);
+    ctx = key->outer;
+    sha256_update(&ctx, inner, sizeof(inner));
+    sha256_final(&ctx, out);
+}
+
+// HMAC of a 32-byte message in place. Both messages are one block after the
+// key's, so the padding is laid out once and each call is two compressions.
+static void hmac_32(const HmacKey* key, unsigned char block[64], unsigned char u[32])
+{
+    uint32_t state[8];
+    memcpy(block, u, 32);
+    memcpy(state, key->inner.state, sizeof(state));
+    sha256_compress(state, block);
+    store_state(state, block);
+    memcpy(state, key->outer.state, sizeof(state));
+    sha256_compress(state, block);
+    store_state(state, u);
+}
+
+// The key's pad blocks are hashed once up front, so each iteration costs two compressions
+void password_pbkdf2_sha256(const char* password, size_t password_len, const unsigned char* salt,
+                            size_t salt_len, unsigned long iterations, unsigned char* out, size_t out_len)
+{
+    HmacKey key;
+    hmac_init(&key, password, password_len);
+
+    for (uint32_t block = 1; out_len > 0; block++) {
+        unsigned char index[4] = { (unsigned char)(block >> 24), (unsigned char)(block >> 16),
+                                   (unsigned char)(block >> 8), (unsigned char)block };
+        unsigned char u[32], t[32];
+        hmac(&key, salt, salt_len, index, sizeof(index), u);
+        memcpy(t, u, sizeof(t));
+
+        // 32 message bytes after the 64-byte key block: 768 bits
+        unsigned char padded[64];
+        memset(padded, 0, sizeof(padded));
+        padded[32] = 0x80;
+        padded[62] = 0x03;
+        for (unsigned long i = 1; i < iterations; i++) {
+            hmac_32(&key, padded, u);
+            for (int k = 0; k < 32; k++)
+                t[k] ^= u[k];
+        }
+        size_t n = out_len < sizeof(t) ? out_len : sizeof(t);
+        memcpy(out, t, n);
+        out += n;
+        out_len -= n;
+    }
+}
+
+static int random_bytes(unsigned char* out, size_t len)
+{
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0)
+        return -1;
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, out + got, len - got);
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    close(fd);
+    return got == len ? 0 : -1;
+}
+
+static void to_hex(const unsigned char* in, size_t len, char* out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[i * 2] = digits[in[i] >> 4];
+        out[i * 2 + 1] = digits[in[i] & 15];
+    }
+    out[len * 2] = '\0';
+}
+
+static int from_hex(const char* in, size_t len, unsigned char* out)
+{
+    for (size_t i = 0; i < len; i++) {
+        int v = 0;
+        for (int k = 0; k < 2; k++) {
+            char c = in[i * 2 + k];
+            int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            if (d < 0)
+                return -1;
+            v = v * 16 + d;
+        }
+        out[i] = (unsigned char)v;
+    }
+    return 0;
+}
+
+int password_hash(const char* password, unsigned long iterations, char out[PASSWORD_HASH_MAX])
+{
+    unsigned char salt[PASSWORD_SALT_LEN];
+    unsigned char key[PASSWORD_KEY_LEN];
+    if (iterations == 0 || iterations > MAX_ITERATIONS || random_bytes(salt, sizeof(salt)) != 0)
+        return -1;
+    password_pbkdf2_sha256(password, strlen(password), salt, sizeof(salt), iterations, key, sizeof(key));
+
+    char salt_hex[PASSWORD_SALT_LEN * 2 + 1];
+    char key_hex[PASSWORD_KEY_LEN * 2 + 1];
+    to_hex(salt, sizeof(salt), salt_hex);
+    to_hex(key, sizeof(key), key_hex);
+    snprintf(out, PASSWORD_HASH_MAX, HASH_PREFIX "%lu$%s$%s", iterations, salt_hex, key_hex);
+    return 0;
+}
+
+int password_is_hashed(const char* stored)
+{
+    return strncmp(stored, HASH_PREFIX, strlen(HASH_PREFIX)) == 0;
+}
+
+// Compares without an early exit, so the time taken does not depend on where they differ
+static int equal_bytes(const unsigned char* a, const unsigned char* b, size_t len)
+{
+    unsigned char diff = 0;
+    for (size_t i = 0; i < len; i++)
+        diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+int password_verify(const char* password, const char* stored)
+{
+    if (!password_is_hashed(stored)) {
+        // Legacy plaintext: compare digests so the lengths do not leak either
+        unsigned char a[32], b[32];
+        password_sha256(password, strlen(password), a);
+        password_sha256(stored, strlen(stored), b);
+        return equal_bytes(a, b, sizeof(a));
+    }
+
+    const char* p = stored + strlen(HASH_PREFIX);
+    char* end;
+    unsigned long iterations = strtoul(p, &end, 10);
+    if (end == p || *end != '$' || iterations == 0 || iterations > MAX_ITERATIONS)
+        return 0;
+    const char* salt_hex = end + 1;
+    const char* key_hex = strchr(salt_hex, '$');
+    if (!key_hex)
+        return 0;
+    size_t salt_len = (size_t)(key_hex - salt_hex) / 2;
+    key_hex++;
+    unsigned char salt[64];
+    unsigned char expected[PASSWORD_KEY_LEN];
+    if ((size_t)(key_hex - 1 - salt_hex) != salt_len * 2 || salt_len == 0 || salt_len > sizeof(salt)
+        || strlen(key_hex) != sizeof(expected) * 2 || from_hex(salt_hex, salt_len, salt) != 0
+        || from_hex(key_hex, sizeof(expected), expected) != 0)
+        return 0;
+
+    unsigned char key[PASSWORD_KEY_LEN];
+    password_pbkdf2_sha256(password, strlen(password), salt, salt_len, iterations, key, sizeof(key));
+    return equal_bytes(key, expected, sizeof(key));
+}
@@ -0,0 +1,19 @@
+#include "config.h"
+#include <stdlib.h>
+
+long config_get_long(const char* name, long default_value)
+{
+    const char* value = getenv(name);
+    if (!value || !*value)
+        return default_value;
+
+    char* end;
+    long parsed = strtol(value, &end, 10);
+    return (*end == '\0') ? parsed : default_value;
+}
+
+const char* config_get_str(const char* name, const char* default_value)
+{
+    const char* value = getenv(name);
+    return (value && *value) ? value : default_value;
+}
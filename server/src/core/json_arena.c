@@ -0,0 +1,180 @@
+#include "json_arena.h"
+#include "config.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 16
+#define DEFAULT_CHUNK_SIZE (64 * 1024)
+#define DEFAULT_RETAIN_BYTES (1024 * 1024)
+
+typedef struct ArenaChunk
+{
+    struct ArenaChunk* next;
+    size_t size;
+    size_t used;
+    char* data;
+} ArenaChunk;
+
+static int arena_enabled = 1;
+static int arena_active = 0;
+static size_t chunk_size = DEFAULT_CHUNK_SIZE;
+static size_t retain_bytes = DEFAULT_RETAIN_BYTES;
+
+// Chunks in use by the current request, newest first, and spares kept for reuse
+static ArenaChunk* used_chunks = NULL;
+static ArenaChunk* free_chunks = NULL;
+static size_t request_bytes = 0;
+
+static JsonArenaStats stats;
+
+static ArenaChunk* chunk_new(size_t min_size)
+{
+    size_t size = min_size > chunk_size ? min_size : chunk_size;
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size + ARENA_ALIGN);
+    if (!chunk)
+        return NULL;
+    stats.chunk_mallocs++;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->data = (char*)(((uintptr_t)(chunk + 1) + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+    chunk->next = NULL;
+    return chunk;
+}
+
+static ArenaChunk* chunk_acquire(size_t min_size)
+{
+    ArenaChunk** link = &free_chunks;
+    while (*link) {
+        if ((*link)->size >= min_size) {
+            ArenaChunk* chunk = *link;
+            *link = chunk->next;
+            chunk->used = 0;
+            return chunk;
+        }
+        link = &(*link)->next;
+    }
+    return chunk_new(min_size);
+}
+
+static int arena_owns(const void* ptr)
+{
+    for (ArenaChunk* c = used_chunks; c; c = c->next) {
+        if ((const char*)ptr >= c->data && (const char*)ptr < c->data + c->size)
+            return 1;
+    }
+    return 0;
+}
+
+static void* arena_malloc(size_t size)
+{
+    if (!arena_active) {
+        stats.heap_mallocs++;
+        return malloc(size);
+    }
+
+    size_t rounded = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaChunk* chunk = used_chunks;
+    if (!chunk || chunk->size - chunk->used < rounded) {
+        chunk = chunk_acquire(rounded);
+        if (!chunk)
+            return NULL;
+        chunk->next = used_chunks;
+        used_chunks = chunk;
+    }
+
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += rounded;
+    request_bytes += rounded;
+    stats.arena_allocs++;
+    stats.arena_bytes += rounded;
+    return ptr;
+}
+
+static void arena_free(void* ptr)
+{
+    if (!ptr)
+        return;
+    if (arena_active && arena_owns(ptr))
+        return;
+    stats.heap_frees++;
+    free(ptr);
+}
+
+void json_arena_init(void)
+{
+    arena_enabled = config_get_long("QUIZZIE_JSON_ARENA", 1) != 0;
+    long size = config_get_long("QUIZZIE_JSON_ARENA_CHUNK", DEFAULT_CHUNK_SIZE);
+    if (size >= 4096)
+        chunk_size = (size_t)size;
+
+    cJSON_Hooks hooks = { arena_malloc, arena_free };
+    cJSON_InitHooks(&hooks);
+}
+
+void json_arena_begin(void)
+{
+    if (!arena_enabled)
+        return;
+    arena_active = 1;
+    request_bytes = 0;
+}
+
+// Releases every allocation of the request; spare chunks up to retain_bytes
+// are kept so steady-state requests do not touch malloc at all
+void json_arena_end(void)
+{
+    stats.requests++;
+    if (!arena_active)
+        return;
+    arena_active = 0;
+
+    if (request_bytes > stats.peak_request_bytes)
+        stats.peak_request_bytes = request_bytes;
+
+    size_t retained = 0;
+    for (ArenaChunk* c = free_chunks; c; c = c->next)
+        retained += c->size;
+
+    while (used_chunks) {
+        ArenaChunk* chunk = used_chunks;
+        used_chunks = chunk->next;
+        if (retained + chunk->size <= retain_bytes) {
+            chunk->next = free_chunks;
+            free_chunks = chunk;
+            retained += chunk->size;
+        } else {
+            free(chunk);
+        }
+    }
+}
+
+int json_arena_active(void)
+{
+    return arena_active;
+}
+
+void json_release(cJSON* item)
+{
+    if (!arena_active)
+        cJSON_Delete(item);
+}
+
+void json_arena_get_stats(JsonArenaStats* out)
+{
+    *out = stats;
+}
+
+cJSON* json_arena_stats_to_json(void)
+{
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddBoolToObject(obj, "enabled", arena_enabled);
+    cJSON_AddNumberToObject(obj, "requests", (double)stats.requests);
+    cJSON_AddNumberToObject(obj, "heap_mallocs", (double)stats.heap_mallocs);
+    cJSON_AddNumberToObject(obj, "heap_frees", (double)stats.heap_frees);
+    cJSON_AddNumberToObject(obj, "arena_allocs", (double)stats.arena_allocs);
+    cJSON_AddNumberToObject(obj, "arena_bytes", (double)stats.arena_bytes);
+    cJSON_AddNumberToObject(obj, "chunk_mallocs", (double)stats.chunk_mallocs);
+    cJSON_AddNumberToObject(obj, "peak_request_bytes", (double)stats.peak_request_bytes);
+    return obj;
+}
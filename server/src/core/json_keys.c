@@ -0,0 +1,26 @@
+#include "json_keys.h"
+
+static const char* key_names[KEY_COUNT] = {
+#define X(id, name) name,
+    PROTOCOL_KEY_LIST(X)
+#undef X
+};
+
+static unsigned int key_hashes[KEY_COUNT];
+
+const char* json_key_name(JsonKey key)
+{
+    return key_names[key];
+}
+
+unsigned int json_key_hash(JsonKey key)
+{
+    if (!key_hashes[key])
+        key_hashes[key] = cJSON_HashKey(key_names[key]);
+    return key_hashes[key];
+}
+
+cJSON* json_get(const cJSON* object, JsonKey key)
+{
+    return cJSON_GetObjectItemHashed(object, key_names[key], json_key_hash(key));
+}
@@ -0,0 +1,133 @@
+#include "request.h"
+#include <string.h>
+
+#define SCHEMA(name, struct_type, list, message)                                  \
+    static const FieldSpec name##_fields[] = { list(name##_SPEC) };               \
+    const RequestSchema name##_schema = {                                          \
+        name##_fields, sizeof(name##_fields) / sizeof(name##_fields[0]),          \
+        sizeof(struct_type), message                                               \
+    };
+
+#define login_SPEC(...) FIELD_SPEC(CredentialsRequest, __VA_ARGS__)
+#define register_SPEC(...) FIELD_SPEC(CredentialsRequest, __VA_ARGS__)
+#define create_room_SPEC(...) FIELD_SPEC(Room, __VA_ARGS__)
+#define room_record_SPEC(...) FIELD_SPEC(Room, __VA_ARGS__)
+#define result_record_SPEC(...) FIELD_SPEC(RoomResult, __VA_ARGS__)
+#define user_record_SPEC(...) FIELD_SPEC(UserRecord, __VA_ARGS__)
+#define import_questions_SPEC(...) FIELD_SPEC(ImportQuestionsRequest, __VA_ARGS__)
+#define get_question_bank_SPEC(...) FIELD_SPEC(BankRefRequest, __VA_ARGS__)
+#define update_question_bank_SPEC(...) FIELD_SPEC(UpdateQuestionBankRequest, __VA_ARGS__)
+#define delete_question_bank_SPEC(...) FIELD_SPEC(BankRefRequest, __VA_ARGS__)
+#define list_rooms_SPEC(...) FIELD_SPEC(ListRoomsRequest, __VA_ARGS__)
+#define room_stats_SPEC(...) FIELD_SPEC(RoomStatsRequest, __VA_ARGS__)
+#define delete_room_SPEC(...) FIELD_SPEC(RoomRefRequest, __VA_ARGS__)
+#define leaderboard_SPEC(...) FIELD_SPEC(LeaderboardRequest, __VA_ARGS__)
+#define submit_result_SPEC(...) FIELD_SPEC(SubmitResultRequest, __VA_ARGS__)
+
+SCHEMA(login, CredentialsRequest, CREDENTIALS_FIELDS, "Invalid format")
+SCHEMA(register, CredentialsRequest, CREDENTIALS_FIELDS, "Invalid format")
+SCHEMA(create_room, Room, CREATE_ROOM_FIELDS, "Invalid room data")
+SCHEMA(room_record, Room, ROOM_RECORD_FIELDS, "Invalid room record")
+SCHEMA(result_record, RoomResult, RESULT_RECORD_FIELDS, "Invalid result record")
+SCHEMA(user_record, UserRecord, USER_RECORD_FIELDS, "Invalid user record")
+SCHEMA(import_questions, ImportQuestionsRequest, IMPORT_QUESTIONS_FIELDS, "Invalid question data")
+SCHEMA(get_question_bank, BankRefRequest, BANK_REF_FIELDS, "Invalid bank id")
+SCHEMA(update_question_bank, UpdateQuestionBankRequest, UPDATE_QUESTION_BANK_FIELDS, "Invalid data")
+SCHEMA(delete_question_bank, BankRefRequest, BANK_REF_FIELDS, "Invalid bank id")
+SCHEMA(list_rooms, ListRoomsRequest, LIST_ROOMS_FIELDS, "Invalid room query")
+SCHEMA(room_stats, RoomStatsRequest, ROOM_STATS_FIELDS, "Invalid room id")
+SCHEMA(delete_room, RoomRefRequest, ROOM_REF_FIELDS, "Invalid room id")
+SCHEMA(leaderboard, LeaderboardRequest, LEADERBOARD_FIELDS, "Invalid room id")
+SCHEMA(submit_result, SubmitResultRequest, SUBMIT_RESULT_FIELDS, "Invalid submission")
+
+// Clients send keys in schema order, so the search starts at the field after the last match
+static int find_field(const RequestSchema* schema, const cJSON* item, int start)
+{
+    if (!item->string)
+        return -1;
+    unsigned int hash = item->string_hash ? item->string_hash : cJSON_HashKey(item->string);
+    for (int n = 0; n < schema->count; n++) {
+        int i = (start + n) % schema->count;
+        JsonKey key = schema->fields[i].key;
+        if (json_key_hash(key) == hash && strcmp(json_key_name(key), item->string) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Stores one value, 0 if it has the wrong JSON type
+static int store_field(const FieldSpec* spec, const cJSON* item, char* out)
+{
+    void* dst = out + spec->offset;
+    switch (spec->type) {
+    case FIELD_STRING:
+        if (!cJSON_IsString(item))
+            return 0;
+        *(const char**)dst = item->valuestring;
+        return 1;
+    case FIELD_TEXT: {
+        if (!cJSON_IsString(item))
+            return 0;
+        size_t n = strlen(item->valuestring);
+        if (n > spec->size - 1)
+            n = spec->size - 1;
+        memcpy(dst, item->valuestring, n);
+        ((char*)dst)[n] = '\0';
+        return 1;
+    }
+    case FIELD_INT:
+        if (!cJSON_IsNumber(item))
+            return 0;
+        *(int*)dst = item->valueint;
+        return 1;
+    case FIELD_LONG:
+        if (!cJSON_IsNumber(item))
+            return 0;
+        *(long*)dst = (long)item->valuedouble;
+        return 1;
+    case FIELD_ARRAY:
+        if (!cJSON_IsArray(item))
+            return 0;
+        *(cJSON**)dst = (cJSON*)item;
+        return 1;
+    }
+    return 0;
+}
+
+static void store_default(const FieldSpec* spec, char* out)
+{
+    void* dst = out + spec->offset;
+    switch (spec->type) {
+    case FIELD_INT: *(int*)dst = (int)spec->def; break;
+    case FIELD_LONG: *(long*)dst = spec->def; break;
+    default: break; // pointers and text were zeroed
+    }
+}
+
+const char* request_decode(const RequestSchema* schema, const cJSON* data, void* out)
+{
+    memset(out, 0, schema->struct_size);
+    if (!cJSON_IsObject(data))
+        return schema->error;
+
+    unsigned int seen = 0;
+    int next = 0;
+    for (const cJSON* item = data->child; item; item = item->next) {
+        int i = find_field(schema, item, next);
+        if (i < 0 || (seen & (1u << i)))
+            continue;
+        if (!store_field(&schema->fields[i], item, out))
+            return schema->error;
+        seen |= 1u << i;
+        next = i + 1;
+    }
+
+    for (int i = 0; i < schema->count; i++) {
+        if (seen & (1u << i))
+            continue;
+        if (schema->fields[i].required)
+            return schema->error;
+        store_default(&schema->fields[i], out);
+    }
+    return NULL;
+}
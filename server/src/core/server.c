@@ -1,8 +1,16 @@
 #include "server.h"
+#include "auth_pool.h"
+#include "json_arena.h"
+#include "json_keys.h"
+#include "json_writer.h"
 #include "net.h"
 #include "protocol.h"
+#include "request.h"
 #include "storage.h"
+#include "trace.h"
 #include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
 #include <poll.h>
 #include <signal.h>
 #include <stdio.h>
@@ -12,7 +20,7 @@
 #include <unistd.h>
 
 #define MAX_CLIENTS 100
-#define POLL_TIMEOUT_MS -1
+#define AUTH_POLL_SLOT (MAX_CLIENTS + 1)
 #define DEFAULT_PORT 8080
 
 typedef struct
@@ -20,23 +28,43 @@ typedef struct
     int fd;
     char username[32];
     int is_logged_in;
+    JsonWriter out; // response frames are serialized here
+    long ack_seq; // out holds a response waiting for this journal seq to be durable, 0 = none
+    int auth_pending; // a LOGIN or REGISTER is with the auth pool
+    unsigned long gen; // bumped on every accept, auth jobs carry it
 } ClientState;
 
 static ClientState clients[MAX_CLIENTS];
-static struct pollfd fds[MAX_CLIENTS + 1]; // +1 for server socket
+
+// Framed LIST_ROOMS response shared by every client until the room list changes
+static struct
+{
+    char* frame;
+    size_t len;
+    unsigned long version; // storage_rooms_version() it was built from, 0 = empty
+    unsigned long hits;
+    unsigned long misses;
+} list_rooms_cache;
+static struct pollfd fds[MAX_CLIENTS + 2]; // server socket, clients, auth pool wakeups
 static int client_count = 0;
+static unsigned long next_client_gen = 0;
+static int acks_waiting = 0;
+static volatile sig_atomic_t shutdown_requested = 0;
 
 // Forward declarations of helper functions
 static void init_clients();
+static void install_shutdown_handlers(void);
 static void add_new_client(int server_fd);
 static void handle_client_activity(int client_idx);
 static void process_message(int client_idx, const char* msg_type, cJSON* payload);
+static void send_durable_acks(void);
+static void handle_auth_results(void);
 
 void handle_login(int client_idx, cJSON* data);
 void handle_register(int client_idx, cJSON* data);
 void handle_logout(int client_idx);
 void handle_create_room(int client_idx, cJSON* data);
-void handle_list_rooms(int client_idx);
+void handle_list_rooms(int client_idx, cJSON* data);
 void handle_import_questions(int client_idx, cJSON* data);
 void handle_list_question_banks(int client_idx);
 void handle_get_question_bank(int client_idx, cJSON* data);
@@ -45,6 +73,9 @@ void handle_delete_question_bank(int client_idx, cJSON* data);
 void handle_get_room_stats(int client_idx, cJSON* data);
 void handle_close_room(int client_idx, cJSON* data);
 void handle_delete_room(int client_idx, cJSON* data);
+void handle_submit_result(int client_idx, cJSON* data);
+void handle_get_server_stats(int client_idx);
+void handle_get_leaderboard(int client_idx, cJSON* data);
 void remove_client(int client_idx);
 void send_error(int client_idx, const char* msg);
 void send_success(int client_idx, const char* msg);
@@ -58,6 +89,8 @@ int main(int argc, char* argv[])
         port = atoi(argv[1]);
     }
 
+    trace_init();
+    json_arena_init();
     storage_init();
     server_start(port);
     return 0;
@@ -72,17 +105,31 @@ void server_start(int port)
     }
 
     init_clients();
+    install_shutdown_handlers();
+    if (auth_pool_start() != 0) {
+        fprintf(stderr, "Failed to start the auth workers\n");
+        exit(1);
+    }
 
     // Setup poll server fd
     fds[0].fd = server_fd;
     fds[0].events = POLLIN;
+    fds[AUTH_POLL_SLOT].fd = auth_pool_fd();
+    fds[AUTH_POLL_SLOT].events = POLLIN;
 
     printf("Server loop started on port %d...\n", port);
     fflush(stdout);
 
-    while (1) {
-        int ret = poll(fds, MAX_CLIENTS + 1, POLL_TIMEOUT_MS);
+    while (!shutdown_requested) {
+        // Journal syncs and snapshots owed by the previous batch of requests run first,
+        // then the loop sleeps until a client is ready or the next one is due
+        storage_tick();
+        send_durable_acks();
+        int ret = poll(fds, MAX_CLIENTS + 2, storage_flush_timeout_ms());
+        trace_handle_pending_dump();
         if (ret < 0) {
+            if (errno == EINTR)
+                continue;
             perror("poll");
             break;
         }
@@ -92,6 +139,10 @@ void server_start(int port)
             add_new_client(server_fd);
         }
 
+        if (fds[AUTH_POLL_SLOT].revents & POLLIN) {
+            handle_auth_results();
+        }
+
         // Check clients
         for (int i = 0; i < MAX_CLIENTS; i++) {
             if (clients[i].fd != -1 && (fds[i + 1].revents & POLLIN)) {
@@ -100,14 +151,38 @@ void server_start(int port)
         }
     }
 
+    printf("Shutting down, writing a storage snapshot...\n");
+    storage_flush();
+    send_durable_acks();
+    auth_pool_stop();
     close(server_fd);
 }
 
+static void on_shutdown_signal(int sig)
+{
+    (void)sig;
+    shutdown_requested = 1;
+}
+
+// No SA_RESTART, so a signal interrupts poll() and the loop exits promptly
+static void install_shutdown_handlers(void)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_shutdown_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+}
+
 static void init_clients()
 {
     for (int i = 0; i < MAX_CLIENTS; i++) {
         clients[i].fd = -1;
         clients[i].is_logged_in = 0;
+        clients[i].ack_seq = 0;
+        clients[i].auth_pending = 0;
+        json_writer_init(&clients[i].out);
         fds[i + 1].fd = -1;
     }
 }
@@ -130,6 +205,8 @@ static void add_new_client(int server_fd)
             clients[i].fd = new_socket;
             clients[i].is_logged_in = 0;
             clients[i].username[0] = '\0';
+            clients[i].auth_pending = 0;
+            clients[i].gen = ++next_client_gen;
 
             fds[i + 1].fd = new_socket;
             fds[i + 1].events = POLLIN;
@@ -150,30 +227,38 @@ static void handle_client_activity(int i)
 {
     char msg_type[4];
     cJSON* payload = NULL;
+    json_arena_begin();
+    trace_request_begin();
     int res = receive_packet(clients[i].fd, msg_type, &payload);
 
     if (res == 0) {
         printf("Received %s from client %d\n", msg_type, i);
         fflush(stdout);
+        uint64_t span = trace_span_begin();
         process_message(i, msg_type, payload);
-        cJSON_Delete(payload);
+        trace_span_end("handler", span);
+        trace_request_end(cJSON_GetStringValue(json_get(payload, KEY_ACTION)));
+        json_release(payload);
     } else if (res == -3) {
         printf("Parse error from client %d\n", i);
+        trace_request_end(msg_type);
     } else {
+        trace_request_end(NULL);
         printf("Client %d disconnected\n", i);
         fflush(stdout);
         handle_logout(i);
         remove_client(i);
     }
+    json_arena_end();
 }
 
 static void process_message(int client_idx, const char* msg_type, cJSON* payload)
 {
     if (strcmp(msg_type, MSG_TYPE_REQ) == 0 || strcmp(msg_type, MSG_TYPE_UPD) == 0) {
-        cJSON* action_item = cJSON_GetObjectItem(payload, JSON_KEY_ACTION);
+        cJSON* action_item = json_get(payload, KEY_ACTION);
         if (cJSON_IsString(action_item)) {
             char* action = action_item->valuestring;
-            cJSON* data = cJSON_GetObjectItem(payload, JSON_KEY_DATA);
+            cJSON* data = json_get(payload, KEY_DATA);
 
             if (strcmp(action, ACTION_LOGIN) == 0) {
                 handle_login(client_idx, data);
@@ -185,7 +270,7 @@ static void process_message(int client_idx, const char* msg_type, cJSON* payload
             } else if (strcmp(action, ACTION_CREATE_ROOM) == 0) {
                 handle_create_room(client_idx, data);
             } else if (strcmp(action, ACTION_LIST_ROOMS) == 0) {
-                handle_list_rooms(client_idx);
+                handle_list_rooms(client_idx, data);
             } else if (strcmp(action, ACTION_IMPORT_QUESTIONS) == 0) {
                 handle_import_questions(client_idx, data);
             } else if (strcmp(action, ACTION_LIST_QUESTION_BANKS) == 0) {
@@ -200,6 +285,12 @@ static void process_message(int client_idx, const char* msg_type, cJSON* payload
                 handle_get_room_stats(client_idx, data);
             } else if (strcmp(action, ACTION_DELETE_ROOM) == 0) {
                 handle_delete_room(client_idx, data);
+            } else if (strcmp(action, ACTION_SUBMIT_RESULT) == 0) {
+                handle_submit_result(client_idx, data);
+            } else if (strcmp(action, ACTION_GET_SERVER_STATS) == 0) {
+                handle_get_server_stats(client_idx);
+            } else if (strcmp(action, ACTION_GET_LEADERBOARD) == 0) {
+                handle_get_leaderboard(client_idx, data);
             }
         }
     } else if (strcmp(msg_type, MSG_TYPE_HBT) == 0) {
@@ -215,89 +306,167 @@ void remove_client(int client_idx)
     }
     clients[client_idx].is_logged_in = 0;
     clients[client_idx].username[0] = '\0';
+    if (clients[client_idx].ack_seq) {
+        clients[client_idx].ack_seq = 0;
+        acks_waiting--;
+    }
+    clients[client_idx].auth_pending = 0;
+    json_writer_free(&clients[client_idx].out);
     fds[client_idx + 1].fd = -1;
     client_count--;
 }
 
+// Starts a {"status": ...} response frame in the client's output buffer
+static JsonWriter* begin_response(int client_idx, const char* msg_type, const char* status)
+{
+    JsonWriter* w = &clients[client_idx].out;
+    json_writer_begin_frame(w, msg_type);
+    json_writer_begin_object(w);
+    json_writer_key(w, JSON_KEY_STATUS);
+    json_writer_string(w, status);
+    return w;
+}
+
+static void send_response(int client_idx)
+{
+    JsonWriter* w = &clients[client_idx].out;
+    json_writer_end_object(w);
+    json_writer_send(w, clients[client_idx].fd);
+}
+
+// Holds a finished response until the journal commit covering seq. The client
+// is not read from meanwhile, so its next request cannot overwrite the frame.
+static void send_response_when_durable(int client_idx, long seq)
+{
+    if (storage_is_durable(seq)) {
+        send_response(client_idx);
+        return;
+    }
+    json_writer_end_object(&clients[client_idx].out);
+    clients[client_idx].ack_seq = seq;
+    fds[client_idx + 1].events = 0;
+    acks_waiting++;
+}
+
+static void send_durable_acks(void)
+{
+    for (int i = 0; i < MAX_CLIENTS && acks_waiting > 0; i++) {
+        if (!clients[i].ack_seq || !storage_is_durable(clients[i].ack_seq))
+            continue;
+        json_writer_send(&clients[i].out, clients[i].fd);
+        clients[i].ack_seq = 0;
+        fds[i + 1].events = POLLIN;
+        acks_waiting--;
+    }
+}
+
 void send_error(int client_idx, const char* msg)
 {
-    cJSON* resp = cJSON_CreateObject();
-    cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "ERROR");
-    cJSON_AddStringToObject(resp, JSON_KEY_MESSAGE, msg);
-    send_packet(clients[client_idx].fd, MSG_TYPE_ERR, resp);
-    cJSON_Delete(resp);
+    JsonWriter* w = begin_response(client_idx, MSG_TYPE_ERR, "ERROR");
+    json_writer_key(w, JSON_KEY_MESSAGE);
+    json_writer_string(w, msg);
+    send_response(client_idx);
 }
 
 void send_success(int client_idx, const char* msg)
 {
-    cJSON* resp = cJSON_CreateObject();
-    cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "SUCCESS");
-    cJSON_AddStringToObject(resp, JSON_KEY_MESSAGE, msg);
-    send_packet(clients[client_idx].fd, MSG_TYPE_RES, resp);
-    cJSON_Delete(resp);
+    JsonWriter* w = begin_response(client_idx, MSG_TYPE_RES, "SUCCESS");
+    json_writer_key(w, JSON_KEY_MESSAGE);
+    json_writer_string(w, msg);
+    send_response(client_idx);
 }
 
-void handle_login(int client_idx, cJSON* data)
+// Hands a password to the auth pool. The client is not read from until the
+// job comes back, so it cannot send another request while its login runs.
+static void submit_auth_job(int client_idx, AuthJobType type, const char* username, const char* password,
+                            const char* stored)
 {
-    cJSON* user_item = cJSON_GetObjectItem(data, JSON_KEY_USERNAME);
-    cJSON* pass_item = cJSON_GetObjectItem(data, JSON_KEY_PASSWORD);
+    AuthJob* job = auth_job_new(type, client_idx, clients[client_idx].gen, username, password);
+    if (job && stored)
+        snprintf(job->stored, sizeof(job->stored), "%s", stored);
+    if (!job || auth_pool_submit(job) != 0) {
+        auth_job_free(job);
+        send_error(client_idx, "Server busy");
+        return;
+    }
+    clients[client_idx].auth_pending = 1;
+    fds[client_idx + 1].events = 0;
+}
 
-    if (!cJSON_IsString(user_item) || !cJSON_IsString(pass_item)) {
-        send_error(client_idx, "Invalid format");
+void handle_login(int client_idx, cJSON* data)
+{
+    CredentialsRequest req;
+    const char* err = request_decode(&login_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
         return;
     }
 
-    char* username = user_item->valuestring;
-    char* password = pass_item->valuestring;
+    const char* stored = storage_get_password(req.username);
+    submit_auth_job(client_idx, AUTH_VERIFY, req.username, req.password,
+                    stored ? stored : auth_pool_unknown_user_hash());
+}
 
+static void finish_login(int client_idx, const char* username)
+{
     // Check concurrent login
     for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].is_logged_in && strcmp(clients[i].username, username) == 0) {
+        if (i != client_idx && clients[i].is_logged_in && strcmp(clients[i].username, username) == 0) {
+            // The kick frame reuses the output buffer, so a held ack goes out first
+            if (clients[i].ack_seq) {
+                storage_sync();
+                send_durable_acks();
+            }
             send_error(i, "Logged in from another location");
             printf("Kicking user %s (client %d)\n", username, i);
             remove_client(i);
         }
     }
 
-    if (storage_check_credentials(username, password)) {
-        clients[client_idx].is_logged_in = 1;
-        strncpy(clients[client_idx].username, username, sizeof(clients[client_idx].username) - 1);
-        clients[client_idx].username[sizeof(clients[client_idx].username) - 1] = '\0';
-
-        cJSON* resp = cJSON_CreateObject();
-        cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "SUCCESS");
-        cJSON_AddStringToObject(resp, JSON_KEY_MESSAGE, "Login successful");
-
-        cJSON* data_obj = cJSON_CreateObject();
-        cJSON_AddStringToObject(data_obj, "role", storage_get_role(username));
-        cJSON_AddItemToObject(resp, JSON_KEY_DATA, data_obj);
-
-        send_packet(clients[client_idx].fd, MSG_TYPE_RES, resp);
-        cJSON_Delete(resp);
-
-        printf("User %s logged in as %s\n", username, storage_get_role(username));
-    } else {
-        send_error(client_idx, "Invalid credentials");
-    }
+    clients[client_idx].is_logged_in = 1;
+    strncpy(clients[client_idx].username, username, sizeof(clients[client_idx].username) - 1);
+    clients[client_idx].username[sizeof(clients[client_idx].username) - 1] = '\0';
+
+    JsonWriter* w = begin_response(client_idx, MSG_TYPE_RES, "SUCCESS");
+    json_writer_key(w, JSON_KEY_MESSAGE);
+    json_writer_string(w, "Login successful");
+    json_writer_key(w, JSON_KEY_DATA);
+    json_writer_begin_object(w);
+    json_writer_key(w, "role");
+    json_writer_string(w, storage_get_role(username));
+    json_writer_end_object(w);
+    send_response(client_idx);
+
+    printf("User %s logged in as %s\n", username, storage_get_role(username));
 }
 
 void handle_register(int client_idx, cJSON* data)
 {
-    cJSON* user_item = cJSON_GetObjectItem(data, JSON_KEY_USERNAME);
-    cJSON* pass_item = cJSON_GetObjectItem(data, JSON_KEY_PASSWORD);
+    CredentialsRequest req;
+    const char* err = request_decode(&register_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
+        return;
+    }
 
-    if (!cJSON_IsString(user_item) || !cJSON_IsString(pass_item)) {
-        send_error(client_idx, "Invalid format");
+    // Checked again once hashed, another registration may take the name meanwhile
+    if (storage_user_exists(req.username)) {
+        send_error(client_idx, "Username already exists");
         return;
     }
+    submit_auth_job(client_idx, AUTH_HASH, req.username, req.password, NULL);
+}
 
-    char* username = user_item->valuestring;
-    char* password = pass_item->valuestring;
+static void finish_register(int client_idx, const AuthJob* job)
+{
+    int res = job->ok ? storage_add_user(job->username, job->stored, NULL) : -1;
+    if (res == 0)
+        printf("User %s registered\n", job->username);
+    if (client_idx < 0)
+        return;
 
-    int res = storage_add_user(username, password, NULL);
     if (res == 0) {
         send_success(client_idx, "Register successful");
-        printf("User %s registered\n", username);
     } else if (res == -2) {
         send_error(client_idx, "Username already exists");
     } else {
@@ -305,6 +474,46 @@ void handle_register(int client_idx, cJSON* data)
     }
 }
 
+// Storage is only touched here, on the loop thread. A registration is kept
+// and a plaintext password upgraded even if the client has gone since.
+static void finish_auth_job(const AuthJob* job)
+{
+    int client_idx = job->client_idx;
+    if (clients[client_idx].fd == -1 || clients[client_idx].gen != job->client_gen) {
+        client_idx = -1;
+    } else {
+        clients[client_idx].auth_pending = 0;
+        fds[client_idx + 1].events = POLLIN;
+    }
+
+    if (job->type == AUTH_HASH) {
+        finish_register(client_idx, job);
+        return;
+    }
+
+    const char* stored = storage_get_password(job->username);
+    if (job->rehashed && stored && !password_is_hashed(stored))
+        storage_set_password(job->username, job->stored);
+    if (client_idx < 0)
+        return;
+    if (job->ok && stored && strcmp(job->stored, auth_pool_unknown_user_hash()) != 0) {
+        finish_login(client_idx, job->username);
+    } else {
+        send_error(client_idx, "Invalid credentials");
+    }
+}
+
+static void handle_auth_results(void)
+{
+    AuthJob* job = auth_pool_take_done();
+    while (job) {
+        AuthJob* next = job->next;
+        finish_auth_job(job);
+        auth_job_free(job);
+        job = next;
+    }
+}
+
 void handle_logout(int client_idx)
 {
     if (clients[client_idx].is_logged_in) {
@@ -321,27 +530,18 @@ void handle_create_room(int client_idx, cJSON* data)
         return;
     }
 
-    cJSON* name = cJSON_GetObjectItem(data, "room_name");
-    cJSON* start = cJSON_GetObjectItem(data, "start_time");
-    cJSON* end = cJSON_GetObjectItem(data, "end_time");
-    cJSON* bank = cJSON_GetObjectItem(data, "question_bank_id");
-    cJSON* num_q = cJSON_GetObjectItem(data, "num_questions");
-    cJSON* attempts = cJSON_GetObjectItem(data, "allowed_attempts");
-
-    if (!cJSON_IsString(name) || !cJSON_IsNumber(start) || !cJSON_IsNumber(end) || !cJSON_IsString(bank)) {
-        send_error(client_idx, "Invalid room data");
+    Room room;
+    const char* err = request_decode(&create_room_schema, data, &room);
+    if (err) {
+        send_error(client_idx, err);
         return;
     }
-
-    Room room;
-    snprintf(room.id, sizeof(room.id), "room_%ld", time(NULL));
-    strncpy(room.name, name->valuestring, sizeof(room.name) - 1);
-    room.start_time = (long)start->valuedouble;
-    room.end_time = (long)end->valuedouble;
-    strncpy(room.question_bank_id, bank->valuestring, sizeof(room.question_bank_id) - 1);
+    // Rooms are keyed by id, so a second room in the same second gets a suffix
+    long now = time(NULL);
+    snprintf(room.id, sizeof(room.id), "room_%ld", now);
+    for (int n = 2; storage_room_exists(room.id); n++)
+        snprintf(room.id, sizeof(room.id), "room_%ld_%d", now, n);
     strcpy(room.status, "OPEN");
-    room.num_questions = num_q ? num_q->valueint : 10;
-    room.allowed_attempts = attempts ? attempts->valueint : 1;
 
     if (storage_save_room(&room) == 0) {
         send_success(client_idx, "Room created");
@@ -350,21 +550,107 @@ void handle_create_room(int client_idx, cJSON* data)
     }
 }
 
-void handle_list_rooms(int client_idx)
+#define LIST_ROOMS_MAX_LIMIT 200
+#define ROOM_RESULTS_MAX_LIMIT 500
+
+static void write_room(const Room* room, void* ctx)
+{
+    JsonWriter* w = ctx;
+    json_writer_begin_object(w);
+    json_writer_key(w, "id");
+    json_writer_string(w, room->id);
+    json_writer_key(w, "name");
+    json_writer_string(w, room->name);
+    json_writer_key(w, "start_time");
+    json_writer_int(w, room->start_time);
+    json_writer_key(w, "end_time");
+    json_writer_int(w, room->end_time);
+    json_writer_key(w, "question_bank_id");
+    json_writer_string(w, room->question_bank_id);
+    json_writer_key(w, "status");
+    json_writer_string(w, room->status);
+    json_writer_key(w, "num_questions");
+    json_writer_int(w, room->num_questions);
+    json_writer_key(w, "allowed_attempts");
+    json_writer_int(w, room->allowed_attempts);
+    json_writer_end_object(w);
+}
+
+// A page of rooms by start time as data; next_cursor, beside it, fetches the
+// next one. -1 if the cursor is malformed.
+static int write_room_page(JsonWriter* w, const ListRoomsRequest* req)
+{
+    RoomPageQuery query = {
+        .status = req->status,
+        .from = req->from,
+        .to = req->to,
+        .cursor = req->cursor,
+        .limit = req->limit <= 0 || req->limit > LIST_ROOMS_MAX_LIMIT ? LIST_ROOMS_MAX_LIMIT : req->limit,
+    };
+    char next[STORAGE_CURSOR_SIZE];
+
+    json_writer_key(w, JSON_KEY_DATA);
+    json_writer_begin_array(w);
+    if (storage_list_rooms_page(&query, write_room, w, next) != 0)
+        return -1;
+    json_writer_end_array(w);
+    if (next[0]) {
+        json_writer_key(w, JSON_KEY_NEXT_CURSOR);
+        json_writer_string(w, next);
+    }
+    return 0;
+}
+
+void handle_list_rooms(int client_idx, cJSON* data)
 {
     // Both admin and participant can list rooms, but maybe filter?
     // Spec says Admin "Request: LIST_ROOMS ... Response: LIST of rooms"
     // Also Participant needs to see rooms. So allow all logged in.
 
-    cJSON* rooms = cJSON_CreateArray();
-    storage_get_rooms(rooms);
+    // Every answer is a page, so a long list cannot outgrow a frame; the
+    // first page without filters is what clients poll, so its frame is cached
+    ListRoomsRequest req;
+    memset(&req, 0, sizeof(req));
+    if (cJSON_IsObject(data)) {
+        const char* err = request_decode(&list_rooms_schema, data, &req);
+        if (err) {
+            send_error(client_idx, err);
+            return;
+        }
+        if (req.limit > 0 || req.cursor || req.status || req.from || req.to) {
+            JsonWriter* w = begin_response(client_idx, MSG_TYPE_RES, "SUCCESS");
+            if (write_room_page(w, &req) != 0)
+                send_error(client_idx, "Invalid cursor");
+            else
+                send_response(client_idx);
+            return;
+        }
+    }
 
-    cJSON* resp = cJSON_CreateObject();
-    cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "SUCCESS");
-    cJSON_AddItemToObject(resp, JSON_KEY_DATA, rooms);
+    unsigned long version = storage_rooms_version();
+    if (list_rooms_cache.version == version) {
+        list_rooms_cache.hits++;
+        send_frame(clients[client_idx].fd, list_rooms_cache.frame, list_rooms_cache.len);
+        return;
+    }
+    list_rooms_cache.misses++;
 
-    send_packet(clients[client_idx].fd, MSG_TYPE_RES, resp);
-    cJSON_Delete(resp);
+    JsonWriter* w = begin_response(client_idx, MSG_TYPE_RES, "SUCCESS");
+    write_room_page(w, &req);
+    json_writer_end_object(w);
+    if (json_writer_finish(w) != 0) {
+        json_writer_send(w, clients[client_idx].fd);
+        return;
+    }
+
+    char* frame = realloc(list_rooms_cache.frame, w->len);
+    if (frame) {
+        memcpy(frame, w->buf, w->len);
+        list_rooms_cache.frame = frame;
+        list_rooms_cache.len = w->len;
+        list_rooms_cache.version = version;
+    }
+    json_writer_send(w, clients[client_idx].fd);
 }
 
 void handle_import_questions(int client_idx, cJSON* data)
@@ -374,15 +660,14 @@ void handle_import_questions(int client_idx, cJSON* data)
         return;
     }
 
-    cJSON* bank_name = cJSON_GetObjectItem(data, "bank_name");
-    cJSON* questions = cJSON_GetObjectItem(data, "questions");
-
-    if (!cJSON_IsString(bank_name) || !cJSON_IsArray(questions)) {
-        send_error(client_idx, "Invalid question data");
+    ImportQuestionsRequest req;
+    const char* err = request_decode(&import_questions_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
         return;
     }
 
-    if (storage_save_question_bank(bank_name->valuestring, questions) == 0) {
+    if (storage_save_question_bank(req.bank_name, req.questions) == 0) {
         send_success(client_idx, "Questions imported");
     } else {
         send_error(client_idx, "Failed to import questions");
@@ -402,9 +687,9 @@ void handle_list_question_banks(int client_idx)
         cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "SUCCESS");
         cJSON_AddItemToObject(resp, JSON_KEY_DATA, banks);
         send_packet(clients[client_idx].fd, MSG_TYPE_RES, resp);
-        cJSON_Delete(resp);
+        json_release(resp);
     } else {
-        cJSON_Delete(banks);
+        json_release(banks);
         send_error(client_idx, "Failed to list question banks");
     }
 }
@@ -418,19 +703,20 @@ void handle_get_question_bank(int client_idx, cJSON* data)
         return;
     }
 
-    cJSON* bank_id = cJSON_GetObjectItem(data, "bank_id");
-    if (!cJSON_IsString(bank_id)) {
-        send_error(client_idx, "Invalid bank id");
+    BankRefRequest req;
+    const char* err = request_decode(&get_question_bank_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
         return;
     }
 
-    cJSON* questions = NULL;
-    if (storage_get_question_bank(bank_id->valuestring, &questions) == 0) {
-        cJSON* resp = cJSON_CreateObject();
-        cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "SUCCESS");
-        cJSON_AddItemToObject(resp, JSON_KEY_DATA, questions);
-        send_packet(clients[client_idx].fd, MSG_TYPE_RES, resp);
-        cJSON_Delete(resp);
+    const char* json;
+    size_t json_len;
+    if (storage_export_question_bank(req.bank_id, &json, &json_len) == 0) {
+        JsonWriter* w = begin_response(client_idx, MSG_TYPE_RES, "SUCCESS");
+        json_writer_key(w, JSON_KEY_DATA);
+        json_writer_raw(w, json, json_len);
+        send_response(client_idx);
     } else {
         send_error(client_idx, "Bank not found");
     }
@@ -443,15 +729,14 @@ void handle_update_question_bank(int client_idx, cJSON* data)
         return;
     }
 
-    cJSON* bank_id = cJSON_GetObjectItem(data, "bank_id");
-    cJSON* questions = cJSON_GetObjectItem(data, "questions");
-
-    if (!cJSON_IsString(bank_id) || !cJSON_IsArray(questions)) {
-        send_error(client_idx, "Invalid data");
+    UpdateQuestionBankRequest req;
+    const char* err = request_decode(&update_question_bank_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
         return;
     }
 
-    if (storage_update_question_bank(bank_id->valuestring, questions) == 0) {
+    if (storage_update_question_bank(req.bank_id, req.questions) == 0) {
         send_success(client_idx, "Question bank updated");
     } else {
         send_error(client_idx, "Failed to update bank");
@@ -465,19 +750,63 @@ void handle_delete_question_bank(int client_idx, cJSON* data)
         return;
     }
 
-    cJSON* bank_id = cJSON_GetObjectItem(data, "bank_id");
-    if (!cJSON_IsString(bank_id)) {
-        send_error(client_idx, "Invalid bank id");
+    BankRefRequest req;
+    const char* err = request_decode(&delete_question_bank_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
         return;
     }
 
-    if (storage_delete_question_bank(bank_id->valuestring) == 0) {
+    if (storage_delete_question_bank(req.bank_id) == 0) {
         send_success(client_idx, "Question bank deleted");
     } else {
         send_error(client_idx, "Failed to delete bank");
     }
 }
 
+static void write_result(const RoomResult* result, void* ctx)
+{
+    JsonWriter* w = ctx;
+    json_writer_begin_object(w);
+    json_writer_key(w, "username");
+    json_writer_string(w, result->username);
+    json_writer_key(w, "score");
+    json_writer_int(w, result->score);
+    json_writer_key(w, "timestamp");
+    json_writer_int(w, result->timestamp);
+    json_writer_end_object(w);
+}
+
+// histogram[i] counts results scoring i, up to the best score
+static void write_room_stats(JsonWriter* w, const RoomStats* stats)
+{
+    double mean = stats->count ? (double)stats->sum / stats->count : 0;
+    double variance = stats->count ? stats->sum_squares / stats->count - mean * mean : 0;
+
+    json_writer_begin_object(w);
+    json_writer_key(w, "total_attempts");
+    json_writer_int(w, stats->count);
+    json_writer_key(w, "average_score");
+    json_writer_number(w, mean);
+    json_writer_key(w, "stddev_score");
+    json_writer_number(w, variance > 0 ? sqrt(variance) : 0);
+    if (stats->count) {
+        json_writer_key(w, "min_score");
+        json_writer_int(w, stats->min_score);
+        json_writer_key(w, "max_score");
+        json_writer_int(w, stats->max_score);
+    }
+    json_writer_key(w, "histogram");
+    json_writer_begin_array(w);
+    int slots = stats->count ? stats->max_score + 1 : 0;
+    if (slots > ROOM_STATS_SCORE_SLOTS)
+        slots = ROOM_STATS_SCORE_SLOTS;
+    for (int i = 0; i < slots; i++)
+        json_writer_int(w, stats->histogram[i]);
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+}
+
 void handle_get_room_stats(int client_idx, cJSON* data)
 {
     if (strcmp(storage_get_role(clients[client_idx].username), "admin") != 0) {
@@ -485,50 +814,57 @@ void handle_get_room_stats(int client_idx, cJSON* data)
         return;
     }
 
-    cJSON* room_id = cJSON_GetObjectItem(data, "room_id");
-    if (!cJSON_IsString(room_id)) {
-        send_error(client_idx, "Invalid room id");
+    RoomStatsRequest req;
+    const char* err = request_decode(&room_stats_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
         return;
     }
 
-    cJSON* results = cJSON_CreateArray();
-    storage_get_room_results(room_id->valuestring, results);
-
-    // Calculate basic stats
-    int total_attempts = cJSON_GetArraySize(results);
-    double total_score = 0;
-    cJSON* item;
-    cJSON_ArrayForEach(item, results)
-    {
-        cJSON* score = cJSON_GetObjectItem(item, "score");
-        if (score)
-            total_score += score->valueint;
+    const RoomStats* stats = storage_get_room_stats(req.room_id);
+    if (!stats) {
+        send_error(client_idx, "Failed to load room stats");
+        return;
     }
-    double avg_score = (total_attempts > 0) ? (total_score / total_attempts) : 0;
-
-    cJSON* resp = cJSON_CreateObject();
-    cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "SUCCESS");
 
-    cJSON* data_obj = cJSON_CreateObject();
+    JsonWriter* w = begin_response(client_idx, MSG_TYPE_RES, "SUCCESS");
+    json_writer_key(w, JSON_KEY_DATA);
+    json_writer_begin_object(w);
 
     // Add Room Info
-    cJSON* room_info = storage_get_room(room_id->valuestring);
+    cJSON* room_info = storage_get_room(req.room_id);
     if (room_info) {
-        cJSON_AddItemToObject(data_obj, "room", room_info);
+        json_writer_key(w, "room");
+        json_writer_item(w, room_info);
+        json_release(room_info);
     }
 
-    cJSON* stats = cJSON_CreateObject();
-    cJSON_AddNumberToObject(stats, "total_attempts", total_attempts);
-    cJSON_AddNumberToObject(stats, "average_score", avg_score);
-    cJSON_AddItemToObject(data_obj, "stats", stats);
-
-    // Add full results
-    cJSON_AddItemToObject(data_obj, "results", cJSON_Duplicate(results, 1));
+    json_writer_key(w, "stats");
+    write_room_stats(w, stats);
+
+    // Results always come as a page, the first one unless a cursor says otherwise
+    if (req.include_results) {
+        ResultPageQuery query = {
+            .by_score = req.order && strcmp(req.order, "score") == 0,
+            .cursor = req.cursor,
+            .limit = req.limit <= 0 || req.limit > ROOM_RESULTS_MAX_LIMIT ? ROOM_RESULTS_MAX_LIMIT : req.limit,
+        };
+        char next[STORAGE_CURSOR_SIZE];
+        json_writer_key(w, "results");
+        json_writer_begin_array(w);
+        if (storage_room_results_page(req.room_id, &query, write_result, w, next) != 0) {
+            send_error(client_idx, "Invalid cursor");
+            return;
+        }
+        json_writer_end_array(w);
+        if (next[0]) {
+            json_writer_key(w, JSON_KEY_NEXT_CURSOR);
+            json_writer_string(w, next);
+        }
+    }
 
-    cJSON_AddItemToObject(resp, JSON_KEY_DATA, data_obj);
-    send_packet(clients[client_idx].fd, MSG_TYPE_RES, resp);
-    cJSON_Delete(resp);
-    cJSON_Delete(results);
+    json_writer_end_object(w);
+    send_response(client_idx);
 }
 
 void handle_delete_room(int client_idx, cJSON* data)
@@ -538,15 +874,196 @@ void handle_delete_room(int client_idx, cJSON* data)
         return;
     }
 
-    cJSON* room_id = cJSON_GetObjectItem(data, "room_id");
-    if (!cJSON_IsString(room_id)) {
-        send_error(client_idx, "Invalid room id");
+    RoomRefRequest req;
+    const char* err = request_decode(&delete_room_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
         return;
     }
 
-    if (storage_delete_room(room_id->valuestring) == 0) {
+    if (storage_delete_room(req.room_id) == 0) {
         send_success(client_idx, "Room deleted");
     } else {
         send_error(client_idx, "Failed to delete room");
     }
 }
+
+void handle_submit_result(int client_idx, cJSON* data)
+{
+    if (!clients[client_idx].is_logged_in) {
+        send_error(client_idx, "Not logged in");
+        return;
+    }
+
+    SubmitResultRequest req;
+    const char* err = request_decode(&submit_result_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
+        return;
+    }
+
+    Room room;
+    if (storage_get_room_info(req.room_id, &room) != 0) {
+        send_error(client_idx, "Room not found");
+        return;
+    }
+
+    if (strcmp(room.status, "OPEN") != 0) {
+        send_error(client_idx, "Room is closed");
+        return;
+    }
+
+    if (room.allowed_attempts > 0
+        && storage_count_attempts(req.room_id, clients[client_idx].username) >= room.allowed_attempts) {
+        send_error(client_idx, "No attempts left");
+        return;
+    }
+
+    QbkView bank;
+    if (storage_get_question_bank(room.question_bank_id, &bank) != 0) {
+        send_error(client_idx, "Bank not found");
+        return;
+    }
+
+    // Answers are graded in bank order against the first num_questions questions
+    int total = (int)bank.count;
+    if (room.num_questions > 0 && room.num_questions < total)
+        total = room.num_questions;
+
+    int score = 0;
+    cJSON* answer = req.answers->child;
+    for (int i = 0; i < total && answer; i++) {
+        int correct = bank.questions[i].correct_index;
+        if (correct != QBK_NO_ANSWER && cJSON_IsNumber(answer) && correct == answer->valueint)
+            score++;
+        answer = answer->next;
+    }
+
+    RoomResult result;
+    memset(&result, 0, sizeof(result));
+    strncpy(result.room_id, req.room_id, sizeof(result.room_id) - 1);
+    strncpy(result.username, clients[client_idx].username, sizeof(result.username) - 1);
+    result.score = score;
+    result.timestamp = time(NULL);
+
+    if (storage_save_result(&result) != 0) {
+        send_error(client_idx, "Failed to save result");
+        return;
+    }
+
+    JsonWriter* w = begin_response(client_idx, MSG_TYPE_RES, "SUCCESS");
+    json_writer_key(w, JSON_KEY_DATA);
+    json_writer_begin_object(w);
+    json_writer_key(w, "score");
+    json_writer_int(w, score);
+    json_writer_key(w, "total");
+    json_writer_int(w, total);
+    json_writer_end_object(w);
+    send_response_when_durable(client_idx, result.seq);
+}
+
+#define LEADERBOARD_MAX_LIMIT 100
+#define LEADERBOARD_MAX_AROUND 50
+
+static void write_rank_entry(long rank, const char* username, int score, long timestamp, void* ctx)
+{
+    JsonWriter* w = ctx;
+    json_writer_begin_object(w);
+    json_writer_key(w, "rank");
+    json_writer_int(w, rank);
+    json_writer_key(w, "username");
+    json_writer_string(w, username);
+    json_writer_key(w, "score");
+    json_writer_int(w, score);
+    json_writer_key(w, "timestamp");
+    json_writer_int(w, timestamp);
+    json_writer_end_object(w);
+}
+
+// Each user's best result, best first: the top `limit` and a window of
+// `around` entries either side of the user's own rank
+void handle_get_leaderboard(int client_idx, cJSON* data)
+{
+    if (!clients[client_idx].is_logged_in) {
+        send_error(client_idx, "Not logged in");
+        return;
+    }
+
+    LeaderboardRequest req;
+    const char* err = request_decode(&leaderboard_schema, data, &req);
+    if (err) {
+        send_error(client_idx, err);
+        return;
+    }
+    if (!storage_room_exists(req.room_id)) {
+        send_error(client_idx, "Room not found");
+        return;
+    }
+
+    // Only admins may look at someone else's position
+    const char* username = clients[client_idx].username;
+    if (req.username) {
+        if (strcmp(storage_get_role(username), "admin") != 0) {
+            send_error(client_idx, "Permission denied");
+            return;
+        }
+        username = req.username;
+    }
+    int limit = req.limit < 0 ? 0 : req.limit > LEADERBOARD_MAX_LIMIT ? LEADERBOARD_MAX_LIMIT : req.limit;
+    int around = req.around < 0 ? 0 : req.around > LEADERBOARD_MAX_AROUND ? LEADERBOARD_MAX_AROUND : req.around;
+
+    const Ranking* ranking = storage_get_room_ranking(req.room_id);
+    if (!ranking) {
+        send_error(client_idx, "Failed to load leaderboard");
+        return;
+    }
+    long rank = ranking_rank(ranking, username);
+
+    JsonWriter* w = begin_response(client_idx, MSG_TYPE_RES, "SUCCESS");
+    json_writer_key(w, JSON_KEY_DATA);
+    json_writer_begin_object(w);
+    json_writer_key(w, "room_id");
+    json_writer_string(w, req.room_id);
+    json_writer_key(w, "total");
+    json_writer_int(w, ranking_count(ranking));
+    json_writer_key(w, "top");
+    json_writer_begin_array(w);
+    ranking_range(ranking, 1, limit, write_rank_entry, w);
+    json_writer_end_array(w);
+    if (rank) {
+        json_writer_key(w, "me");
+        ranking_range(ranking, rank, 1, write_rank_entry, w);
+        long first = rank > around ? rank - around : 1;
+        json_writer_key(w, "around");
+        json_writer_begin_array(w);
+        ranking_range(ranking, first, rank - first + 1 + around, write_rank_entry, w);
+        json_writer_end_array(w);
+    }
+    json_writer_end_object(w);
+    send_response(client_idx);
+}
+
+void handle_get_server_stats(int client_idx)
+{
+    if (strcmp(storage_get_role(clients[client_idx].username), "admin") != 0) {
+        send_error(client_idx, "Permission denied");
+        return;
+    }
+
+    cJSON* resp = cJSON_CreateObject();
+    cJSON_AddStringToObject(resp, JSON_KEY_STATUS, "SUCCESS");
+    cJSON* data_obj = cJSON_AddObjectToObject(resp, JSON_KEY_DATA);
+    cJSON_AddNumberToObject(data_obj, "clients", client_count);
+    cJSON_AddItemToObject(data_obj, "json_arena", json_arena_stats_to_json());
+    cJSON* cache = cJSON_AddObjectToObject(data_obj, "list_rooms_cache");
+    cJSON_AddNumberToObject(cache, "hits", list_rooms_cache.hits);
+    cJSON_AddNumberToObject(cache, "misses", list_rooms_cache.misses);
+    cJSON* journal = storage_journal_stats_to_json();
+    cJSON_AddNumberToObject(journal, "acks_waiting", acks_waiting);
+    cJSON_AddItemToObject(data_obj, "journal", journal);
+    cJSON_AddItemToObject(data_obj, "bank_cache", storage_bank_cache_stats_to_json());
+    cJSON_AddItemToObject(data_obj, "storage_engine", storage_engine_stats_to_json());
+    cJSON_AddItemToObject(data_obj, "auth", auth_pool_stats_to_json());
+    send_packet(clients[client_idx].fd, MSG_TYPE_RES, resp);
+    json_release(resp);
+}
@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include "trace.h"
+#include "config.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_REQUEST_SPANS 32
+#define LABEL_LEN 24
+
+typedef struct
+{
+    const char* name;
+    uint64_t start_us;
+    uint64_t dur_us;
+    uint64_t request_id;
+    char label[LABEL_LEN];
+} TraceEvent;
+
+typedef struct TraceBuffer
+{
+    pthread_mutex_t lock;
+    int tid;
+    TraceEvent* events;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    struct TraceBuffer* next;
+
+    // Spans of the request in flight, committed only if it is kept
+    int active;
+    uint64_t request_id;
+    uint64_t request_start;
+    int sampled;
+    TraceEvent pending[MAX_REQUEST_SPANS];
+    int pending_count;
+} TraceBuffer;
+
+static long sample_every = 0;
+static long slow_threshold_us = 0;
+static size_t buffer_capacity = 65536;
+static const char* dump_path = "trace.json";
+static uint64_t request_counter = 0;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer* registry = NULL;
+static __thread TraceBuffer* local_buffer = NULL;
+static volatile sig_atomic_t dump_requested = 0;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int tracing_enabled(void)
+{
+    return sample_every > 0 || slow_threshold_us > 0;
+}
+
+static void on_dump_signal(int sig)
+{
+    (void)sig;
+    dump_requested = 1;
+}
+
+// Labels come from client payloads, so only identifier characters are kept
+static void copy_label(char* dst, const char* src)
+{
+    int n = 0;
+    for (; src && *src && n < LABEL_LEN - 1; src++) {
+        if (isalnum((unsigned char)*src) || *src == '_')
+            dst[n++] = *src;
+    }
+    dst[n] = '\0';
+}
+
+void trace_init(void)
+{
+    sample_every = config_get_long("QUIZZIE_TRACE_SAMPLE", 0);
+    slow_threshold_us = config_get_long("QUIZZIE_TRACE_SLOW_US", 0);
+    long capacity = config_get_long("QUIZZIE_TRACE_EVENTS", (long)buffer_capacity);
+    if (capacity > 0)
+        buffer_capacity = (size_t)capacity;
+    dump_path = config_get_str("QUIZZIE_TRACE_FILE", dump_path);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_dump_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+
+    if (tracing_enabled()) {
+        printf("Tracing enabled (sample 1/%ld, slow >= %ld us), SIGUSR1 dumps to %s\n",
+               sample_every, slow_threshold_us, dump_path);
+    }
+}
+
+static TraceBuffer* get_local_buffer(void)
+{
+    if (local_buffer)
+        return local_buffer;
+
+    TraceBuffer* buf = calloc(1, sizeof(TraceBuffer));
+    if (!buf)
+        return NULL;
+    buf->events = calloc(buffer_capacity, sizeof(TraceEvent));
+    if (!buf->events) {
+        free(buf);
+        return NULL;
+    }
+    buf->capacity = buffer_capacity;
+    buf->tid = (int)syscall(SYS_gettid);
+    pthread_mutex_init(&buf->lock, NULL);
+
+    pthread_mutex_lock(&registry_lock);
+    buf->next = registry;
+    registry = buf;
+    pthread_mutex_unlock(&registry_lock);
+
+    local_buffer = buf;
+    return buf;
+}
+
+void trace_request_begin(void)
+{
+    if (!tracing_enabled())
+        return;
+
+    TraceBuffer* buf = get_local_buffer();
+    if (!buf)
+        return;
+
+    uint64_t id = __atomic_add_fetch(&request_counter, 1, __ATOMIC_RELAXED);
+    buf->active = 1;
+    buf->request_id = id;
+    buf->sampled = sample_every > 0 && id % sample_every == 0;
+    buf->pending_count = 0;
+    buf->request_start = now_us();
+}
+
+void trace_request_end(const char* label)
+{
+    TraceBuffer* buf = local_buffer;
+    if (!buf || !buf->active)
+        return;
+    buf->active = 0;
+
+    uint64_t dur = now_us() - buf->request_start;
+    int slow = slow_threshold_us > 0 && dur >= (uint64_t)slow_threshold_us;
+    if (!buf->sampled && !slow)
+        return;
+
+    pthread_mutex_lock(&buf->lock);
+    for (int i = -1; i < buf->pending_count; i++) {
+        TraceEvent* ev = &buf->events[buf->head];
+        if (i < 0) {
+            ev->name = "request";
+            ev->start_us = buf->request_start;
+            ev->dur_us = dur;
+            ev->request_id = buf->request_id;
+            copy_label(ev->label, label);
+        } else {
+            *ev = buf->pending[i];
+        }
+        buf->head = (buf->head + 1) % buf->capacity;
+        if (buf->count < buf->capacity)
+            buf->count++;
+    }
+    pthread_mutex_unlock(&buf->lock);
+}
+
+uint64_t trace_span_begin(void)
+{
+    TraceBuffer* buf = local_buffer;
+    if (!buf || !buf->active)
+        return 0;
+    return now_us();
+}
+
+void trace_span_end(const char* name, uint64_t start)
+{
+    TraceBuffer* buf = local_buffer;
+    if (!start || !buf || !buf->active || buf->pending_count >= MAX_REQUEST_SPANS)
+        return;
+
+    TraceEvent* ev = &buf->pending[buf->pending_count++];
+    ev->name = name;
+    ev->start_us = start;
+    ev->dur_us = now_us() - start;
+    ev->request_id = buf->request_id;
+    ev->label[0] = '\0';
+}
+
+int trace_dump(const char* path)
+{
+    FILE* f = fopen(path ? path : dump_path, "w");
+    if (!f)
+        return -1;
+
+    int pid = (int)getpid();
+    int first = 1;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    pthread_mutex_lock(&registry_lock);
+    for (TraceBuffer* buf = registry; buf; buf = buf->next) {
+        pthread_mutex_lock(&buf->lock);
+        size_t start = (buf->head + buf->capacity - buf->count) % buf->capacity;
+        for (size_t i = 0; i < buf->count; i++) {
+            TraceEvent* ev = &buf->events[(start + i) % buf->capacity];
+            fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"quizzie\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+                       "\"pid\":%d,\"tid\":%d,\"args\":{\"request\":%llu",
+                    first ? "" : ",", ev->name, (unsigned long long)ev->start_us,
+                    (unsigned long long)ev->dur_us, pid, buf->tid, (unsigned long long)ev->request_id);
+            if (ev->label[0])
+                fprintf(f, ",\"action\":\"%s\"", ev->label);
+            fprintf(f, "}}");
+            first = 0;
+        }
+        pthread_mutex_unlock(&buf->lock);
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    return 0;
+}
+
+void trace_handle_pending_dump(void)
+{
+    if (!dump_requested)
+        return;
+    dump_requested = 0;
+
+    if (trace_dump(NULL) == 0)
+        printf("Trace written to %s\n", dump_path);
+    else
+        printf("Failed to write trace to %s\n", dump_path);
+    fflush(stdout);
+}
@@ -0,0 +1,281 @@
+#include "json_writer.h"
+#include "net.h"
+#include "protocol.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 4096
+// Buffers grown past this by a large response are released after sending
+#define RETAIN_CAPACITY (256 * 1024)
+
+void json_writer_init(JsonWriter* w)
+{
+    memset(w, 0, sizeof(*w));
+}
+
+void json_writer_free(JsonWriter* w)
+{
+    free(w->buf);
+    json_writer_init(w);
+}
+
+static int reserve(JsonWriter* w, size_t extra)
+{
+    if (w->failed)
+        return 0;
+    if (w->len + extra <= w->cap)
+        return 1;
+
+    size_t cap = w->cap ? w->cap : INITIAL_CAPACITY;
+    while (cap < w->len + extra)
+        cap *= 2;
+    char* buf = realloc(w->buf, cap);
+    if (!buf) {
+        w->failed = 1;
+        return 0;
+    }
+    w->buf = buf;
+    w->cap = cap;
+    return 1;
+}
+
+static void append(JsonWriter* w, const char* data, size_t n)
+{
+    if (reserve(w, n)) {
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+    }
+}
+
+static void append_char(JsonWriter* w, char c)
+{
+    if (reserve(w, 1))
+        w->buf[w->len++] = c;
+}
+
+// Emits the separator owed before a value in the current container
+static void begin_value(JsonWriter* w)
+{
+    if (w->after_key) {
+        w->after_key = 0;
+        return;
+    }
+    if (w->depth > 0) {
+        if (w->has_items[w->depth - 1])
+            append_char(w, ',');
+        w->has_items[w->depth - 1] = 1;
+    }
+}
+
+void json_writer_begin_frame(JsonWriter* w, const char* msg_type)
+{
+    w->len = 0;
+    w->depth = 0;
+    w->after_key = 0;
+    w->failed = 0;
+    if (!reserve(w, HEADER_SIZE))
+        return;
+    PacketHeader* header = (PacketHeader*)w->buf;
+    memset(header->msg_type, 0, 3);
+    memcpy(header->msg_type, msg_type, 3);
+    w->len = HEADER_SIZE;
+}
+
+int json_writer_finish(JsonWriter* w)
+{
+    // The peer drops frames over MAX_PAYLOAD_SIZE, so they are never sent
+    if (w->failed || w->depth != 0 || w->len < HEADER_SIZE || w->len > HEADER_SIZE + MAX_PAYLOAD_SIZE)
+        return -1;
+    uint32_t total_len = htonl((uint32_t)w->len);
+    memcpy(w->buf, &total_len, sizeof(total_len));
+    return 0;
+}
+
+// Replaces a frame that could not be finished, so the peer still gets an answer
+static void write_error_frame(JsonWriter* w)
+{
+    const char* message = w->failed || w->depth != 0 ? "Failed to build response" : "Response too large";
+    json_writer_begin_frame(w, MSG_TYPE_ERR);
+    json_writer_begin_object(w);
+    json_writer_key(w, JSON_KEY_STATUS);
+    json_writer_string(w, "ERROR");
+    json_writer_key(w, JSON_KEY_MESSAGE);
+    json_writer_string(w, message);
+    json_writer_end_object(w);
+}
+
+int json_writer_send(JsonWriter* w, int sock)
+{
+    int rc = json_writer_finish(w);
+    if (rc != 0 && w->len >= HEADER_SIZE) {
+        write_error_frame(w);
+        rc = json_writer_finish(w);
+    }
+    if (rc == 0)
+        rc = send_frame(sock, w->buf, w->len);
+
+    if (w->cap > RETAIN_CAPACITY)
+        json_writer_free(w);
+    return rc;
+}
+
+static void open_container(JsonWriter* w, char c)
+{
+    begin_value(w);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->failed = 1;
+        return;
+    }
+    w->has_items[w->depth++] = 0;
+    append_char(w, c);
+}
+
+static void close_container(JsonWriter* w, char c)
+{
+    if (w->depth == 0) {
+        w->failed = 1;
+        return;
+    }
+    w->depth--;
+    append_char(w, c);
+}
+
+void json_writer_begin_object(JsonWriter* w)
+{
+    open_container(w, '{');
+}
+
+void json_writer_end_object(JsonWriter* w)
+{
+    close_container(w, '}');
+}
+
+void json_writer_begin_array(JsonWriter* w)
+{
+    open_container(w, '[');
+}
+
+void json_writer_end_array(JsonWriter* w)
+{
+    close_container(w, ']');
+}
+
+// Same escaping as cJSON: quotes, backslashes and control characters, UTF-8 passes through
+static void append_quoted(JsonWriter* w, const char* s)
+{
+    append_char(w, '"');
+    const char* run = s;
+    for (const unsigned char* p = (const unsigned char*)s; *p; p++) {
+        if (*p >= 32 && *p != '"' && *p != '\\')
+            continue;
+        append(w, run, (const char*)p - run);
+        run = (const char*)p + 1;
+
+        char esc[7];
+        switch (*p) {
+        case '"': append(w, "\\\"", 2); break;
+        case '\\': append(w, "\\\\", 2); break;
+        case '\b': append(w, "\\b", 2); break;
+        case '\f': append(w, "\\f", 2); break;
+        case '\n': append(w, "\\n", 2); break;
+        case '\r': append(w, "\\r", 2); break;
+        case '\t': append(w, "\\t", 2); break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", *p);
+            append(w, esc, 6);
+            break;
+        }
+    }
+    append(w, run, strlen(run));
+    append_char(w, '"');
+}
+
+void json_writer_key(JsonWriter* w, const char* key)
+{
+    if (!key) {
+        w->failed = 1;
+        return;
+    }
+    begin_value(w);
+    append_quoted(w, key);
+    append_char(w, ':');
+    w->after_key = 1;
+}
+
+void json_writer_string(JsonWriter* w, const char* value)
+{
+    begin_value(w);
+    if (value)
+        append_quoted(w, value);
+    else
+        append(w, "null", 4);
+}
+
+void json_writer_int(JsonWriter* w, long value)
+{
+    json_writer_number(w, (double)value);
+}
+
+void json_writer_number(JsonWriter* w, double value)
+{
+    begin_value(w);
+    if (reserve(w, CJSON_NUMBER_BUFFER_SIZE))
+        w->len += cJSON_FormatNumber(value, w->buf + w->len);
+}
+
+void json_writer_bool(JsonWriter* w, int value)
+{
+    begin_value(w);
+    if (value)
+        append(w, "true", 4);
+    else
+        append(w, "false", 5);
+}
+
+void json_writer_null(JsonWriter* w)
+{
+    begin_value(w);
+    append(w, "null", 4);
+}
+
+void json_writer_raw(JsonWriter* w, const char* json, size_t len)
+{
+    begin_value(w);
+    append(w, json, len);
+}
+
+void json_writer_item(JsonWriter* w, const cJSON* item)
+{
+    const cJSON* child;
+    switch (item->type & 0xFF) {
+    case cJSON_False: json_writer_bool(w, 0); break;
+    case cJSON_True: json_writer_bool(w, 1); break;
+    case cJSON_NULL: json_writer_null(w); break;
+    case cJSON_Number: json_writer_number(w, item->valuedouble); break;
+    case cJSON_String: json_writer_string(w, item->valuestring); break;
+    case cJSON_Raw:
+        begin_value(w);
+        if (item->valuestring)
+            append(w, item->valuestring, strlen(item->valuestring));
+        break;
+    case cJSON_Array:
+        json_writer_begin_array(w);
+        for (child = item->child; child; child = child->next)
+            json_writer_item(w, child);
+        json_writer_end_array(w);
+        break;
+    case cJSON_Object:
+        json_writer_begin_object(w);
+        for (child = item->child; child; child = child->next) {
+            json_writer_key(w, child->string);
+            json_writer_item(w, child);
+        }
+        json_writer_end_object(w);
+        break;
+    default:
+        w->failed = 1;
+        break;
+    }
+}
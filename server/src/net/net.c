@@ -1,10 +1,12 @@
 #include "net.h"
+#include "trace.h"
 #include <arpa/inet.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 int net_listen(int port)
@@ -49,7 +51,9 @@ int net_listen(int port)
 
 int send_packet(int sock, const char* msg_type, cJSON* payload)
 {
+    uint64_t span = trace_span_begin();
     char* json_str = cJSON_PrintUnformatted(payload);
+    trace_span_end("print", span);
     if (!json_str)
         return -1;
 
@@ -61,22 +65,40 @@ int send_packet(int sock, const char* msg_type, cJSON* payload)
     memset(header.msg_type, 0, 3);
     memcpy(header.msg_type, msg_type, 3);
 
-    if (send(sock, &header, HEADER_SIZE, 0) != HEADER_SIZE) {
-        free(json_str);
-        return -1;
-    }
+    // Header and body leave in one syscall so Nagle does not hold back the body
+    struct iovec iov[2] = {
+        { .iov_base = &header, .iov_len = HEADER_SIZE },
+        { .iov_base = json_str, .iov_len = payload_len },
+    };
+    span = trace_span_begin();
+    int rc = 0;
+    if (writev(sock, iov, 2) != (ssize_t)total_len)
+        rc = -1;
+    trace_span_end("send", span);
+
+    cJSON_free(json_str);
+    return rc;
+}
 
-    if (send(sock, json_str, payload_len, 0) != (ssize_t)payload_len) {
-        free(json_str);
-        return -1;
+int send_frame(int sock, const char* frame, size_t len)
+{
+    uint64_t span = trace_span_begin();
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(sock, frame + sent, len - sent, 0);
+        if (n <= 0) {
+            trace_span_end("send", span);
+            return -1;
+        }
+        sent += (size_t)n;
     }
-
-    free(json_str);
+    trace_span_end("send", span);
     return 0;
 }
 
 int receive_packet(int sock, char* msg_type_out, cJSON** payload_out)
 {
+    uint64_t span = trace_span_begin();
     PacketHeader header;
     ssize_t bytes_read = recv(sock, &header, HEADER_SIZE, MSG_WAITALL);
     if (bytes_read != HEADER_SIZE)
@@ -93,21 +115,25 @@ int receive_packet(int sock, char* msg_type_out, cJSON** payload_out)
     strncpy(msg_type_out, header.msg_type, 3);
     msg_type_out[3] = '\0';
 
-    char* buffer = calloc(1, payload_len + 1);
+    // Allocated through the cJSON hooks so it lands in the request arena
+    char* buffer = cJSON_malloc(payload_len + 1);
     if (!buffer)
         return -1;
 
     bytes_read = recv(sock, buffer, payload_len, MSG_WAITALL);
     if (bytes_read != (ssize_t)payload_len) {
-        free(buffer);
+        cJSON_free(buffer);
         return -1;
     }
 
-    // calloc already ensures null terminator
+    trace_span_end("recv", span);
+
     buffer[payload_len] = '\0';
 
-    *payload_out = cJSON_Parse(buffer);
-    free(buffer);
+    // Strings are unescaped in place and the tree takes ownership of the buffer
+    span = trace_span_begin();
+    *payload_out = cJSON_ParseInSitu(buffer, payload_len);
+    trace_span_end("parse", span);
 
     return (*payload_out) ? 0 : -3;
 }
@@ -0,0 +1,809 @@
+#include "storage_engine.h"
+#include "json_arena.h"
+#include "qbk.h"
+#include "request.h"
+#include "trace.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The files engine: users.txt, rooms.json, one NDJSON file of results per
+// room and one .qbk file per bank, all under data/, with the snapshot lsn in
+// data/journal.ckpt. Files are replaced through a synced temporary and a
+// rename, results are appended.
+
+#define USER_FILE "data/users.txt"
+#define ROOMS_FILE "data/rooms.json"
+#define QUESTION_BANK_DIR "data/questions/"
+#define RESULT_DIR "data/results/"
+#define CHECKPOINT_FILE "data/journal.ckpt"
+
+static cJSON* load_json_file(const char* path)
+{
+    uint64_t span = trace_span_begin();
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        trace_span_end("storage.read", span);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* data = cJSON_malloc(len + 1);
+    if (!data) {
+        fclose(f);
+        trace_span_end("storage.read", span);
+        return NULL;
+    }
+    size_t n = fread(data, 1, len, f);
+    data[n] = '\0';
+    fclose(f);
+    trace_span_end("storage.read", span);
+
+    span = trace_span_begin();
+    // The tree takes ownership of data
+    cJSON* root = cJSON_ParseInSitu(data, n);
+    trace_span_end("storage.parse", span);
+    return root;
+}
+
+static int write_bytes_durable(const char* path, const char* data, size_t len)
+{
+    char tmp_path[280];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n <= 0)
+            break;
+        done += (size_t)n;
+    }
+    int ok = done == len && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (ok && rename(tmp_path, path) == 0)
+        return 0;
+    unlink(tmp_path);
+    return -1;
+}
+
+static int write_file_durable(const char* path, const char* text)
+{
+    return write_bytes_durable(path, text, strlen(text));
+}
+
+static int append_file_durable(const char* path, const char* text)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+        return -1;
+
+    // A torn line left by a crash is closed off so it cannot swallow the first new one
+    struct stat st;
+    char last = '\n';
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        int rfd = open(path, O_RDONLY);
+        if (rfd >= 0) {
+            if (pread(rfd, &last, 1, st.st_size - 1) != 1)
+                last = '\n';
+            close(rfd);
+        }
+    }
+
+    int ok = last == '\n' || write(fd, "\n", 1) == 1;
+    size_t len = strlen(text);
+    size_t done = 0;
+    while (ok && done < len) {
+        ssize_t n = write(fd, text + done, len - done);
+        if (n <= 0)
+            break;
+        done += (size_t)n;
+    }
+    ok = ok && done == len && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    return ok ? 0 : -1;
+}
+
+static void sync_dir(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// Calls fn with the names of the files in dir ending in ext, ext removed
+static int list_dir(const char* dir, const char* ext, StorageNameFn fn, void* ctx)
+{
+    DIR* d = opendir(dir);
+    if (!d)
+        return -1;
+    struct dirent* entry;
+    size_t ext_len = strlen(ext);
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len > ext_len && strcmp(entry->d_name + len - ext_len, ext) == 0) {
+            char name[256];
+            snprintf(name, sizeof(name), "%.*s", (int)(len - ext_len), entry->d_name);
+            fn(name, ctx);
+        }
+    }
+    closedir(d);
+    return 0;
+}
+
+// Users
+
+// Parses one "username:password[:role]" line straight from the mapping, 0 if it holds no user
+static int parse_user_line(StorageUser* user, const char* line, const char* end)
+{
+    if (end > line && end[-1] == '\r')
+        end--;
+    const char* colon = memchr(line, ':', end - line);
+    if (!colon || colon == line)
+        return 0;
+
+    const char* password = colon + 1;
+    const char* password_end = memchr(password, ':', end - password);
+    const char* role = NULL;
+    const char* role_end = NULL;
+    if (password_end) {
+        role = password_end + 1;
+        role_end = memchr(role, ':', end - role);
+        if (!role_end)
+            role_end = end;
+    } else {
+        password_end = end;
+    }
+    if (password_end == password)
+        return 0;
+
+    user->name = line;
+    user->name_len = colon - line;
+    user->password = password;
+    user->password_len = password_end - password;
+    user->role = role;
+    user->role_len = role ? (size_t)(role_end - role) : 0;
+    return 1;
+}
+
+// The file is mapped and split with memchr (vectorized in libc); counting
+// lines first gives the caller the total before the first batch
+int storage_file_scan_users(const char* path, StorageUserFn fn, void* ctx)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+
+    const char* end = data + size;
+    int lines = 1;
+    for (const char* p = data; (p = memchr(p, '\n', end - p)) != NULL; p++)
+        lines++;
+
+    StorageUser batch[STORAGE_USER_BATCH];
+    const char* line = data;
+    int rc = 0;
+    while (line < end && rc == 0) {
+        int n = 0;
+        while (n < STORAGE_USER_BATCH && line < end) {
+            const char* newline = memchr(line, '\n', end - line);
+            const char* line_end = newline ? newline : end;
+            n += parse_user_line(&batch[n], line, line_end);
+            line = line_end + 1;
+        }
+        if (n)
+            rc = fn(batch, n, lines, ctx);
+    }
+    munmap((void*)data, size);
+    return rc;
+}
+
+static int file_load_users(StorageUserFn fn, void* ctx)
+{
+    return storage_file_scan_users(USER_FILE, fn, ctx);
+}
+
+// Rooms
+
+int storage_file_scan_rooms(const char* path, StorageRoomFn fn, void* ctx)
+{
+    cJSON* root = load_json_file(path);
+    if (!root)
+        return -1;
+    cJSON* item = NULL;
+    cJSON_ArrayForEach(item, root)
+    {
+        Room room;
+        if (request_decode(&room_record_schema, item, &room) == NULL)
+            fn(&room, ctx);
+    }
+    cJSON_Delete(root);
+    return 0;
+}
+
+static int file_load_rooms(StorageRoomFn fn, void* ctx)
+{
+    return storage_file_scan_rooms(ROOMS_FILE, fn, ctx);
+}
+
+// Results
+//
+// data/results/<room>.ndjson, one compact JSON object per line. Each stored
+// result carries its journal lsn as "seq", so compaction skips pending
+// results a file already holds, and replaying a record twice cannot
+// duplicate it. Files from before NDJSON (<room>.json arrays) are converted
+// once at open.
+#define RESULT_EXT ".ndjson"
+#define LEGACY_RESULT_EXT ".json"
+#define RESULT_READ_CHUNK (64 * 1024)
+#define RESULT_TAIL_BYTES 4096
+
+static void result_file_path(char* path, size_t size, const char* room_id)
+{
+    snprintf(path, size, "%s%s" RESULT_EXT, RESULT_DIR, room_id);
+}
+
+static const char* match_prefix(const char* p, const char* end, const char* prefix)
+{
+    size_t n = strlen(prefix);
+    return (size_t)(end - p) >= n && memcmp(p, prefix, n) == 0 ? p + n : NULL;
+}
+
+static const char* match_number(const char* p, const char* end, long* out)
+{
+    char* stop;
+    *out = strtol(p, &stop, 10);
+    return stop > p && stop <= end ? stop : NULL;
+}
+
+// Lines exactly as append_result_line() writes them, without escapes; 0 sends the caller to cJSON
+static int parse_result_line_fast(const char* p, const char* end, RoomResult* result)
+{
+    long score;
+    if (!(p = match_prefix(p, end, "{\"username\":\"")))
+        return 0;
+    const char* name = p;
+    while (p < end && *p != '"' && *p != '\\')
+        p++;
+    if (p == end || *p != '"' || (size_t)(p - name) >= sizeof(result->username))
+        return 0;
+
+    memset(result, 0, sizeof(*result));
+    memcpy(result->username, name, p - name);
+    if (!(p = match_prefix(p, end, "\",\"score\":")) || !(p = match_number(p, end, &score))
+        || !(p = match_prefix(p, end, ",\"timestamp\":")) || !(p = match_number(p, end, &result->timestamp)))
+        return 0;
+    result->score = (int)score;
+    // Migrated lines have no seq
+    const char* seq = match_prefix(p, end, ",\"seq\":");
+    if (seq && !(p = match_number(seq, end, &result->seq)))
+        return 0;
+    return p + 1 == end && *p == '}';
+}
+
+// Lines end in '\n' inside the caller's buffer, which bounds the number scans
+static int parse_result_line(const char* line, size_t len, RoomResult* result)
+{
+    if (parse_result_line_fast(line, line + len, result))
+        return 1;
+    cJSON* item = cJSON_ParseWithLength(line, len);
+    int ok = item && request_decode(&result_record_schema, item, result) == NULL;
+    json_release(item);
+    return ok;
+}
+
+// Streams a room's file line by line and returns the highest seq in it.
+// An unterminated last line is a torn append and is skipped.
+static long file_for_each_result(const char* room_id, StorageResultFn fn, void* ctx)
+{
+    char filepath[256];
+    result_file_path(filepath, sizeof(filepath), room_id);
+    FILE* f = fopen(filepath, "r");
+    if (!f)
+        return 0; // No results is fine
+
+    uint64_t span = trace_span_begin();
+    char room[sizeof(((RoomResult*)0)->room_id)];
+    snprintf(room, sizeof(room), "%s", room_id);
+    long stored_seq = 0;
+    char* buf = malloc(RESULT_READ_CHUNK);
+    size_t used = 0;
+    size_t n;
+    while (buf && (n = fread(buf + used, 1, RESULT_READ_CHUNK - used, f)) > 0) {
+        used += n;
+        size_t start = 0;
+        char* newline;
+        while ((newline = memchr(buf + start, '\n', used - start))) {
+            size_t len = newline - (buf + start);
+            RoomResult result;
+            if (len && parse_result_line(buf + start, len, &result)) {
+                memcpy(result.room_id, room, sizeof(room));
+                if (result.seq > stored_seq)
+                    stored_seq = result.seq;
+                fn(&result, ctx);
+            }
+            start += len + 1;
+        }
+        used -= start;
+        memmove(buf, buf + start, used);
+        if (used == RESULT_READ_CHUNK)
+            used = 0; // far longer than any result line, drop it
+    }
+    free(buf);
+    fclose(f);
+    trace_span_end("storage.read", span);
+    return stored_seq;
+}
+
+static int file_list_result_rooms(StorageNameFn fn, void* ctx)
+{
+    return list_dir(RESULT_DIR, RESULT_EXT, fn, ctx);
+}
+
+// Seq of the last complete line, read from the file's tail
+static long read_last_seq(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    char tail[RESULT_TAIL_BYTES];
+    ssize_t n = 0;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        off_t from = st.st_size > RESULT_TAIL_BYTES ? st.st_size - RESULT_TAIL_BYTES : 0;
+        n = pread(fd, tail, st.st_size - from, from);
+    }
+    close(fd);
+
+    // Drop a torn last line, then parse the complete one before it
+    while (n > 0 && tail[n - 1] != '\n')
+        n--;
+    if (n <= 0)
+        return 0;
+    ssize_t start = n - 1;
+    while (start > 0 && tail[start - 1] != '\n')
+        start--;
+    RoomResult result;
+    return parse_result_line(tail + start, n - 1 - start, &result) ? result.seq : 0;
+}
+
+static int append_result_line(const RoomResult* result, char** text, size_t* len, size_t* cap)
+{
+    cJSON* record = storage_result_to_json(result, 1);
+    char* line = cJSON_PrintUnformatted(record);
+    json_release(record);
+    if (!line)
+        return -1;
+    size_t n = strlen(line);
+    if (*len + n + 2 > *cap) {
+        size_t grown_cap = *cap ? *cap * 2 : 4096;
+        while (grown_cap < *len + n + 2)
+            grown_cap *= 2;
+        char* grown = realloc(*text, grown_cap);
+        if (!grown) {
+            cJSON_free(line);
+            return -1;
+        }
+        *text = grown;
+        *cap = grown_cap;
+    }
+    memcpy(*text + *len, line, n);
+    (*text)[*len + n] = '\n';
+    *len += n + 1;
+    (*text)[*len] = '\0';
+    cJSON_free(line);
+    return 0;
+}
+
+// Converts data/results/<room>.json arrays into <room>.ndjson files
+static void migrate_legacy_results(void)
+{
+    DIR* d = opendir(RESULT_DIR);
+    if (!d)
+        return;
+
+    int migrated = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        size_t name_len = strlen(entry->d_name);
+        size_t ext_len = strlen(LEGACY_RESULT_EXT);
+        if (name_len <= ext_len || strcmp(entry->d_name + name_len - ext_len, LEGACY_RESULT_EXT) != 0)
+            continue;
+
+        char room_id[128];
+        snprintf(room_id, sizeof(room_id), "%.*s", (int)(name_len - ext_len), entry->d_name);
+        char legacy_path[300];
+        char path[300];
+        snprintf(legacy_path, sizeof(legacy_path), "%s%s", RESULT_DIR, entry->d_name);
+        result_file_path(path, sizeof(path), room_id);
+        if (access(path, F_OK) == 0) {
+            printf("Skipping %s: %s already exists\n", legacy_path, path);
+            continue;
+        }
+
+        char* text = NULL;
+        size_t len = 0;
+        size_t cap = 0;
+        int rc = 0;
+        cJSON* root = load_json_file(legacy_path);
+        cJSON* item;
+        cJSON_ArrayForEach(item, root)
+        {
+            RoomResult result;
+            if (request_decode(&result_record_schema, item, &result) == NULL && rc == 0)
+                rc = append_result_line(&result, &text, &len, &cap);
+        }
+        cJSON_Delete(root);
+
+        if (rc == 0 && write_file_durable(path, text ? text : "") == 0 && unlink(legacy_path) == 0)
+            migrated++;
+        else
+            printf("Failed to migrate %s\n", legacy_path);
+        free(text);
+    }
+    closedir(d);
+    if (migrated)
+        printf("Migrated %d result files to NDJSON.\n", migrated);
+}
+
+// Question banks
+
+#define BANK_EXT ".qbk"
+#define LEGACY_BANK_EXT ".json"
+
+static void bank_file_path(char* path, size_t size, const char* bank_id)
+{
+    snprintf(path, size, "%s%s%s", QUESTION_BANK_DIR, bank_id, BANK_EXT);
+}
+
+static void stamp_of(const struct stat* st, uint64_t stamp[3])
+{
+    stamp[0] = (uint64_t)st->st_ino;
+    stamp[1] = (uint64_t)st->st_size;
+    stamp[2] = (uint64_t)st->st_mtime;
+}
+
+static int file_load_bank(const char* bank_id, StorageBank* bank)
+{
+    char path[256];
+    bank_file_path(path, sizeof(path), bank_id);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    // Identity is taken from the descriptor in case the file changes meanwhile
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    uint64_t span = trace_span_begin();
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    trace_span_end("storage.read", span);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    bank->data = map;
+    bank->size = (size_t)st.st_size;
+    bank->handle = map;
+    stamp_of(&st, bank->stamp);
+    return 0;
+}
+
+// A bank left as JSON by a failed conversion counts too
+static int file_bank_exists(const char* bank_id)
+{
+    char path[300];
+    struct stat st;
+    bank_file_path(path, sizeof(path), bank_id);
+    if (stat(path, &st) == 0)
+        return 1;
+    snprintf(path, sizeof(path), "%s%s%s", QUESTION_BANK_DIR, bank_id, LEGACY_BANK_EXT);
+    return stat(path, &st) == 0;
+}
+
+static void file_release_bank(StorageBank* bank)
+{
+    munmap(bank->handle, bank->size);
+}
+
+// A file replaced behind our back shows up as a new inode, size or mtime
+static int file_bank_is_current(const char* bank_id, const StorageBank* bank)
+{
+    char path[256];
+    bank_file_path(path, sizeof(path), bank_id);
+    struct stat st;
+    uint64_t stamp[3];
+    if (stat(path, &st) != 0)
+        return 0;
+    stamp_of(&st, stamp);
+    return memcmp(stamp, bank->stamp, sizeof(stamp)) == 0;
+}
+
+static int file_put_bank(const char* bank_id, const void* data, size_t size)
+{
+    char path[256];
+    bank_file_path(path, sizeof(path), bank_id);
+    // Replaced by rename, so mappings of the old file stay valid until they are released
+    uint64_t span = trace_span_begin();
+    int rc = write_bytes_durable(path, data, size);
+    trace_span_end("storage.write", span);
+    return rc;
+}
+
+static int file_list_banks(StorageNameFn fn, void* ctx)
+{
+    return list_dir(QUESTION_BANK_DIR, BANK_EXT, fn, ctx);
+}
+
+// Converts banks left as JSON arrays by earlier versions
+static void migrate_legacy_banks(void)
+{
+    DIR* d = opendir(QUESTION_BANK_DIR);
+    if (!d)
+        return;
+
+    int migrated = 0;
+    struct dirent* dir;
+    while ((dir = readdir(d)) != NULL) {
+        size_t len = strlen(dir->d_name);
+        size_t ext_len = strlen(LEGACY_BANK_EXT);
+        if (len <= ext_len || strcmp(dir->d_name + len - ext_len, LEGACY_BANK_EXT) != 0)
+            continue;
+
+        char bank_id[256];
+        char legacy_path[300];
+        snprintf(bank_id, sizeof(bank_id), "%.*s", (int)(len - ext_len), dir->d_name);
+        snprintf(legacy_path, sizeof(legacy_path), "%s%s", QUESTION_BANK_DIR, dir->d_name);
+
+        cJSON* questions = load_json_file(legacy_path);
+        size_t size = 0;
+        char* data = questions ? qbk_encode(questions, &size) : NULL;
+        if (data && file_put_bank(bank_id, data, size) == 0 && unlink(legacy_path) == 0)
+            migrated++;
+        else
+            printf("Could not convert question bank %s, leaving it as JSON\n", legacy_path);
+        free(data);
+        json_release(questions);
+    }
+    closedir(d);
+    if (migrated)
+        printf("Converted %d question banks to %s.\n", migrated, BANK_EXT);
+}
+
+// Snapshots: changed banks are replaced or removed, changed users appended
+// to users.txt (a later line replaces an earlier one), rooms.json is
+// replaced, each room's results file gets the new lines past its last seq,
+// then journal.ckpt records the lsn
+
+typedef enum
+{
+    SNAPSHOT_REPLACE,
+    SNAPSHOT_APPEND, // text lines after the existing ones
+    SNAPSHOT_REMOVE
+} SnapshotMode;
+
+typedef struct
+{
+    char path[256];
+    char* data; // NULL for SNAPSHOT_REMOVE
+    size_t len;
+    SnapshotMode mode;
+} SnapshotFile;
+
+typedef struct
+{
+    SnapshotFile* files;
+    int count;
+    uint64_t lsn;
+    int rc;
+} FileSnapshotJob;
+
+// Takes ownership of data (malloc'd); only a removal goes without
+static void add_snapshot_file(FileSnapshotJob* job, const char* path, char* data, size_t len, SnapshotMode mode)
+{
+    SnapshotFile* files = data || mode == SNAPSHOT_REMOVE
+                              ? realloc(job->files, (job->count + 1) * sizeof(SnapshotFile))
+                              : NULL;
+    if (!files) {
+        free(data);
+        job->rc = -1;
+        return;
+    }
+    job->files = files;
+    snprintf(files[job->count].path, sizeof(files[job->count].path), "%s", path);
+    files[job->count].data = data;
+    files[job->count].len = len;
+    files[job->count].mode = mode;
+    job->count++;
+}
+
+static void add_snapshot_text(FileSnapshotJob* job, const char* path, char* text, SnapshotMode mode)
+{
+    add_snapshot_file(job, path, text, text ? strlen(text) : 0, mode);
+}
+
+static char* user_lines(const StorageUser* users, int count)
+{
+    size_t len = 0;
+    for (int i = 0; i < count; i++)
+        len += users[i].name_len + users[i].password_len + users[i].role_len + 3;
+    char* text = malloc(len + 1);
+    if (!text)
+        return NULL;
+    char* p = text;
+    for (int i = 0; i < count; i++) {
+        const StorageUser* u = &users[i];
+        p += sprintf(p, "%.*s:%.*s:%.*s\n", (int)u->name_len, u->name, (int)u->password_len, u->password,
+                     (int)u->role_len, u->role ? u->role : "");
+    }
+    *p = '\0';
+    return text;
+}
+
+// New lines for one room's results file: the results past its last seq
+static char* new_result_lines(const RoomResult* results, int count, const char* path)
+{
+    long stored_seq = read_last_seq(path);
+    char* text = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    for (int i = 0; i < count; i++) {
+        if (results[i].seq <= stored_seq)
+            continue;
+        if (append_result_line(&results[i], &text, &len, &cap) != 0) {
+            free(text);
+            return NULL;
+        }
+    }
+    return text ? text : strdup("");
+}
+
+static void* file_prepare_snapshot(const StorageSnapshot* snapshot)
+{
+    FileSnapshotJob* job = calloc(1, sizeof(FileSnapshotJob));
+    if (!job)
+        return NULL;
+    job->lsn = snapshot->lsn;
+
+    for (int i = 0; i < snapshot->bank_count; i++) {
+        const StorageBankChange* bank = &snapshot->banks[i];
+        char path[256];
+        bank_file_path(path, sizeof(path), bank->id);
+        char* data = bank->data ? malloc(bank->size) : NULL;
+        if (data)
+            memcpy(data, bank->data, bank->size);
+        add_snapshot_file(job, path, data, bank->size, bank->data ? SNAPSHOT_REPLACE : SNAPSHOT_REMOVE);
+        // An unconverted JSON bank would otherwise come back with the next start's migration
+        snprintf(path, sizeof(path), "%s%s%s", QUESTION_BANK_DIR, bank->id, LEGACY_BANK_EXT);
+        add_snapshot_file(job, path, NULL, 0, SNAPSHOT_REMOVE);
+    }
+    if (snapshot->user_count)
+        add_snapshot_text(job, USER_FILE, user_lines(snapshot->users, snapshot->user_count), SNAPSHOT_APPEND);
+
+    cJSON* root = cJSON_CreateArray();
+    for (int i = 0; i < snapshot->room_count; i++)
+        cJSON_AddItemToArray(root, storage_room_to_json(&snapshot->rooms[i]));
+    char* rooms_text = cJSON_Print(root);
+    json_release(root);
+    add_snapshot_text(job, ROOMS_FILE, rooms_text ? strdup(rooms_text) : NULL, SNAPSHOT_REPLACE);
+    cJSON_free(rooms_text);
+
+    for (int i = 0; i < snapshot->result_count;) {
+        const RoomResult* first = &snapshot->results[i];
+        int n = 1;
+        while (i + n < snapshot->result_count && strcmp(snapshot->results[i + n].room_id, first->room_id) == 0)
+            n++;
+        char filepath[256];
+        result_file_path(filepath, sizeof(filepath), first->room_id);
+        add_snapshot_text(job, filepath, new_result_lines(first, n, filepath), SNAPSHOT_APPEND);
+        i += n;
+    }
+    return job;
+}
+
+static int file_write_snapshot(void* arg)
+{
+    FileSnapshotJob* job = arg;
+    for (int i = 0; i < job->count && job->rc == 0; i++) {
+        const SnapshotFile* file = &job->files[i];
+        if (file->mode == SNAPSHOT_APPEND)
+            job->rc = append_file_durable(file->path, file->data);
+        else if (file->mode == SNAPSHOT_REPLACE)
+            job->rc = write_bytes_durable(file->path, file->data, file->len);
+        else
+            job->rc = remove(file->path) == 0 || errno == ENOENT ? 0 : -1;
+    }
+    sync_dir(QUESTION_BANK_DIR);
+    sync_dir(RESULT_DIR);
+    sync_dir("data");
+
+    if (job->rc == 0) {
+        char text[32];
+        snprintf(text, sizeof(text), "%llu\n", (unsigned long long)job->lsn);
+        job->rc = write_file_durable(CHECKPOINT_FILE, text);
+    }
+    return job->rc;
+}
+
+static void file_free_snapshot(void* arg)
+{
+    FileSnapshotJob* job = arg;
+    if (!job)
+        return;
+    for (int i = 0; i < job->count; i++)
+        free(job->files[i].data);
+    free(job->files);
+    free(job);
+}
+
+static uint64_t file_checkpoint_lsn(void)
+{
+    unsigned long long lsn = 0;
+    FILE* f = fopen(CHECKPOINT_FILE, "r");
+    if (f) {
+        if (fscanf(f, "%llu", &lsn) != 1)
+            lsn = 0;
+        fclose(f);
+    }
+    return lsn;
+}
+
+static int file_open(void)
+{
+    mkdir("data", 0777);
+    mkdir(QUESTION_BANK_DIR, 0777);
+    mkdir(RESULT_DIR, 0777);
+    migrate_legacy_banks();
+    migrate_legacy_results();
+    return 0;
+}
+
+static void file_close(void)
+{
+}
+
+const StorageEngine storage_engine_files = {
+    .name = "files",
+    .open = file_open,
+    .close = file_close,
+    .checkpoint_lsn = file_checkpoint_lsn,
+    .load_users = file_load_users,
+    .load_rooms = file_load_rooms,
+    .for_each_result = file_for_each_result,
+    .list_result_rooms = file_list_result_rooms,
+    .prepare_snapshot = file_prepare_snapshot,
+    .write_snapshot = file_write_snapshot,
+    .free_snapshot = file_free_snapshot,
+    .load_bank = file_load_bank,
+    .bank_exists = file_bank_exists,
+    .release_bank = file_release_bank,
+    .bank_is_current = file_bank_is_current,
+    .list_banks = file_list_banks,
+    .stats_to_json = NULL,
+};
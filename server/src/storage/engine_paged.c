@@ -0,0 +1,775 @@
+#include "storage_engine.h"
+#include "config.h"
+#include "pagedb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The paged engine: everything in data/quizzie.db (see pagedb.h), one
+// B+tree whose keys start with a tag byte:
+//   'u' username                  password '\0' role
+//   'r' room id                   StoredRoom
+//   'R' room id '\0' be64 row     StoredResult
+//   'b' bank id                   qbk bytes
+// A room's results sort by row, so reading them is one range scan and
+// finding the last one a single descent. A new database starts as a copy of
+// whatever the files engine holds; the files are left alone afterwards.
+//   QUIZZIE_PAGE_CACHE_PAGES   buffer cache size in 4 KB pages (1024)
+
+#define DB_FILE "data/quizzie.db"
+#define DEFAULT_CACHE_PAGES 1024
+#define ROW_BYTES 8
+
+typedef struct
+{
+    uint32_t pos; // in the room list
+    Room room;
+} StoredRoom;
+
+typedef struct
+{
+    int64_t seq;
+    int64_t timestamp;
+    int32_t score;
+    char username[32];
+} StoredResult;
+
+static PageDb* db;
+
+// 0 if the name does not fit in a key
+static size_t make_key(unsigned char* key, char tag, const char* name, size_t len)
+{
+    if (len + 1 > PAGEDB_MAX_KEY)
+        return 0;
+    key[0] = (unsigned char)tag;
+    memcpy(key + 1, name, len);
+    return len + 1;
+}
+
+static size_t bounded_len(const char* s, size_t max)
+{
+    const char* end = memchr(s, '\0', max);
+    return end ? (size_t)(end - s) : max;
+}
+
+static size_t result_prefix(unsigned char* key, const char* room_id)
+{
+    size_t len = make_key(key, 'R', room_id, bounded_len(room_id, sizeof(((Room*)0)->id)));
+    key[len++] = '\0';
+    return len;
+}
+
+static size_t result_key(unsigned char* key, const char* room_id, uint64_t row)
+{
+    size_t len = result_prefix(key, room_id);
+    for (int i = ROW_BYTES - 1; i >= 0; i--)
+        key[len++] = (unsigned char)(row >> (i * 8));
+    return len;
+}
+
+static uint64_t key_row(const unsigned char* p)
+{
+    uint64_t row = 0;
+    for (int i = 0; i < ROW_BYTES; i++)
+        row = row << 8 | p[i];
+    return row;
+}
+
+// Users
+
+typedef struct
+{
+    StorageUserFn fn;
+    void* ctx;
+    StorageUser batch[STORAGE_USER_BATCH];
+    char names[STORAGE_USER_BATCH][PAGEDB_MAX_KEY];
+    char values[STORAGE_USER_BATCH][192];
+    int count;
+    int rc;
+} UserScan;
+
+static int scan_user(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx)
+{
+    UserScan* scan = ctx;
+    if (((const char*)key)[0] != 'u')
+        return 1;
+
+    int i = scan->count;
+    StorageUser* user = &scan->batch[i];
+    memcpy(scan->names[i], (const char*)key + 1, key_len - 1);
+    size_t copied = value_len < sizeof(scan->values[i]) - 1 ? value_len : sizeof(scan->values[i]) - 1;
+    memcpy(scan->values[i], value, copied);
+    scan->values[i][copied] = '\0';
+
+    user->name = scan->names[i];
+    user->name_len = key_len - 1;
+    user->password = scan->values[i];
+    user->password_len = strlen(scan->values[i]);
+    user->role = user->password_len + 1 < copied ? scan->values[i] + user->password_len + 1 : NULL;
+    user->role_len = user->role ? copied - user->password_len - 1 : 0;
+    if (++scan->count < STORAGE_USER_BATCH)
+        return 0;
+    scan->rc = scan->fn(scan->batch, scan->count, 0, scan->ctx);
+    scan->count = 0;
+    return scan->rc != 0;
+}
+
+static int paged_load_users(StorageUserFn fn, void* ctx)
+{
+    UserScan* scan = calloc(1, sizeof(UserScan));
+    if (!scan)
+        return -1;
+    scan->fn = fn;
+    scan->ctx = ctx;
+    int rc = pagedb_scan(db, "u", 1, scan_user, scan);
+    if (rc == 0 && scan->rc == 0 && scan->count)
+        scan->rc = fn(scan->batch, scan->count, 0, ctx);
+    rc = rc ? rc : scan->rc;
+    free(scan);
+    return rc;
+}
+
+static int put_user_value(const char* username, size_t username_len, const char* password, size_t password_len,
+                          const char* role, size_t role_len)
+{
+    unsigned char key[PAGEDB_MAX_KEY];
+    char value[192];
+    size_t key_len = make_key(key, 'u', username, username_len);
+    if (!key_len || password_len + role_len + 1 > sizeof(value))
+        return -1;
+    memcpy(value, password, password_len);
+    value[password_len] = '\0';
+    memcpy(value + password_len + 1, role, role_len);
+    return pagedb_put(db, key, key_len, value, password_len + 1 + role_len);
+}
+
+// Rooms
+
+typedef struct
+{
+    StoredRoom* rooms;
+    int count;
+    int cap;
+} RoomScan;
+
+static int scan_room(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx)
+{
+    (void)key_len;
+    RoomScan* scan = ctx;
+    if (((const char*)key)[0] != 'r')
+        return 1;
+    if (value_len != sizeof(StoredRoom))
+        return 0;
+    if (scan->count == scan->cap) {
+        int cap = scan->cap ? scan->cap * 2 : 64;
+        StoredRoom* grown = realloc(scan->rooms, cap * sizeof(StoredRoom));
+        if (!grown)
+            return 1;
+        scan->rooms = grown;
+        scan->cap = cap;
+    }
+    memcpy(&scan->rooms[scan->count++], value, sizeof(StoredRoom));
+    return 0;
+}
+
+static int compare_room_pos(const void* a, const void* b)
+{
+    uint32_t pa = ((const StoredRoom*)a)->pos;
+    uint32_t pb = ((const StoredRoom*)b)->pos;
+    return pa < pb ? -1 : pa > pb;
+}
+
+static int paged_load_rooms(StorageRoomFn fn, void* ctx)
+{
+    RoomScan scan = { NULL, 0, 0 };
+    int rc = pagedb_scan(db, "r", 1, scan_room, &scan);
+    qsort(scan.rooms, scan.count, sizeof(StoredRoom), compare_room_pos);
+    for (int i = 0; i < scan.count; i++)
+        fn(&scan.rooms[i].room, ctx);
+    free(scan.rooms);
+    return rc;
+}
+
+static int put_room(const Room* room, uint32_t pos)
+{
+    unsigned char key[PAGEDB_MAX_KEY];
+    StoredRoom stored;
+    memset(&stored, 0, sizeof(stored));
+    stored.pos = pos;
+    stored.room = *room;
+    size_t key_len = make_key(key, 'r', room->id, bounded_len(room->id, sizeof(room->id)));
+
+    // Unchanged rooms are left alone so a snapshot only copies the pages it must
+    void* old = NULL;
+    size_t old_len = 0;
+    int same = pagedb_get(db, key, key_len, &old, &old_len) == 0 && old_len == sizeof(stored)
+               && memcmp(old, &stored, sizeof(stored)) == 0;
+    free(old);
+    return same ? 0 : pagedb_put(db, key, key_len, &stored, sizeof(stored));
+}
+
+// Results
+
+typedef struct
+{
+    unsigned char prefix[PAGEDB_MAX_KEY];
+    size_t prefix_len;
+    const char* room_id;
+    StorageResultFn fn;
+    void* ctx;
+    long stored_seq;
+    uint64_t last_row;
+    int found;
+} ResultScan;
+
+static void unpack_result(const void* value, const char* room_id, RoomResult* result)
+{
+    StoredResult stored;
+    memcpy(&stored, value, sizeof(stored));
+    memset(result, 0, sizeof(*result));
+    snprintf(result->room_id, sizeof(result->room_id), "%s", room_id);
+    memcpy(result->username, stored.username, sizeof(result->username));
+    result->username[sizeof(result->username) - 1] = '\0';
+    result->score = stored.score;
+    result->timestamp = (long)stored.timestamp;
+    result->seq = (long)stored.seq;
+}
+
+static int is_result_of(const ResultScan* scan, const void* key, size_t key_len)
+{
+    return key_len == scan->prefix_len + ROW_BYTES && memcmp(key, scan->prefix, scan->prefix_len) == 0;
+}
+
+static int scan_result(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx)
+{
+    ResultScan* scan = ctx;
+    if (!is_result_of(scan, key, key_len))
+        return 1;
+    if (value_len != sizeof(StoredResult))
+        return 0;
+    RoomResult result;
+    unpack_result(value, scan->room_id, &result);
+    if (result.seq > scan->stored_seq)
+        scan->stored_seq = result.seq;
+    scan->fn(&result, scan->ctx);
+    return 0;
+}
+
+static long paged_for_each_result(const char* room_id, StorageResultFn fn, void* ctx)
+{
+    ResultScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.prefix_len = result_prefix(scan.prefix, room_id);
+    scan.room_id = room_id;
+    scan.fn = fn;
+    scan.ctx = ctx;
+    pagedb_scan(db, scan.prefix, scan.prefix_len, scan_result, &scan);
+    return scan.stored_seq;
+}
+
+static int take_last_result(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx)
+{
+    ResultScan* scan = ctx;
+    if (is_result_of(scan, key, key_len) && value_len == sizeof(StoredResult)) {
+        StoredResult stored;
+        memcpy(&stored, value, sizeof(stored));
+        scan->found = 1;
+        scan->last_row = key_row((const unsigned char*)key + scan->prefix_len);
+        scan->stored_seq = (long)stored.seq;
+    }
+    return 1;
+}
+
+// The room's last row, found by one descent to the greatest key below 'R' room '\1'
+static void find_last_result(const char* room_id, ResultScan* scan)
+{
+    memset(scan, 0, sizeof(*scan));
+    scan->prefix_len = result_prefix(scan->prefix, room_id);
+    unsigned char below[PAGEDB_MAX_KEY];
+    memcpy(below, scan->prefix, scan->prefix_len);
+    below[scan->prefix_len - 1] = 1;
+    pagedb_last_below(db, below, scan->prefix_len, take_last_result, scan);
+}
+
+// Appends the results past the room's last stored seq; results are one room's, in seq order
+static int append_results(const RoomResult* results, int count)
+{
+    ResultScan last;
+    find_last_result(results[0].room_id, &last);
+    uint64_t row = last.found ? last.last_row + 1 : 0;
+    for (int i = 0; i < count; i++) {
+        if (results[i].seq <= last.stored_seq)
+            continue;
+        StoredResult stored;
+        memset(&stored, 0, sizeof(stored));
+        stored.seq = results[i].seq;
+        stored.timestamp = results[i].timestamp;
+        stored.score = results[i].score;
+        snprintf(stored.username, sizeof(stored.username), "%s", results[i].username);
+        unsigned char key[PAGEDB_MAX_KEY];
+        size_t key_len = result_key(key, results[i].room_id, row++);
+        if (pagedb_put(db, key, key_len, &stored, sizeof(stored)) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+typedef struct
+{
+    char name[PAGEDB_MAX_KEY];
+    size_t len;
+    int found;
+} FirstKey;
+
+static int take_first_key(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx)
+{
+    (void)value;
+    (void)value_len;
+    FirstKey* first = ctx;
+    memcpy(first->name, key, key_len);
+    first->len = key_len;
+    first->found = 1;
+    return 1;
+}
+
+// Hops from room to room: after each, the scan restarts past 'R' room '\1'
+static int paged_list_result_rooms(StorageNameFn fn, void* ctx)
+{
+    unsigned char from[PAGEDB_MAX_KEY] = { 'R' };
+    size_t from_len = 1;
+    while (1) {
+        FirstKey first;
+        first.found = 0;
+        if (pagedb_scan(db, from, from_len, take_first_key, &first) != 0)
+            return -1;
+        if (!first.found || first.name[0] != 'R')
+            return 0;
+        size_t room_len = bounded_len(first.name + 1, first.len - 1);
+        char room_id[PAGEDB_MAX_KEY];
+        memcpy(room_id, first.name + 1, room_len);
+        room_id[room_len] = '\0';
+        fn(room_id, ctx);
+        memcpy(from, first.name, room_len + 1);
+        from[room_len + 1] = 1;
+        from_len = room_len + 2;
+    }
+}
+
+// Snapshots: changed users and banks, the rooms and new results go into
+// one transaction, committed together with the lsn
+
+// A changed user or bank as the key it writes
+typedef struct
+{
+    unsigned char key[PAGEDB_MAX_KEY];
+    size_t key_len;
+    char* value; // NULL = delete the key
+    size_t value_len;
+} PagedChange;
+
+typedef struct
+{
+    uint64_t lsn;
+    Room* rooms;
+    int room_count;
+    RoomResult* results;
+    int result_count;
+    PagedChange* changes;
+    int change_count;
+} PagedSnapshotJob;
+
+static void free_changes(PagedSnapshotJob* job)
+{
+    for (int i = 0; i < job->change_count; i++)
+        free(job->changes[i].value);
+    free(job->changes);
+}
+
+// Takes ownership of value; a key that does not fit fails the snapshot
+static int add_change(PagedSnapshotJob* job, char tag, const char* name, size_t name_len, char* value,
+                      size_t value_len)
+{
+    PagedChange* c = &job->changes[job->change_count];
+    c->key_len = make_key(c->key, tag, name, name_len);
+    if (!c->key_len) {
+        free(value);
+        return -1;
+    }
+    c->value = value;
+    c->value_len = value_len;
+    job->change_count++;
+    return 0;
+}
+
+static int prepare_changes(PagedSnapshotJob* job, const StorageSnapshot* snapshot)
+{
+    job->changes = malloc((snapshot->user_count + snapshot->bank_count + 1) * sizeof(PagedChange));
+    if (!job->changes)
+        return -1;
+    for (int i = 0; i < snapshot->user_count; i++) {
+        const StorageUser* u = &snapshot->users[i];
+        size_t len = u->password_len + 1 + u->role_len;
+        char* value = malloc(len);
+        if (!value)
+            return -1;
+        memcpy(value, u->password, u->password_len);
+        value[u->password_len] = '\0';
+        memcpy(value + u->password_len + 1, u->role, u->role_len);
+        if (add_change(job, 'u', u->name, u->name_len, value, len) != 0)
+            return -1;
+    }
+    for (int i = 0; i < snapshot->bank_count; i++) {
+        const StorageBankChange* bank = &snapshot->banks[i];
+        char* value = bank->data ? malloc(bank->size) : NULL;
+        if (bank->data && !value)
+            return -1;
+        if (value)
+            memcpy(value, bank->data, bank->size);
+        if (add_change(job, 'b', bank->id, strlen(bank->id), value, bank->size) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void* paged_prepare_snapshot(const StorageSnapshot* snapshot)
+{
+    PagedSnapshotJob* job = calloc(1, sizeof(PagedSnapshotJob));
+    if (!job)
+        return NULL;
+    job->lsn = snapshot->lsn;
+    job->rooms = malloc((snapshot->room_count + 1) * sizeof(Room));
+    job->results = malloc((snapshot->result_count + 1) * sizeof(RoomResult));
+    if (!job->rooms || !job->results || prepare_changes(job, snapshot) != 0) {
+        free(job->rooms);
+        free(job->results);
+        free_changes(job);
+        free(job);
+        return NULL;
+    }
+    memcpy(job->rooms, snapshot->rooms, snapshot->room_count * sizeof(Room));
+    memcpy(job->results, snapshot->results, snapshot->result_count * sizeof(RoomResult));
+    job->room_count = snapshot->room_count;
+    job->result_count = snapshot->result_count;
+    return job;
+}
+
+typedef struct
+{
+    char (*ids)[sizeof(((Room*)0)->id)];
+    int count;
+    int cap;
+} RoomIds;
+
+static int collect_room_id(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx)
+{
+    (void)value;
+    (void)value_len;
+    RoomIds* ids = ctx;
+    if (((const char*)key)[0] != 'r')
+        return 1;
+    if (ids->count == ids->cap) {
+        int cap = ids->cap ? ids->cap * 2 : 64;
+        void* grown = realloc(ids->ids, cap * sizeof(*ids->ids));
+        if (!grown)
+            return 1;
+        ids->ids = grown;
+        ids->cap = cap;
+    }
+    size_t len = key_len - 1 < sizeof(*ids->ids) - 1 ? key_len - 1 : sizeof(*ids->ids) - 1;
+    memcpy(ids->ids[ids->count], (const char*)key + 1, len);
+    ids->ids[ids->count][len] = '\0';
+    ids->count++;
+    return 0;
+}
+
+static int compare_room_ids(const void* a, const void* b)
+{
+    return strcmp(((const Room*)a)->id, ((const Room*)b)->id);
+}
+
+static int write_rooms(const PagedSnapshotJob* job)
+{
+    for (int i = 0; i < job->room_count; i++) {
+        if (put_room(&job->rooms[i], (uint32_t)i) != 0)
+            return -1;
+    }
+
+    // Rooms stored but gone from memory were deleted
+    RoomIds stored = { NULL, 0, 0 };
+    Room* sorted = malloc((job->room_count + 1) * sizeof(Room));
+    int rc = sorted && pagedb_scan(db, "r", 1, collect_room_id, &stored) == 0 ? 0 : -1;
+    if (rc == 0) {
+        memcpy(sorted, job->rooms, job->room_count * sizeof(Room));
+        qsort(sorted, job->room_count, sizeof(Room), compare_room_ids);
+    }
+    for (int i = 0; i < stored.count && rc == 0; i++) {
+        Room probe;
+        snprintf(probe.id, sizeof(probe.id), "%s", stored.ids[i]);
+        if (bsearch(&probe, sorted, job->room_count, sizeof(Room), compare_room_ids))
+            continue;
+        unsigned char key[PAGEDB_MAX_KEY];
+        size_t key_len = make_key(key, 'r', probe.id, strlen(probe.id));
+        rc = pagedb_delete(db, key, key_len) < 0 ? -1 : 0;
+    }
+    free(stored.ids);
+    free(sorted);
+    return rc;
+}
+
+static int paged_write_snapshot(void* arg)
+{
+    PagedSnapshotJob* job = arg;
+    pagedb_begin(db);
+    int rc = 0;
+    for (int i = 0; i < job->change_count && rc == 0; i++) {
+        const PagedChange* c = &job->changes[i];
+        rc = c->value ? pagedb_put(db, c->key, c->key_len, c->value, c->value_len)
+                      : (pagedb_delete(db, c->key, c->key_len) < 0 ? -1 : 0);
+    }
+    rc = rc ? rc : write_rooms(job);
+    for (int i = 0; i < job->result_count && rc == 0;) {
+        int n = 1;
+        while (i + n < job->result_count && strcmp(job->results[i + n].room_id, job->results[i].room_id) == 0)
+            n++;
+        rc = append_results(&job->results[i], n);
+        i += n;
+    }
+    if (rc != 0) {
+        pagedb_rollback(db);
+        return -1;
+    }
+    return pagedb_commit(db, job->lsn);
+}
+
+static void paged_free_snapshot(void* arg)
+{
+    PagedSnapshotJob* job = arg;
+    if (!job)
+        return;
+    free(job->rooms);
+    free(job->results);
+    free_changes(job);
+    free(job);
+}
+
+// Question banks
+
+static int paged_load_bank(const char* bank_id, StorageBank* bank)
+{
+    unsigned char key[PAGEDB_MAX_KEY];
+    size_t key_len = make_key(key, 'b', bank_id, strlen(bank_id));
+    void* value = NULL;
+    size_t len = 0;
+    if (!key_len || pagedb_get(db, key, key_len, &value, &len) != 0)
+        return -1;
+    memset(bank, 0, sizeof(*bank));
+    bank->data = value;
+    bank->size = len;
+    bank->handle = value;
+    return 0;
+}
+
+static int paged_bank_exists(const char* bank_id)
+{
+    StorageBank bank;
+    if (paged_load_bank(bank_id, &bank) != 0)
+        return 0;
+    free(bank.handle);
+    return 1;
+}
+
+static void paged_release_bank(StorageBank* bank)
+{
+    free(bank->handle);
+}
+
+typedef struct
+{
+    StorageNameFn fn;
+    void* ctx;
+} NameScan;
+
+static int scan_bank(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx)
+{
+    (void)value;
+    (void)value_len;
+    NameScan* scan = ctx;
+    if (((const char*)key)[0] != 'b')
+        return 1;
+    char name[PAGEDB_MAX_KEY];
+    memcpy(name, (const char*)key + 1, key_len - 1);
+    name[key_len - 1] = '\0';
+    scan->fn(name, scan->ctx);
+    return 0;
+}
+
+static int paged_list_banks(StorageNameFn fn, void* ctx)
+{
+    NameScan scan = { fn, ctx };
+    return pagedb_scan(db, "b", 1, scan_bank, &scan);
+}
+
+// Import from the files engine, in the transaction that creates the database
+
+typedef struct
+{
+    const StorageEngine* files;
+    int rc;
+    int users;
+    int rooms;
+    long results;
+    int banks;
+    uint64_t row;
+} Import;
+
+static int import_users(const StorageUser* users, int count, int expected, void* ctx)
+{
+    (void)expected;
+    Import* import = ctx;
+    for (int i = 0; i < count && import->rc == 0; i++) {
+        const StorageUser* u = &users[i];
+        import->rc = put_user_value(u->name, u->name_len, u->password, u->password_len, u->role ? u->role : "",
+                                    u->role_len);
+        import->users++;
+    }
+    return import->rc;
+}
+
+static void import_room(const Room* room, void* ctx)
+{
+    Import* import = ctx;
+    if (import->rc == 0)
+        import->rc = put_room(room, (uint32_t)import->rooms++);
+}
+
+static void import_result(const RoomResult* result, void* ctx)
+{
+    Import* import = ctx;
+    if (import->rc != 0)
+        return;
+    StoredResult stored;
+    memset(&stored, 0, sizeof(stored));
+    stored.seq = result->seq;
+    stored.timestamp = result->timestamp;
+    stored.score = result->score;
+    snprintf(stored.username, sizeof(stored.username), "%s", result->username);
+    unsigned char key[PAGEDB_MAX_KEY];
+    size_t key_len = result_key(key, result->room_id, import->row++);
+    import->rc = pagedb_put(db, key, key_len, &stored, sizeof(stored));
+    import->results++;
+}
+
+static void import_result_room(const char* room_id, void* ctx)
+{
+    Import* import = ctx;
+    import->row = 0;
+    if (import->rc == 0 && strlen(room_id) < sizeof(((Room*)0)->id))
+        import->files->for_each_result(room_id, import_result, import);
+}
+
+static void import_bank(const char* bank_id, void* ctx)
+{
+    Import* import = ctx;
+    StorageBank bank;
+    if (import->rc != 0 || import->files->load_bank(bank_id, &bank) != 0)
+        return;
+    unsigned char key[PAGEDB_MAX_KEY];
+    size_t key_len = make_key(key, 'b', bank_id, strlen(bank_id));
+    import->rc = key_len ? pagedb_put(db, key, key_len, bank.data, bank.size) : -1;
+    import->files->release_bank(&bank);
+    import->banks++;
+}
+
+static int import_files(void)
+{
+    Import import;
+    memset(&import, 0, sizeof(import));
+    import.files = &storage_engine_files;
+    if (import.files->open() != 0)
+        return -1;
+
+    pagedb_begin(db);
+    // Missing files just mean nothing to import
+    import.files->load_users(import_users, &import);
+    import.files->load_rooms(import_room, &import);
+    import.files->list_result_rooms(import_result_room, &import);
+    import.files->list_banks(import_bank, &import);
+    uint64_t lsn = import.files->checkpoint_lsn();
+    import.files->close();
+    if (import.rc != 0) {
+        pagedb_rollback(db);
+        return -1;
+    }
+    if (pagedb_commit(db, lsn) != 0)
+        return -1;
+    printf("Imported %d users, %d rooms, %ld results and %d question banks into %s.\n", import.users,
+           import.rooms, import.results, import.banks, DB_FILE);
+    return 0;
+}
+
+static int paged_open(void)
+{
+    mkdir("data", 0777);
+    struct stat st;
+    int fresh = stat(DB_FILE, &st) != 0 || st.st_size == 0;
+    db = pagedb_open(DB_FILE, (int)config_get_long("QUIZZIE_PAGE_CACHE_PAGES", DEFAULT_CACHE_PAGES));
+    if (!db)
+        return -1;
+    if (fresh && import_files() != 0) {
+        fprintf(stderr, "Could not import the data files into %s\n", DB_FILE);
+        pagedb_close(db);
+        db = NULL;
+        unlink(DB_FILE);
+        return -1;
+    }
+    return 0;
+}
+
+static void paged_close(void)
+{
+    pagedb_close(db);
+    db = NULL;
+}
+
+static uint64_t paged_checkpoint_lsn(void)
+{
+    return pagedb_user_lsn(db);
+}
+
+static cJSON* paged_stats_to_json(void)
+{
+    PageDbStats st;
+    pagedb_get_stats(db, &st);
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "pages", st.pages);
+    cJSON_AddNumberToObject(obj, "free_pages", st.free_pages);
+    cJSON_AddNumberToObject(obj, "cache_pages", st.cache_pages);
+    cJSON_AddNumberToObject(obj, "cache_hits", (double)st.hits);
+    cJSON_AddNumberToObject(obj, "page_reads", (double)st.reads);
+    cJSON_AddNumberToObject(obj, "page_writes", (double)st.writes);
+    cJSON_AddNumberToObject(obj, "commits", (double)st.commits);
+    cJSON_AddNumberToObject(obj, "txn", (double)st.txn);
+    return obj;
+}
+
+const StorageEngine storage_engine_paged = {
+    .name = "paged",
+    .open = paged_open,
+    .close = paged_close,
+    .checkpoint_lsn = paged_checkpoint_lsn,
+    .load_users = paged_load_users,
+    .load_rooms = paged_load_rooms,
+    .for_each_result = paged_for_each_result,
+    .list_result_rooms = paged_list_result_rooms,
+    .prepare_snapshot = paged_prepare_snapshot,
+    .write_snapshot = paged_write_snapshot,
+    .free_snapshot = paged_free_snapshot,
+    .load_bank = paged_load_bank,
+    .bank_exists = paged_bank_exists,
+    .release_bank = paged_release_bank,
+    .bank_is_current = NULL,
+    .list_banks = paged_list_banks,
+    .stats_to_json = paged_stats_to_json,
+};
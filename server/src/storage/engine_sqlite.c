@@ -0,0 +1,730 @@
+#ifdef QUIZZIE_SQLITE
+
+#include "storage_engine.h"
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The SQLite engine, built with `make SQLITE=1`: everything in data/quizzie.sqlite
+// in WAL mode, so the event loop keeps reading while the snapshot thread
+// writes. Each thread has its own connection with its statements prepared
+// once and reused. The loop connection only reads: a snapshot's changed users
+// and banks, rooms and results go in one transaction on the writer that also
+// records the lsn. Results are indexed by room and by username. A new database starts as a copy of
+// whatever the files engine holds; the files are left alone afterwards.
+
+#define DB_FILE "data/quizzie.sqlite"
+#define BUSY_TIMEOUT_MS 5000
+
+enum
+{
+    STMT_BEGIN,
+    STMT_COMMIT,
+    STMT_ROLLBACK,
+    STMT_GET_LSN,
+    STMT_SET_LSN,
+    STMT_LOAD_USERS,
+    STMT_PUT_USER,
+    STMT_LOAD_ROOMS,
+    STMT_CLEAR_ROOMS,
+    STMT_PUT_ROOM,
+    STMT_ROOM_RESULTS,
+    STMT_LAST_SEQ,
+    STMT_PUT_RESULT,
+    STMT_RESULT_ROOMS,
+    STMT_GET_BANK,
+    STMT_HAS_BANK,
+    STMT_PUT_BANK,
+    STMT_DELETE_BANK,
+    STMT_LIST_BANKS,
+    STMT_COUNT
+};
+
+static const char* const statement_sql[STMT_COUNT] = {
+    [STMT_BEGIN] = "BEGIN IMMEDIATE",
+    [STMT_COMMIT] = "COMMIT",
+    [STMT_ROLLBACK] = "ROLLBACK",
+    [STMT_GET_LSN] = "SELECT value FROM meta WHERE key = 'checkpoint_lsn'",
+    [STMT_SET_LSN] = "INSERT OR REPLACE INTO meta (key, value) VALUES ('checkpoint_lsn', ?1)",
+    [STMT_LOAD_USERS] = "SELECT name, password, role FROM users",
+    [STMT_PUT_USER] = "INSERT OR REPLACE INTO users (name, password, role) VALUES (?1, ?2, ?3)",
+    [STMT_LOAD_ROOMS] = "SELECT id, name, start_time, end_time, question_bank_id, status, num_questions,"
+                        " allowed_attempts FROM rooms ORDER BY pos",
+    [STMT_CLEAR_ROOMS] = "DELETE FROM rooms",
+    [STMT_PUT_ROOM] = "INSERT INTO rooms (id, pos, name, start_time, end_time, question_bank_id, status,"
+                      " num_questions, allowed_attempts) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9)",
+    [STMT_ROOM_RESULTS] = "SELECT username, score, timestamp, seq FROM results WHERE room_id = ?1 ORDER BY id",
+    [STMT_LAST_SEQ] = "SELECT seq FROM results WHERE room_id = ?1 ORDER BY id DESC LIMIT 1",
+    [STMT_PUT_RESULT] = "INSERT INTO results (room_id, username, score, timestamp, seq) VALUES (?1, ?2, ?3, ?4, ?5)",
+    [STMT_RESULT_ROOMS] = "SELECT DISTINCT room_id FROM results",
+    [STMT_GET_BANK] = "SELECT data FROM banks WHERE id = ?1",
+    [STMT_HAS_BANK] = "SELECT 1 FROM banks WHERE id = ?1",
+    [STMT_PUT_BANK] = "INSERT OR REPLACE INTO banks (id, data) VALUES (?1, ?2)",
+    [STMT_DELETE_BANK] = "DELETE FROM banks WHERE id = ?1",
+    [STMT_LIST_BANKS] = "SELECT id FROM banks ORDER BY id",
+};
+
+static const char SCHEMA[] = "CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value INTEGER NOT NULL);"
+                             "CREATE TABLE IF NOT EXISTS users (name TEXT PRIMARY KEY, password TEXT NOT NULL,"
+                             " role TEXT);"
+                             "CREATE TABLE IF NOT EXISTS rooms (id TEXT PRIMARY KEY, pos INTEGER NOT NULL,"
+                             " name TEXT, start_time INTEGER, end_time INTEGER, question_bank_id TEXT,"
+                             " status TEXT, num_questions INTEGER, allowed_attempts INTEGER);"
+                             "CREATE TABLE IF NOT EXISTS results (id INTEGER PRIMARY KEY, room_id TEXT NOT NULL,"
+                             " username TEXT NOT NULL, score INTEGER, timestamp INTEGER, seq INTEGER NOT NULL);"
+                             "CREATE INDEX IF NOT EXISTS results_by_room ON results (room_id);"
+                             "CREATE INDEX IF NOT EXISTS results_by_username ON results (username);"
+                             "CREATE TABLE IF NOT EXISTS banks (id TEXT PRIMARY KEY, data BLOB NOT NULL);";
+
+typedef struct
+{
+    sqlite3* db;
+    sqlite3_stmt* stmts[STMT_COUNT];
+    unsigned long long commits;
+} Connection;
+
+// loop: reads, and the import at open; writer: the snapshot thread
+static Connection loop;
+static Connection writer;
+
+static void report(const Connection* conn, const char* what)
+{
+    fprintf(stderr, "sqlite: %s: %s\n", what, sqlite3_errmsg(conn->db));
+}
+
+// The cached statement, prepared on first use; NULL on error
+static sqlite3_stmt* statement(Connection* conn, int id)
+{
+    if (!conn->stmts[id]
+        && sqlite3_prepare_v3(conn->db, statement_sql[id], -1, SQLITE_PREPARE_PERSISTENT, &conn->stmts[id], NULL)
+               != SQLITE_OK) {
+        report(conn, statement_sql[id]);
+        return NULL;
+    }
+    return conn->stmts[id];
+}
+
+// Resets a statement after use so it does not hold the read snapshot open
+static int finish(sqlite3_stmt* stmt, int rc)
+{
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return rc;
+}
+
+// Runs a statement that returns no rows. 0 on success.
+static int run(Connection* conn, int id)
+{
+    sqlite3_stmt* stmt = statement(conn, id);
+    if (!stmt)
+        return -1;
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        report(conn, statement_sql[id]);
+        return finish(stmt, -1);
+    }
+    return finish(stmt, 0);
+}
+
+static int begin(Connection* conn)
+{
+    return run(conn, STMT_BEGIN);
+}
+
+static int commit(Connection* conn, int rc)
+{
+    if (rc == 0 && run(conn, STMT_COMMIT) == 0) {
+        conn->commits++;
+        return 0;
+    }
+    run(conn, STMT_ROLLBACK);
+    return -1;
+}
+
+static void bind_text(sqlite3_stmt* stmt, int index, const char* text, size_t max)
+{
+    const char* end = memchr(text, '\0', max);
+    sqlite3_bind_text(stmt, index, text, end ? (int)(end - text) : (int)max, SQLITE_STATIC);
+}
+
+static void column_text(sqlite3_stmt* stmt, int col, char* out, size_t size)
+{
+    const unsigned char* text = sqlite3_column_text(stmt, col);
+    snprintf(out, size, "%s", text ? (const char*)text : "");
+}
+
+static int connection_open(Connection* conn)
+{
+    memset(conn, 0, sizeof(*conn));
+    if (sqlite3_open_v2(DB_FILE, &conn->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX,
+                        NULL)
+        != SQLITE_OK) {
+        report(conn, "open " DB_FILE);
+        sqlite3_close(conn->db);
+        conn->db = NULL;
+        return -1;
+    }
+    sqlite3_busy_timeout(conn->db, BUSY_TIMEOUT_MS);
+    // A snapshot lets the journal be truncated, so its commit must survive power loss
+    if (sqlite3_exec(conn->db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=FULL;", NULL, NULL, NULL) != SQLITE_OK) {
+        report(conn, "configure");
+        return -1;
+    }
+    return 0;
+}
+
+static void connection_close(Connection* conn)
+{
+    for (int i = 0; i < STMT_COUNT; i++)
+        sqlite3_finalize(conn->stmts[i]);
+    sqlite3_close(conn->db);
+    memset(conn, 0, sizeof(*conn));
+}
+
+// Users
+
+static int sqlite_load_users(StorageUserFn fn, void* ctx)
+{
+    sqlite3_stmt* stmt = statement(&loop, STMT_LOAD_USERS);
+    if (!stmt)
+        return -1;
+
+    // Column text stays valid only until the next step, so each batch is copied out
+    StorageUser batch[STORAGE_USER_BATCH];
+    static char text[STORAGE_USER_BATCH][3][192];
+    int count = 0;
+    int rc = 0;
+    int step;
+    while (rc == 0 && (step = sqlite3_step(stmt)) == SQLITE_ROW) {
+        StorageUser* user = &batch[count];
+        const char* fields[3];
+        size_t lens[3];
+        for (int col = 0; col < 3; col++) {
+            const unsigned char* value = sqlite3_column_text(stmt, col);
+            size_t len = value ? (size_t)sqlite3_column_bytes(stmt, col) : 0;
+            if (len >= sizeof(text[count][col]))
+                len = sizeof(text[count][col]) - 1;
+            memcpy(text[count][col], value ? (const char*)value : "", len);
+            text[count][col][len] = '\0';
+            fields[col] = value ? text[count][col] : NULL;
+            lens[col] = len;
+        }
+        if (!fields[0] || !fields[1])
+            continue;
+        user->name = fields[0];
+        user->name_len = lens[0];
+        user->password = fields[1];
+        user->password_len = lens[1];
+        user->role = fields[2] && lens[2] ? fields[2] : NULL;
+        user->role_len = user->role ? lens[2] : 0;
+        if (++count == STORAGE_USER_BATCH) {
+            rc = fn(batch, count, 0, ctx);
+            count = 0;
+        }
+    }
+    if (rc == 0 && step != SQLITE_DONE) {
+        report(&loop, "load users");
+        rc = -1;
+    }
+    if (rc == 0 && count)
+        rc = fn(batch, count, 0, ctx);
+    return finish(stmt, rc);
+}
+
+static int put_user(Connection* conn, const StorageUser* user)
+{
+    sqlite3_stmt* stmt = statement(conn, STMT_PUT_USER);
+    if (!stmt)
+        return -1;
+    sqlite3_bind_text(stmt, 1, user->name, (int)user->name_len, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, user->password, (int)user->password_len, SQLITE_STATIC);
+    if (user->role)
+        sqlite3_bind_text(stmt, 3, user->role, (int)user->role_len, SQLITE_STATIC);
+    return finish(stmt, sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1);
+}
+
+// Rooms
+
+static int sqlite_load_rooms(StorageRoomFn fn, void* ctx)
+{
+    sqlite3_stmt* stmt = statement(&loop, STMT_LOAD_ROOMS);
+    if (!stmt)
+        return -1;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Room room;
+        memset(&room, 0, sizeof(room));
+        column_text(stmt, 0, room.id, sizeof(room.id));
+        column_text(stmt, 1, room.name, sizeof(room.name));
+        room.start_time = (long)sqlite3_column_int64(stmt, 2);
+        room.end_time = (long)sqlite3_column_int64(stmt, 3);
+        column_text(stmt, 4, room.question_bank_id, sizeof(room.question_bank_id));
+        column_text(stmt, 5, room.status, sizeof(room.status));
+        room.num_questions = sqlite3_column_int(stmt, 6);
+        room.allowed_attempts = sqlite3_column_int(stmt, 7);
+        fn(&room, ctx);
+    }
+    return finish(stmt, 0);
+}
+
+static int put_room(Connection* conn, const Room* room, int pos)
+{
+    sqlite3_stmt* stmt = statement(conn, STMT_PUT_ROOM);
+    if (!stmt)
+        return -1;
+    bind_text(stmt, 1, room->id, sizeof(room->id));
+    sqlite3_bind_int(stmt, 2, pos);
+    bind_text(stmt, 3, room->name, sizeof(room->name));
+    sqlite3_bind_int64(stmt, 4, room->start_time);
+    sqlite3_bind_int64(stmt, 5, room->end_time);
+    bind_text(stmt, 6, room->question_bank_id, sizeof(room->question_bank_id));
+    bind_text(stmt, 7, room->status, sizeof(room->status));
+    sqlite3_bind_int(stmt, 8, room->num_questions);
+    sqlite3_bind_int(stmt, 9, room->allowed_attempts);
+    return finish(stmt, sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1);
+}
+
+// Results
+
+static long sqlite_for_each_result(const char* room_id, StorageResultFn fn, void* ctx)
+{
+    sqlite3_stmt* stmt = statement(&loop, STMT_ROOM_RESULTS);
+    if (!stmt)
+        return 0;
+    RoomResult result;
+    memset(&result, 0, sizeof(result));
+    snprintf(result.room_id, sizeof(result.room_id), "%s", room_id);
+    long stored_seq = 0;
+    bind_text(stmt, 1, room_id, sizeof(result.room_id));
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        column_text(stmt, 0, result.username, sizeof(result.username));
+        result.score = sqlite3_column_int(stmt, 1);
+        result.timestamp = (long)sqlite3_column_int64(stmt, 2);
+        result.seq = (long)sqlite3_column_int64(stmt, 3);
+        if (result.seq > stored_seq)
+            stored_seq = result.seq;
+        fn(&result, ctx);
+    }
+    finish(stmt, 0);
+    return stored_seq;
+}
+
+static int put_result(Connection* conn, const RoomResult* result)
+{
+    sqlite3_stmt* stmt = statement(conn, STMT_PUT_RESULT);
+    if (!stmt)
+        return -1;
+    bind_text(stmt, 1, result->room_id, sizeof(result->room_id));
+    bind_text(stmt, 2, result->username, sizeof(result->username));
+    sqlite3_bind_int(stmt, 3, result->score);
+    sqlite3_bind_int64(stmt, 4, result->timestamp);
+    sqlite3_bind_int64(stmt, 5, result->seq);
+    return finish(stmt, sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1);
+}
+
+// Appends the results past the room's last stored seq; results are one room's, in seq order
+static int append_results(const RoomResult* results, int count)
+{
+    sqlite3_stmt* stmt = statement(&writer, STMT_LAST_SEQ);
+    if (!stmt)
+        return -1;
+    bind_text(stmt, 1, results[0].room_id, sizeof(results[0].room_id));
+    long stored_seq = sqlite3_step(stmt) == SQLITE_ROW ? (long)sqlite3_column_int64(stmt, 0) : 0;
+    finish(stmt, 0);
+    for (int i = 0; i < count; i++) {
+        if (results[i].seq > stored_seq && put_result(&writer, &results[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int sqlite_list_result_rooms(StorageNameFn fn, void* ctx)
+{
+    sqlite3_stmt* stmt = statement(&loop, STMT_RESULT_ROOMS);
+    if (!stmt)
+        return -1;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        char room_id[sizeof(((Room*)0)->id)];
+        column_text(stmt, 0, room_id, sizeof(room_id));
+        fn(room_id, ctx);
+    }
+    return finish(stmt, 0);
+}
+
+// Question banks
+
+static int put_bank(Connection* conn, const char* bank_id, const void* data, size_t size)
+{
+    sqlite3_stmt* stmt = statement(conn, STMT_PUT_BANK);
+    if (!stmt)
+        return -1;
+    sqlite3_bind_text(stmt, 1, bank_id, -1, SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, 2, data, (int)size, SQLITE_STATIC);
+    return finish(stmt, sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1);
+}
+
+static int delete_bank(Connection* conn, const char* bank_id)
+{
+    sqlite3_stmt* stmt = statement(conn, STMT_DELETE_BANK);
+    if (!stmt)
+        return -1;
+    sqlite3_bind_text(stmt, 1, bank_id, -1, SQLITE_STATIC);
+    return finish(stmt, sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1);
+}
+
+// Snapshots
+
+typedef struct
+{
+    char* id;
+    void* data; // NULL = deleted
+    size_t size;
+} SqliteBankChange;
+
+typedef struct
+{
+    uint64_t lsn;
+    Room* rooms;
+    int room_count;
+    RoomResult* results;
+    int result_count;
+    StorageUser* users; // strings in user_text
+    int user_count;
+    char* user_text;
+    SqliteBankChange* banks;
+    int bank_count;
+} SqliteSnapshotJob;
+
+static void sqlite_free_snapshot(void* arg);
+
+static int copy_users(SqliteSnapshotJob* job, const StorageSnapshot* snapshot)
+{
+    size_t len = 0;
+    for (int i = 0; i < snapshot->user_count; i++)
+        len += snapshot->users[i].name_len + snapshot->users[i].password_len + snapshot->users[i].role_len;
+    job->users = malloc((snapshot->user_count + 1) * sizeof(StorageUser));
+    job->user_text = malloc(len + 1);
+    if (!job->users || !job->user_text)
+        return -1;
+    char* p = job->user_text;
+    for (int i = 0; i < snapshot->user_count; i++) {
+        const StorageUser* u = &snapshot->users[i];
+        StorageUser* copy = &job->users[i];
+        *copy = *u;
+        copy->name = memcpy(p, u->name, u->name_len);
+        p += u->name_len;
+        copy->password = memcpy(p, u->password, u->password_len);
+        p += u->password_len;
+        copy->role = u->role ? memcpy(p, u->role, u->role_len) : NULL;
+        p += u->role ? u->role_len : 0;
+    }
+    job->user_count = snapshot->user_count;
+    return 0;
+}
+
+static int copy_banks(SqliteSnapshotJob* job, const StorageSnapshot* snapshot)
+{
+    job->banks = calloc(snapshot->bank_count + 1, sizeof(SqliteBankChange));
+    if (!job->banks)
+        return -1;
+    for (int i = 0; i < snapshot->bank_count; i++) {
+        const StorageBankChange* bank = &snapshot->banks[i];
+        SqliteBankChange* copy = &job->banks[job->bank_count++];
+        copy->id = strdup(bank->id);
+        copy->data = bank->data ? malloc(bank->size) : NULL;
+        copy->size = bank->size;
+        if (!copy->id || (bank->data && !copy->data))
+            return -1;
+        if (copy->data)
+            memcpy(copy->data, bank->data, bank->size);
+    }
+    return 0;
+}
+
+static void* sqlite_prepare_snapshot(const StorageSnapshot* snapshot)
+{
+    SqliteSnapshotJob* job = calloc(1, sizeof(SqliteSnapshotJob));
+    if (!job)
+        return NULL;
+    job->lsn = snapshot->lsn;
+    job->rooms = malloc((snapshot->room_count + 1) * sizeof(Room));
+    job->results = malloc((snapshot->result_count + 1) * sizeof(RoomResult));
+    if (!job->rooms || !job->results || copy_users(job, snapshot) != 0 || copy_banks(job, snapshot) != 0) {
+        sqlite_free_snapshot(job);
+        return NULL;
+    }
+    memcpy(job->rooms, snapshot->rooms, snapshot->room_count * sizeof(Room));
+    memcpy(job->results, snapshot->results, snapshot->result_count * sizeof(RoomResult));
+    job->room_count = snapshot->room_count;
+    job->result_count = snapshot->result_count;
+    return job;
+}
+
+static int set_lsn(Connection* conn, uint64_t lsn)
+{
+    sqlite3_stmt* stmt = statement(conn, STMT_SET_LSN);
+    if (!stmt)
+        return -1;
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)lsn);
+    return finish(stmt, sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1);
+}
+
+// The room table is small, so it is rewritten whole rather than diffed
+static int sqlite_write_snapshot(void* arg)
+{
+    SqliteSnapshotJob* job = arg;
+    if (begin(&writer) != 0)
+        return -1;
+    int rc = 0;
+    for (int i = 0; i < job->user_count && rc == 0; i++)
+        rc = put_user(&writer, &job->users[i]);
+    for (int i = 0; i < job->bank_count && rc == 0; i++) {
+        const SqliteBankChange* bank = &job->banks[i];
+        rc = bank->data ? put_bank(&writer, bank->id, bank->data, bank->size) : delete_bank(&writer, bank->id);
+    }
+    rc = rc ? rc : run(&writer, STMT_CLEAR_ROOMS);
+    for (int i = 0; i < job->room_count && rc == 0; i++)
+        rc = put_room(&writer, &job->rooms[i], i);
+    for (int i = 0; i < job->result_count && rc == 0;) {
+        int n = 1;
+        while (i + n < job->result_count && strcmp(job->results[i + n].room_id, job->results[i].room_id) == 0)
+            n++;
+        rc = append_results(&job->results[i], n);
+        i += n;
+    }
+    if (rc == 0)
+        rc = set_lsn(&writer, job->lsn);
+    if (rc != 0)
+        report(&writer, "write snapshot");
+    return commit(&writer, rc);
+}
+
+static void sqlite_free_snapshot(void* arg)
+{
+    SqliteSnapshotJob* job = arg;
+    if (!job)
+        return;
+    free(job->rooms);
+    free(job->results);
+    free(job->users);
+    free(job->user_text);
+    for (int i = 0; i < job->bank_count; i++) {
+        free(job->banks[i].id);
+        free(job->banks[i].data);
+    }
+    free(job->banks);
+    free(job);
+}
+
+// Question banks are read on the loop connection
+
+static int sqlite_load_bank(const char* bank_id, StorageBank* bank)
+{
+    sqlite3_stmt* stmt = statement(&loop, STMT_GET_BANK);
+    if (!stmt)
+        return -1;
+    sqlite3_bind_text(stmt, 1, bank_id, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) != SQLITE_ROW)
+        return finish(stmt, -1);
+    size_t size = (size_t)sqlite3_column_bytes(stmt, 0);
+    void* data = malloc(size + 1);
+    if (!data)
+        return finish(stmt, -1);
+    memcpy(data, sqlite3_column_blob(stmt, 0), size);
+    memset(bank, 0, sizeof(*bank));
+    bank->data = data;
+    bank->size = size;
+    bank->handle = data;
+    return finish(stmt, 0);
+}
+
+static int sqlite_bank_exists(const char* bank_id)
+{
+    sqlite3_stmt* stmt = statement(&loop, STMT_HAS_BANK);
+    if (!stmt)
+        return 0;
+    sqlite3_bind_text(stmt, 1, bank_id, -1, SQLITE_STATIC);
+    return finish(stmt, sqlite3_step(stmt) == SQLITE_ROW);
+}
+
+static void sqlite_release_bank(StorageBank* bank)
+{
+    free(bank->handle);
+}
+
+static int sqlite_list_banks(StorageNameFn fn, void* ctx)
+{
+    sqlite3_stmt* stmt = statement(&loop, STMT_LIST_BANKS);
+    if (!stmt)
+        return -1;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        fn((const char*)sqlite3_column_text(stmt, 0), ctx);
+    return finish(stmt, 0);
+}
+
+// Import from the files engine, in the transaction that creates the schema
+
+typedef struct
+{
+    const StorageEngine* files;
+    int rc;
+    int users;
+    int rooms;
+    long results;
+    int banks;
+} Import;
+
+static int import_users(const StorageUser* users, int count, int expected, void* ctx)
+{
+    (void)expected;
+    Import* import = ctx;
+    for (int i = 0; i < count && import->rc == 0; i++) {
+        import->rc = put_user(&loop, &users[i]);
+        import->users++;
+    }
+    return import->rc;
+}
+
+static void import_room(const Room* room, void* ctx)
+{
+    Import* import = ctx;
+    if (import->rc == 0)
+        import->rc = put_room(&loop, room, import->rooms++);
+}
+
+static void import_result(const RoomResult* result, void* ctx)
+{
+    Import* import = ctx;
+    if (import->rc == 0)
+        import->rc = put_result(&loop, result);
+    import->results++;
+}
+
+static void import_result_room(const char* room_id, void* ctx)
+{
+    Import* import = ctx;
+    if (import->rc == 0 && strlen(room_id) < sizeof(((Room*)0)->id))
+        import->files->for_each_result(room_id, import_result, import);
+}
+
+static void import_bank(const char* bank_id, void* ctx)
+{
+    Import* import = ctx;
+    StorageBank bank;
+    if (import->rc != 0 || import->files->load_bank(bank_id, &bank) != 0)
+        return;
+    import->rc = put_bank(&loop, bank_id, bank.data, bank.size);
+    import->files->release_bank(&bank);
+    import->banks++;
+}
+
+static int import_files(void)
+{
+    Import import;
+    memset(&import, 0, sizeof(import));
+    import.files = &storage_engine_files;
+    if (import.files->open() != 0)
+        return -1;
+
+    int rc = begin(&loop);
+    if (rc == 0) {
+        // Missing files just mean nothing to import
+        import.files->load_users(import_users, &import);
+        import.files->load_rooms(import_room, &import);
+        import.files->list_result_rooms(import_result_room, &import);
+        import.files->list_banks(import_bank, &import);
+        rc = import.rc == 0 ? set_lsn(&loop, import.files->checkpoint_lsn()) : -1;
+        rc = commit(&loop, rc);
+    }
+    import.files->close();
+    if (rc != 0)
+        return -1;
+    printf("Imported %d users, %d rooms, %ld results and %d question banks into %s.\n", import.users,
+           import.rooms, import.results, import.banks, DB_FILE);
+    return 0;
+}
+
+static void sqlite_close(void)
+{
+    connection_close(&writer);
+    connection_close(&loop);
+}
+
+static int sqlite_open(void)
+{
+    mkdir("data", 0777);
+    struct stat st;
+    int fresh = stat(DB_FILE, &st) != 0 || st.st_size == 0;
+    if (connection_open(&loop) != 0)
+        goto fail;
+    if (sqlite3_exec(loop.db, SCHEMA, NULL, NULL, NULL) != SQLITE_OK) {
+        report(&loop, "create schema");
+        goto fail;
+    }
+    if (connection_open(&writer) != 0)
+        goto fail;
+    if (fresh && import_files() != 0) {
+        fprintf(stderr, "Could not import the data files into %s\n", DB_FILE);
+        sqlite_close();
+        unlink(DB_FILE);
+        return -1;
+    }
+    return 0;
+
+fail:
+    sqlite_close();
+    return -1;
+}
+
+static uint64_t sqlite_checkpoint_lsn(void)
+{
+    sqlite3_stmt* stmt = statement(&loop, STMT_GET_LSN);
+    if (!stmt)
+        return 0;
+    uint64_t lsn = sqlite3_step(stmt) == SQLITE_ROW ? (uint64_t)sqlite3_column_int64(stmt, 0) : 0;
+    finish(stmt, 0);
+    return lsn;
+}
+
+static cJSON* sqlite_stats_to_json(void)
+{
+    int hits = 0, misses = 0, cache_bytes = 0, high = 0;
+    sqlite3_db_status(loop.db, SQLITE_DBSTATUS_CACHE_HIT, &hits, &high, 0);
+    sqlite3_db_status(loop.db, SQLITE_DBSTATUS_CACHE_MISS, &misses, &high, 0);
+    sqlite3_db_status(loop.db, SQLITE_DBSTATUS_CACHE_USED, &cache_bytes, &high, 0);
+    int statements = 0;
+    for (int i = 0; i < STMT_COUNT; i++)
+        statements += (loop.stmts[i] != NULL) + (writer.stmts[i] != NULL);
+
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "sqlite_version", sqlite3_libversion());
+    cJSON_AddNumberToObject(obj, "cache_hits", hits);
+    cJSON_AddNumberToObject(obj, "cache_misses", misses);
+    cJSON_AddNumberToObject(obj, "cache_bytes", cache_bytes);
+    cJSON_AddNumberToObject(obj, "prepared_statements", statements);
+    cJSON_AddNumberToObject(obj, "commits", (double)(loop.commits + writer.commits));
+    return obj;
+}
+
+const StorageEngine storage_engine_sqlite = {
+    .name = "sqlite",
+    .open = sqlite_open,
+    .close = sqlite_close,
+    .checkpoint_lsn = sqlite_checkpoint_lsn,
+    .load_users = sqlite_load_users,
+    .load_rooms = sqlite_load_rooms,
+    .for_each_result = sqlite_for_each_result,
+    .list_result_rooms = sqlite_list_result_rooms,
+    .prepare_snapshot = sqlite_prepare_snapshot,
+    .write_snapshot = sqlite_write_snapshot,
+    .free_snapshot = sqlite_free_snapshot,
+    .load_bank = sqlite_load_bank,
+    .bank_exists = sqlite_bank_exists,
+    .release_bank = sqlite_release_bank,
+    .bank_is_current = NULL,
+    .list_banks = sqlite_list_banks,
+    .stats_to_json = sqlite_stats_to_json,
+};
+
+#endif
@@ -0,0 +1,373 @@
+#include "journal.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Anything larger is treated as corruption during replay
+#define MAX_RECORD_PAYLOAD (1024 * 1024)
+
+static int journal_fd = -1;
+static char journal_path[256];
+static JournalFsyncPolicy fsync_policy = JOURNAL_FSYNC_GROUP;
+static long fsync_interval_ms = 1000;
+static uint64_t next_lsn = 1;
+static size_t journal_bytes = 0; // in the file, excluding the batch
+static uint64_t durable_lsn = 0;
+static int unsynced = 0; // records appended since the last fsync
+static uint64_t unsynced_since_us = 0;
+static JournalStats stats;
+
+// Group policy: records wait here and go out in a single write before the fsync
+static char* batch;
+static size_t batch_len = 0;
+static size_t batch_cap = 0;
+static long group_window_us = 1000;
+static int group_max_records = 256;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t journal_crc32(uint32_t crc, const void* data, size_t len)
+{
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+
+    const unsigned char* p = data;
+    crc = ~crc;
+    while (len--)
+        crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t record_crc(const JournalRecordHeader* header, const char* payload)
+{
+    uint32_t crc = journal_crc32(0, &header->lsn, sizeof(header->lsn));
+    crc = journal_crc32(crc, &header->type, sizeof(header->type));
+    return journal_crc32(crc, payload, header->length);
+}
+
+int journal_open(const char* path, JournalFsyncPolicy policy, long interval_ms)
+{
+    journal_close();
+    snprintf(journal_path, sizeof(journal_path), "%s", path);
+    fsync_policy = policy;
+    if (interval_ms > 0)
+        fsync_interval_ms = interval_ms;
+
+    journal_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (journal_fd < 0)
+        return -1;
+    struct stat st;
+    journal_bytes = fstat(journal_fd, &st) == 0 ? (size_t)st.st_size : 0;
+    durable_lsn = next_lsn - 1;
+    return 0;
+}
+
+void journal_set_group_commit(long window_us, int max_records)
+{
+    if (window_us >= 0)
+        group_window_us = window_us;
+    if (max_records > 0)
+        group_max_records = max_records;
+}
+
+void journal_close(void)
+{
+    if (journal_fd < 0)
+        return;
+    journal_sync();
+    close(journal_fd);
+    journal_fd = -1;
+    free(batch);
+    batch = NULL;
+    batch_len = batch_cap = 0;
+}
+
+static int buffer_record(const JournalRecordHeader* header, const char* payload)
+{
+    size_t need = batch_len + sizeof(*header) + header->length;
+    if (need > batch_cap) {
+        size_t cap = batch_cap ? batch_cap : 64 * 1024;
+        while (cap < need)
+            cap *= 2;
+        char* grown = realloc(batch, cap);
+        if (!grown)
+            return -1;
+        batch = grown;
+        batch_cap = cap;
+    }
+    memcpy(batch + batch_len, header, sizeof(*header));
+    memcpy(batch + batch_len + sizeof(*header), payload, header->length);
+    batch_len = need;
+    return 0;
+}
+
+// Writes the batch in one go; on failure the file is cut back and the batch kept for a retry
+static int write_batch(void)
+{
+    size_t done = 0;
+    while (done < batch_len) {
+        ssize_t n = write(journal_fd, batch + done, batch_len - done);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (done > 0 && ftruncate(journal_fd, journal_bytes) != 0)
+                perror("journal truncate");
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    stats.writes++;
+    journal_bytes += batch_len;
+    batch_len = 0;
+    return 0;
+}
+
+static void note_appended(size_t bytes)
+{
+    stats.appends++;
+    stats.bytes += bytes;
+    if (!unsynced)
+        unsynced_since_us = now_us();
+    unsynced++;
+}
+
+uint64_t journal_append(int type, const char* payload, size_t len)
+{
+    if (journal_fd < 0 || len > MAX_RECORD_PAYLOAD)
+        return 0;
+
+    uint64_t span = trace_span_begin();
+    JournalRecordHeader header;
+    header.length = (uint32_t)len;
+    header.lsn = next_lsn;
+    header.type = (uint8_t)type;
+    header.crc = record_crc(&header, payload);
+    size_t total = sizeof(header) + len;
+
+    if (fsync_policy == JOURNAL_FSYNC_GROUP) {
+        if (buffer_record(&header, payload) != 0) {
+            trace_span_end("storage.journal", span);
+            return 0;
+        }
+        uint64_t lsn = next_lsn++;
+        note_appended(total);
+        trace_span_end("storage.journal", span);
+        // A full batch commits now; if that fails the records stay queued for the next try
+        if (unsynced >= group_max_records && journal_sync() != 0)
+            perror("journal commit");
+        return lsn;
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (void*)payload;
+    iov[1].iov_len = len;
+
+    ssize_t n = writev(journal_fd, iov, 2);
+    if (n != (ssize_t)total) {
+        // Drop a partial record so the next append does not land behind garbage
+        if (n > 0 && ftruncate(journal_fd, journal_bytes) != 0)
+            perror("journal truncate");
+        trace_span_end("storage.journal", span);
+        return 0;
+    }
+
+    // The record is in the file now and replays with this lsn whatever happens next
+    uint64_t lsn = next_lsn++;
+    journal_bytes += total;
+    stats.writes++;
+    note_appended(total);
+    trace_span_end("storage.journal", span);
+
+    if (fsync_policy == JOURNAL_FSYNC_ALWAYS && journal_sync() != 0) {
+        // The caller reports the change as failed, so it must not come back on replay
+        if (ftruncate(journal_fd, journal_bytes - total) == 0) {
+            journal_bytes -= total;
+            next_lsn--;
+            unsynced--;
+            return 0;
+        }
+        // Stuck in the file: it is applied, and durable_lsn holds back its ack until a retried fsync
+        perror("journal truncate");
+    }
+    return lsn;
+}
+
+int journal_sync(void)
+{
+    if (journal_fd < 0 || !unsynced)
+        return 0;
+    if (batch_len > 0 && write_batch() != 0)
+        return -1;
+    uint64_t span = trace_span_begin();
+    int rc = fdatasync(journal_fd);
+    trace_span_end("storage.fsync", span);
+    if (rc != 0)
+        return -1;
+
+    // Everything appended so far is on disk: one commit covering `unsynced` records
+    uint64_t waited_us = now_us() - unsynced_since_us;
+    stats.syncs++;
+    stats.synced_records += unsynced;
+    if ((unsigned long long)unsynced > stats.max_batch)
+        stats.max_batch = unsynced;
+    stats.commit_wait_us += waited_us;
+    if (waited_us > stats.max_commit_wait_us)
+        stats.max_commit_wait_us = waited_us;
+    durable_lsn = next_lsn - 1;
+    unsynced = 0;
+    return 0;
+}
+
+uint64_t journal_durable_lsn(void)
+{
+    return durable_lsn;
+}
+
+int journal_rotate(const char* old_path)
+{
+    if (journal_fd < 0)
+        return -1;
+    if (journal_sync() != 0 || rename(journal_path, old_path) != 0)
+        return -1;
+
+    close(journal_fd);
+    journal_fd = open(journal_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    journal_bytes = 0;
+    stats.rotations++;
+    return journal_fd >= 0 ? 0 : -1;
+}
+
+uint64_t journal_next_lsn(void)
+{
+    return next_lsn;
+}
+
+void journal_set_next_lsn(uint64_t lsn)
+{
+    if (lsn > next_lsn)
+        next_lsn = lsn;
+}
+
+size_t journal_size(void)
+{
+    return journal_bytes + batch_len;
+}
+
+int journal_timeout_ms(void)
+{
+    if (!unsynced)
+        return -1;
+    uint64_t due;
+    if (fsync_policy == JOURNAL_FSYNC_GROUP) {
+        if (unsynced >= group_max_records)
+            return 0;
+        due = unsynced_since_us + group_window_us;
+    } else {
+        // Under the always policy, records are only left unsynced by a failed fsync
+        due = unsynced_since_us + fsync_interval_ms * 1000;
+    }
+    uint64_t now = now_us();
+    return now >= due ? 0 : (int)((due - now + 999) / 1000);
+}
+
+void journal_tick(void)
+{
+    if (journal_timeout_ms() == 0 && journal_sync() != 0)
+        perror("journal fsync");
+}
+
+long journal_replay(const char* path, JournalReplayFn fn, void* ctx)
+{
+    int fd = open(path, O_RDWR);
+    if (fd < 0)
+        return errno == ENOENT ? 0 : -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    char* data = malloc(size ? size : 1);
+    size_t got = 0;
+    while (data && got < size) {
+        ssize_t n = read(fd, data + got, size - got);
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    if (!data || got != size) {
+        free(data);
+        close(fd);
+        return -1;
+    }
+
+    long records = 0;
+    size_t offset = 0;
+    while (size - offset >= sizeof(JournalRecordHeader)) {
+        JournalRecordHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        const char* payload = data + offset + sizeof(header);
+        if (header.length > MAX_RECORD_PAYLOAD || header.length > size - offset - sizeof(header)
+            || record_crc(&header, payload) != header.crc)
+            break;
+
+        fn(header.lsn, header.type, payload, header.length, ctx);
+        journal_set_next_lsn(header.lsn + 1);
+        offset += sizeof(header) + header.length;
+        records++;
+    }
+
+    if (offset < size) {
+        printf("Journal %s: discarding %zu bytes after record %ld\n", path, size - offset, records);
+        if (ftruncate(fd, offset) != 0)
+            perror("journal truncate");
+    }
+    free(data);
+    close(fd);
+    return records;
+}
+
+JournalFsyncPolicy journal_parse_policy(const char* name)
+{
+    if (strcmp(name, "always") == 0)
+        return JOURNAL_FSYNC_ALWAYS;
+    if (strcmp(name, "interval") == 0)
+        return JOURNAL_FSYNC_INTERVAL;
+    return JOURNAL_FSYNC_GROUP;
+}
+
+const char* journal_policy_name(JournalFsyncPolicy policy)
+{
+    switch (policy) {
+    case JOURNAL_FSYNC_ALWAYS: return "always";
+    case JOURNAL_FSYNC_INTERVAL: return "interval";
+    default: return "group";
+    }
+}
+
+void journal_get_stats(JournalStats* out)
+{
+    *out = stats;
+}
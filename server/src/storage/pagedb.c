@@ -0,0 +1,1123 @@
+#include "pagedb.h"
+#include "journal.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PAGE_SIZE PAGEDB_PAGE_SIZE
+#define META_MAGIC "QZDB"
+#define META_VERSION 1
+#define MIN_CACHE_PAGES 64
+#define OVERFLOW_VALUE 0xFFFF // value_len of a leaf cell whose value is in overflow pages
+#define MAX_CELLS (PAGE_SIZE / 8 + 2)
+
+enum
+{
+    PAGE_LEAF = 1,
+    PAGE_BRANCH = 2,
+    PAGE_OVERFLOW = 3
+};
+
+// Pages 0 and 1; commit t writes slot t % 2
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t root; // 0 = empty tree
+    uint32_t page_count;
+    uint32_t reserved;
+    uint64_t txn;
+    uint64_t user_lsn;
+    uint32_t crc; // of the fields above
+} MetaPage;
+
+// Leaf and branch pages are slotted: 16-bit cell offsets follow the header
+// in key order, cells are packed from the end of the page downwards.
+//   leaf cell    u16 key_len, u16 value_len, key, value
+//                (value_len OVERFLOW_VALUE: u32 first page, u32 length)
+//   branch cell  u32 child, u16 key_len, key
+// A branch with n cells has n + 1 children: link, then each cell's child,
+// which holds the keys >= the cell's key.
+typedef struct
+{
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t count;
+    uint16_t cells_start;
+    uint16_t garbage; // bytes of removed cells still inside the cell area
+    uint32_t link; // branch: first child; overflow: next page
+    uint32_t used; // overflow: bytes of value in this page
+    uint64_t txn; // transaction that wrote the page, which may change it in place
+} PageHeader;
+
+#define HEADER_SIZE sizeof(PageHeader)
+#define OVERFLOW_CAPACITY (PAGE_SIZE - HEADER_SIZE)
+
+typedef struct
+{
+    uint32_t pgno; // 0 = unused, the meta pages are never cached
+    int pins;
+    int dirty;
+    int referenced; // clock bit
+    int next; // hash chain
+    unsigned char* data;
+} Frame;
+
+struct PageDb
+{
+    int fd;
+    pthread_mutex_t lock; // cache, tree and free list; recursive so scan callbacks may read
+    pthread_mutex_t txn_lock; // held from begin to commit or rollback
+
+    uint32_t committed_root;
+    uint32_t committed_pages;
+    uint64_t committed_txn;
+    uint64_t user_lsn;
+
+    uint32_t root;
+    uint32_t page_count;
+    uint64_t txn; // id of the open (or next) transaction
+
+    uint32_t* free_pages; // reusable now
+    int free_count;
+    int free_cap;
+    uint32_t* pending_free; // freed by the open transaction, reusable after it commits
+    int pending_count;
+    int pending_cap;
+
+    Frame* frames;
+    unsigned char* frame_data;
+    int frame_count;
+    int* buckets;
+    unsigned int bucket_mask;
+    int clock_hand;
+
+    PageDbStats stats;
+};
+
+typedef struct
+{
+    int split;
+    uint32_t right;
+    unsigned char key[PAGEDB_MAX_KEY];
+    size_t key_len;
+} SplitResult;
+
+typedef struct
+{
+    const unsigned char* cell;
+    size_t size;
+} CellRef;
+
+static uint16_t rd16(const unsigned char* p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t rd32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void wr16(unsigned char* p, uint16_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static void wr32(unsigned char* p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static PageHeader* header(unsigned char* page)
+{
+    return (PageHeader*)page;
+}
+
+static uint16_t* slots(unsigned char* page)
+{
+    return (uint16_t*)(page + HEADER_SIZE);
+}
+
+static unsigned char* cell_at(unsigned char* page, int i)
+{
+    return page + slots(page)[i];
+}
+
+static size_t cell_size(int type, const unsigned char* cell)
+{
+    if (type == PAGE_BRANCH)
+        return 6 + rd16(cell + 4);
+    uint16_t value_len = rd16(cell + 2);
+    return 4 + rd16(cell) + (value_len == OVERFLOW_VALUE ? 8 : value_len);
+}
+
+static const unsigned char* cell_key(int type, const unsigned char* cell, size_t* len)
+{
+    if (type == PAGE_BRANCH) {
+        *len = rd16(cell + 4);
+        return cell + 6;
+    }
+    *len = rd16(cell);
+    return cell + 4;
+}
+
+static int compare_keys(const void* a, size_t a_len, const void* b, size_t b_len)
+{
+    int c = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (c != 0)
+        return c;
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+// First cell whose key is >= key
+static int page_search(unsigned char* page, const void* key, size_t len, int* found)
+{
+    PageHeader* h = header(page);
+    int lo = 0;
+    int hi = h->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        size_t mid_len;
+        const unsigned char* mid_key = cell_key(h->type, cell_at(page, mid), &mid_len);
+        if (compare_keys(mid_key, mid_len, key, len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *found = 0;
+    if (lo < h->count) {
+        size_t lo_len;
+        const unsigned char* lo_key = cell_key(h->type, cell_at(page, lo), &lo_len);
+        *found = compare_keys(lo_key, lo_len, key, len) == 0;
+    }
+    return lo;
+}
+
+static int branch_child_index(unsigned char* page, const void* key, size_t len)
+{
+    int found;
+    int i = page_search(page, key, len, &found);
+    return found ? i + 1 : i;
+}
+
+static uint32_t branch_child(unsigned char* page, int i)
+{
+    return i == 0 ? header(page)->link : rd32(cell_at(page, i - 1));
+}
+
+static void branch_set_child(unsigned char* page, int i, uint32_t pgno)
+{
+    if (i == 0)
+        header(page)->link = pgno;
+    else
+        wr32(cell_at(page, i - 1), pgno);
+}
+
+static size_t page_free_space(unsigned char* page)
+{
+    PageHeader* h = header(page);
+    return h->cells_start - (HEADER_SIZE + 2 * (size_t)h->count);
+}
+
+static void page_compact(unsigned char* page)
+{
+    unsigned char copy[PAGE_SIZE];
+    memcpy(copy, page, PAGE_SIZE);
+    PageHeader* h = header(page);
+    size_t offset = PAGE_SIZE;
+    for (int i = 0; i < h->count; i++) {
+        const unsigned char* cell = cell_at(copy, i);
+        size_t size = cell_size(h->type, cell);
+        offset -= size;
+        memcpy(page + offset, cell, size);
+        slots(page)[i] = (uint16_t)offset;
+    }
+    h->cells_start = (uint16_t)offset;
+    h->garbage = 0;
+}
+
+static int page_insert_cell(unsigned char* page, int i, const unsigned char* cell, size_t size)
+{
+    PageHeader* h = header(page);
+    if (page_free_space(page) < size + 2) {
+        if (page_free_space(page) + h->garbage < size + 2)
+            return -1;
+        page_compact(page);
+    }
+    h->cells_start -= (uint16_t)size;
+    memcpy(page + h->cells_start, cell, size);
+    memmove(&slots(page)[i + 1], &slots(page)[i], (h->count - i) * sizeof(uint16_t));
+    slots(page)[i] = h->cells_start;
+    h->count++;
+    return 0;
+}
+
+static void page_remove_cell(unsigned char* page, int i)
+{
+    PageHeader* h = header(page);
+    h->garbage += (uint16_t)cell_size(h->type, cell_at(page, i));
+    memmove(&slots(page)[i], &slots(page)[i + 1], (h->count - i - 1) * sizeof(uint16_t));
+    h->count--;
+}
+
+// Buffer cache
+
+static unsigned int bucket_of(PageDb* db, uint32_t pgno)
+{
+    return (pgno * 2654435761u) & db->bucket_mask;
+}
+
+static Frame* cache_find(PageDb* db, uint32_t pgno)
+{
+    for (int i = db->buckets[bucket_of(db, pgno)]; i >= 0; i = db->frames[i].next) {
+        if (db->frames[i].pgno == pgno)
+            return &db->frames[i];
+    }
+    return NULL;
+}
+
+static void cache_unlink(PageDb* db, Frame* f)
+{
+    int i = (int)(f - db->frames);
+    int* link = &db->buckets[bucket_of(db, f->pgno)];
+    while (*link != i)
+        link = &db->frames[*link].next;
+    *link = f->next;
+    f->pgno = 0;
+    f->dirty = 0;
+}
+
+static int write_page(PageDb* db, uint32_t pgno, const unsigned char* data)
+{
+    db->stats.writes++;
+    return pwrite(db->fd, data, PAGE_SIZE, (off_t)pgno * PAGE_SIZE) == PAGE_SIZE ? 0 : -1;
+}
+
+// Clock eviction. Every dirty page is new in this transaction and unreachable
+// from the committed meta page, so it can be written out early.
+static Frame* cache_victim(PageDb* db)
+{
+    for (int scanned = 0; scanned < db->frame_count * 3; scanned++) {
+        Frame* f = &db->frames[db->clock_hand];
+        db->clock_hand = (db->clock_hand + 1) % db->frame_count;
+        if (f->pins)
+            continue;
+        if (f->pgno && f->referenced) {
+            f->referenced = 0;
+            continue;
+        }
+        if (f->pgno) {
+            if (f->dirty && write_page(db, f->pgno, f->data) != 0)
+                continue;
+            cache_unlink(db, f);
+        }
+        return f;
+    }
+    return NULL;
+}
+
+static Frame* cache_insert(PageDb* db, uint32_t pgno)
+{
+    Frame* f = cache_victim(db);
+    if (!f)
+        return NULL;
+    unsigned int bucket = bucket_of(db, pgno);
+    f->pgno = pgno;
+    f->pins = 1;
+    f->dirty = 0;
+    f->referenced = 1;
+    f->next = db->buckets[bucket];
+    db->buckets[bucket] = (int)(f - db->frames);
+    return f;
+}
+
+// Pinned until page_release
+static Frame* page_fetch(PageDb* db, uint32_t pgno)
+{
+    if (pgno < 2 || pgno >= db->page_count)
+        return NULL;
+    Frame* f = cache_find(db, pgno);
+    if (f) {
+        f->pins++;
+        f->referenced = 1;
+        db->stats.hits++;
+        return f;
+    }
+    f = cache_insert(db, pgno);
+    if (!f)
+        return NULL;
+    db->stats.reads++;
+    if (pread(db->fd, f->data, PAGE_SIZE, (off_t)pgno * PAGE_SIZE) != PAGE_SIZE) {
+        f->pins = 0;
+        cache_unlink(db, f);
+        return NULL;
+    }
+    return f;
+}
+
+static void page_release(Frame* f)
+{
+    f->pins--;
+}
+
+static int push_page(uint32_t** list, int* count, int* cap, uint32_t pgno)
+{
+    if (*count == *cap) {
+        int grown_cap = *cap ? *cap * 2 : 256;
+        uint32_t* grown = realloc(*list, grown_cap * sizeof(uint32_t));
+        if (!grown)
+            return -1;
+        *list = grown;
+        *cap = grown_cap;
+    }
+    (*list)[(*count)++] = pgno;
+    return 0;
+}
+
+static Frame* page_alloc(PageDb* db, uint8_t type)
+{
+    uint32_t pgno = db->free_count ? db->free_pages[--db->free_count] : db->page_count++;
+    // A freed page may still be cached
+    Frame* f = cache_find(db, pgno);
+    if (f)
+        f->pins++;
+    else
+        f = cache_insert(db, pgno);
+    if (!f) {
+        push_page(&db->free_pages, &db->free_count, &db->free_cap, pgno);
+        return NULL;
+    }
+    memset(f->data, 0, PAGE_SIZE);
+    PageHeader* h = header(f->data);
+    h->type = type;
+    h->cells_start = PAGE_SIZE;
+    h->txn = db->txn;
+    f->dirty = 1;
+    f->referenced = 1;
+    return f;
+}
+
+static void page_free(PageDb* db, uint32_t pgno, uint64_t page_txn)
+{
+    if (page_txn == db->txn) {
+        // Never committed: nothing refers to it, its contents need not be written
+        Frame* f = cache_find(db, pgno);
+        if (f)
+            f->dirty = 0;
+        push_page(&db->free_pages, &db->free_count, &db->free_cap, pgno);
+    } else {
+        push_page(&db->pending_free, &db->pending_count, &db->pending_cap, pgno);
+    }
+}
+
+// The page to change instead of *pgno: itself if this transaction wrote it,
+// otherwise a copy, whose number replaces *pgno
+static Frame* page_writable(PageDb* db, uint32_t* pgno)
+{
+    Frame* f = page_fetch(db, *pgno);
+    if (!f)
+        return NULL;
+    PageHeader* h = header(f->data);
+    if (h->txn == db->txn) {
+        f->dirty = 1;
+        return f;
+    }
+    Frame* copy = page_alloc(db, h->type);
+    if (!copy) {
+        page_release(f);
+        return NULL;
+    }
+    memcpy(copy->data, f->data, PAGE_SIZE);
+    header(copy->data)->txn = db->txn;
+    page_free(db, *pgno, h->txn);
+    page_release(f);
+    *pgno = copy->pgno;
+    return copy;
+}
+
+// Overflow chains
+
+static int overflow_write(PageDb* db, const unsigned char* value, size_t len, uint32_t* first)
+{
+    // Back to front, so each page can name the next
+    uint32_t next = 0;
+    size_t pages = (len + OVERFLOW_CAPACITY - 1) / OVERFLOW_CAPACITY;
+    for (size_t i = pages; i-- > 0;) {
+        Frame* f = page_alloc(db, PAGE_OVERFLOW);
+        if (!f)
+            return -1;
+        size_t offset = i * OVERFLOW_CAPACITY;
+        size_t n = len - offset < OVERFLOW_CAPACITY ? len - offset : OVERFLOW_CAPACITY;
+        memcpy(f->data + HEADER_SIZE, value + offset, n);
+        header(f->data)->used = (uint32_t)n;
+        header(f->data)->link = next;
+        next = f->pgno;
+        page_release(f);
+    }
+    *first = next;
+    return 0;
+}
+
+static int overflow_read(PageDb* db, uint32_t pgno, size_t len, unsigned char* out)
+{
+    size_t done = 0;
+    while (done < len && pgno) {
+        Frame* f = page_fetch(db, pgno);
+        if (!f)
+            return -1;
+        PageHeader* h = header(f->data);
+        size_t n = h->used < len - done ? h->used : len - done;
+        memcpy(out + done, f->data + HEADER_SIZE, n);
+        done += n;
+        pgno = h->link;
+        page_release(f);
+    }
+    return done == len ? 0 : -1;
+}
+
+static void overflow_free(PageDb* db, uint32_t pgno)
+{
+    while (pgno) {
+        Frame* f = page_fetch(db, pgno);
+        if (!f)
+            return;
+        uint32_t next = header(f->data)->link;
+        uint64_t txn = header(f->data)->txn;
+        page_release(f);
+        page_free(db, pgno, txn);
+        pgno = next;
+    }
+}
+
+static void free_cell_value(PageDb* db, const unsigned char* cell)
+{
+    size_t key_len = rd16(cell);
+    if (rd16(cell + 2) == OVERFLOW_VALUE)
+        overflow_free(db, rd32(cell + 4 + key_len));
+}
+
+// Hands the value of leaf cell i to fn, reading overflow pages into a temporary buffer
+static int emit_cell(PageDb* db, unsigned char* page, int i, PageDbScanFn fn, void* ctx)
+{
+    const unsigned char* cell = cell_at(page, i);
+    size_t key_len = rd16(cell);
+    uint16_t value_len = rd16(cell + 2);
+    if (value_len != OVERFLOW_VALUE)
+        return fn(cell + 4, key_len, cell + 4 + key_len, value_len, ctx) ? 1 : 0;
+
+    size_t len = rd32(cell + 8 + key_len);
+    unsigned char* value = malloc(len ? len : 1);
+    if (!value || overflow_read(db, rd32(cell + 4 + key_len), len, value) != 0) {
+        free(value);
+        return -1;
+    }
+    int stop = fn(cell + 4, key_len, value, len, ctx);
+    free(value);
+    return stop ? 1 : 0;
+}
+
+// Tree operations
+
+// Splits page f, adding cell at index i. The lower half stays in f.
+static int split_page(PageDb* db, Frame* f, int i, const unsigned char* cell, size_t size, SplitResult* out)
+{
+    unsigned char copy[PAGE_SIZE];
+    memcpy(copy, f->data, PAGE_SIZE);
+    PageHeader* h = header(copy);
+    int type = h->type;
+    int n = h->count + 1;
+    CellRef refs[MAX_CELLS];
+    size_t total = 0;
+    for (int k = 0, old = 0; k < n; k++) {
+        if (k == i) {
+            refs[k].cell = cell;
+            refs[k].size = size;
+        } else {
+            refs[k].cell = cell_at(copy, old++);
+            refs[k].size = cell_size(type, refs[k].cell);
+        }
+        total += refs[k].size + 2;
+    }
+
+    int m = 0;
+    size_t left_bytes = 0;
+    while (m < n - 1 && left_bytes + refs[m].size + 2 <= total / 2) {
+        left_bytes += refs[m].size + 2;
+        m++;
+    }
+    if (m == 0)
+        m = 1;
+
+    Frame* right = page_alloc(db, (uint8_t)type);
+    if (!right)
+        return -1;
+
+    PageHeader* left_h = header(f->data);
+    left_h->count = 0;
+    left_h->cells_start = PAGE_SIZE;
+    left_h->garbage = 0;
+    for (int k = 0; k < m; k++)
+        page_insert_cell(f->data, k, refs[k].cell, refs[k].size);
+
+    size_t key_len;
+    const unsigned char* key = cell_key(type, refs[m].cell, &key_len);
+    memcpy(out->key, key, key_len);
+    out->key_len = key_len;
+    int from = m;
+    if (type == PAGE_BRANCH) {
+        // The middle key moves up; its child becomes the right page's first
+        header(right->data)->link = rd32(refs[m].cell);
+        from = m + 1;
+    }
+    for (int k = from; k < n; k++)
+        page_insert_cell(right->data, k - from, refs[k].cell, refs[k].size);
+
+    out->split = 1;
+    out->right = right->pgno;
+    page_release(right);
+    return 0;
+}
+
+static size_t make_branch_cell(unsigned char* cell, uint32_t child, const unsigned char* key, size_t key_len)
+{
+    wr32(cell, child);
+    wr16(cell + 4, (uint16_t)key_len);
+    memcpy(cell + 6, key, key_len);
+    return 6 + key_len;
+}
+
+static int insert_rec(PageDb* db, uint32_t* pgno, const void* key, size_t key_len, const unsigned char* cell,
+                      size_t size, SplitResult* split)
+{
+    split->split = 0;
+    Frame* f = page_fetch(db, *pgno);
+    if (!f)
+        return -1;
+
+    if (header(f->data)->type == PAGE_LEAF) {
+        page_release(f);
+        f = page_writable(db, pgno);
+        if (!f)
+            return -1;
+        int found;
+        int i = page_search(f->data, key, key_len, &found);
+        if (found) {
+            free_cell_value(db, cell_at(f->data, i));
+            page_remove_cell(f->data, i);
+        }
+        int rc = 0;
+        if (page_insert_cell(f->data, i, cell, size) != 0)
+            rc = split_page(db, f, i, cell, size, split);
+        page_release(f);
+        return rc;
+    }
+
+    int i = branch_child_index(f->data, key, key_len);
+    uint32_t child = branch_child(f->data, i);
+    page_release(f);
+
+    uint32_t new_child = child;
+    SplitResult below;
+    if (insert_rec(db, &new_child, key, key_len, cell, size, &below) != 0)
+        return -1;
+    if (new_child == child && !below.split)
+        return 0;
+
+    f = page_writable(db, pgno);
+    if (!f)
+        return -1;
+    branch_set_child(f->data, i, new_child);
+    int rc = 0;
+    if (below.split) {
+        unsigned char branch_cell[6 + PAGEDB_MAX_KEY];
+        size_t branch_size = make_branch_cell(branch_cell, below.right, below.key, below.key_len);
+        if (page_insert_cell(f->data, i, branch_cell, branch_size) != 0)
+            rc = split_page(db, f, i, branch_cell, branch_size, split);
+    }
+    page_release(f);
+    return rc;
+}
+
+// Pages are not merged when they empty out: the data here is append-mostly
+static int delete_rec(PageDb* db, uint32_t* pgno, const void* key, size_t key_len)
+{
+    Frame* f = page_fetch(db, *pgno);
+    if (!f)
+        return -1;
+
+    if (header(f->data)->type == PAGE_LEAF) {
+        int found;
+        int i = page_search(f->data, key, key_len, &found);
+        page_release(f);
+        if (!found)
+            return 1;
+        f = page_writable(db, pgno);
+        if (!f)
+            return -1;
+        free_cell_value(db, cell_at(f->data, i));
+        page_remove_cell(f->data, i);
+        page_release(f);
+        return 0;
+    }
+
+    int i = branch_child_index(f->data, key, key_len);
+    uint32_t child = branch_child(f->data, i);
+    page_release(f);
+    uint32_t new_child = child;
+    int rc = delete_rec(db, &new_child, key, key_len);
+    if (rc != 0 || new_child == child)
+        return rc;
+    f = page_writable(db, pgno);
+    if (!f)
+        return -1;
+    branch_set_child(f->data, i, new_child);
+    page_release(f);
+    return 0;
+}
+
+static int scan_rec(PageDb* db, uint32_t pgno, const void* from, size_t from_len, int bounded, PageDbScanFn fn,
+                    void* ctx)
+{
+    Frame* f = page_fetch(db, pgno);
+    if (!f)
+        return -1;
+    PageHeader* h = header(f->data);
+    int rc = 0;
+    if (h->type == PAGE_LEAF) {
+        int found;
+        int i = bounded ? page_search(f->data, from, from_len, &found) : 0;
+        for (; i < h->count && rc == 0; i++)
+            rc = emit_cell(db, f->data, i, fn, ctx);
+    } else {
+        // Only the first child visited can hold keys below from
+        int first = bounded ? branch_child_index(f->data, from, from_len) : 0;
+        for (int i = first; i <= h->count && rc == 0; i++)
+            rc = scan_rec(db, branch_child(f->data, i), from, from_len, bounded && i == first, fn, ctx);
+    }
+    page_release(f);
+    return rc;
+}
+
+static int last_below_rec(PageDb* db, uint32_t pgno, const void* below, size_t below_len, PageDbScanFn fn,
+                          void* ctx)
+{
+    Frame* f = page_fetch(db, pgno);
+    if (!f)
+        return -1;
+    PageHeader* h = header(f->data);
+    int rc = 1;
+    if (h->type == PAGE_LEAF) {
+        int found;
+        int i = page_search(f->data, below, below_len, &found);
+        if (i > 0)
+            rc = emit_cell(db, f->data, i - 1, fn, ctx) < 0 ? -1 : 0;
+    } else {
+        // Empty leaves are left in place, so an earlier child may have to answer
+        for (int i = branch_child_index(f->data, below, below_len); i >= 0 && rc == 1; i--)
+            rc = last_below_rec(db, branch_child(f->data, i), below, below_len, fn, ctx);
+    }
+    page_release(f);
+    return rc;
+}
+
+static int mark_pages(PageDb* db, uint32_t pgno, unsigned char* used)
+{
+    if (pgno < 2 || pgno >= db->page_count || used[pgno])
+        return -1;
+    used[pgno] = 1;
+    Frame* f = page_fetch(db, pgno);
+    if (!f)
+        return -1;
+    PageHeader* h = header(f->data);
+    int rc = 0;
+    for (int i = 0; i < h->count && rc == 0; i++) {
+        const unsigned char* cell = cell_at(f->data, i);
+        if (h->type == PAGE_BRANCH) {
+            rc = mark_pages(db, rd32(cell), used);
+            continue;
+        }
+        size_t key_len = rd16(cell);
+        if (rd16(cell + 2) != OVERFLOW_VALUE)
+            continue;
+        for (uint32_t p = rd32(cell + 4 + key_len); p && rc == 0;) {
+            Frame* o = p < db->page_count && !used[p] ? page_fetch(db, p) : NULL;
+            if (!o) {
+                rc = -1;
+                break;
+            }
+            used[p] = 1;
+            p = header(o->data)->link;
+            page_release(o);
+        }
+    }
+    if (rc == 0 && h->type == PAGE_BRANCH)
+        rc = mark_pages(db, h->link, used);
+    page_release(f);
+    return rc;
+}
+
+// Every page the committed tree does not reach is free
+static int rebuild_free_list(PageDb* db)
+{
+    unsigned char* used = calloc(db->page_count, 1);
+    if (!used)
+        return -1;
+    int rc = db->root ? mark_pages(db, db->root, used) : 0;
+    db->free_count = 0;
+    for (uint32_t p = db->page_count; rc == 0 && p-- > 2;) {
+        if (!used[p])
+            rc = push_page(&db->free_pages, &db->free_count, &db->free_cap, p);
+    }
+    free(used);
+    return rc;
+}
+
+static uint32_t meta_crc(const MetaPage* meta)
+{
+    return journal_crc32(0, meta, offsetof(MetaPage, crc));
+}
+
+static int write_meta(PageDb* db)
+{
+    unsigned char page[PAGE_SIZE];
+    memset(page, 0, sizeof(page));
+    MetaPage* meta = (MetaPage*)page;
+    memcpy(meta->magic, META_MAGIC, sizeof(meta->magic));
+    meta->version = META_VERSION;
+    meta->page_size = PAGE_SIZE;
+    meta->root = db->root;
+    meta->page_count = db->page_count;
+    meta->txn = db->txn;
+    meta->user_lsn = db->user_lsn;
+    meta->crc = meta_crc(meta);
+    off_t offset = (off_t)(db->txn % 2) * PAGE_SIZE;
+    if (pwrite(db->fd, page, PAGE_SIZE, offset) != PAGE_SIZE)
+        return -1;
+    return fdatasync(db->fd);
+}
+
+static int read_meta(PageDb* db, int slot, MetaPage* meta)
+{
+    unsigned char page[PAGE_SIZE];
+    if (pread(db->fd, page, PAGE_SIZE, (off_t)slot * PAGE_SIZE) != PAGE_SIZE)
+        return -1;
+    memcpy(meta, page, sizeof(*meta));
+    if (memcmp(meta->magic, META_MAGIC, sizeof(meta->magic)) != 0 || meta->version != META_VERSION
+        || meta->page_size != PAGE_SIZE || meta->crc != meta_crc(meta))
+        return -1;
+    return 0;
+}
+
+PageDb* pagedb_open(const char* path, int cache_pages)
+{
+    PageDb* db = calloc(1, sizeof(PageDb));
+    if (!db)
+        return NULL;
+    db->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (cache_pages < MIN_CACHE_PAGES)
+        cache_pages = MIN_CACHE_PAGES;
+    unsigned int buckets = 1;
+    while (buckets < (unsigned int)cache_pages * 2)
+        buckets *= 2;
+    db->frame_count = cache_pages;
+    db->frames = calloc(cache_pages, sizeof(Frame));
+    db->frame_data = malloc((size_t)cache_pages * PAGE_SIZE);
+    db->buckets = malloc(buckets * sizeof(int));
+    db->bucket_mask = buckets - 1;
+    if (db->fd < 0 || !db->frames || !db->frame_data || !db->buckets) {
+        pagedb_close(db);
+        return NULL;
+    }
+    memset(db->buckets, 0xff, buckets * sizeof(int));
+    for (int i = 0; i < cache_pages; i++)
+        db->frames[i].data = db->frame_data + (size_t)i * PAGE_SIZE;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&db->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&db->txn_lock, NULL);
+
+    MetaPage metas[2];
+    int valid[2] = { read_meta(db, 0, &metas[0]) == 0, read_meta(db, 1, &metas[1]) == 0 };
+    struct stat st;
+    if (!valid[0] && !valid[1]) {
+        if (fstat(db->fd, &st) != 0 || st.st_size > 0) {
+            fprintf(stderr, "%s is not a database file or both its meta pages are damaged\n", path);
+            pagedb_close(db);
+            return NULL;
+        }
+        // New file: an empty tree as transaction 0
+        db->page_count = 2;
+        if (write_meta(db) != 0) {
+            pagedb_close(db);
+            return NULL;
+        }
+    } else {
+        const MetaPage* meta = !valid[1] || (valid[0] && metas[0].txn > metas[1].txn) ? &metas[0] : &metas[1];
+        db->root = meta->root;
+        db->page_count = meta->page_count;
+        db->txn = meta->txn;
+        db->user_lsn = meta->user_lsn;
+    }
+    db->committed_root = db->root;
+    db->committed_pages = db->page_count;
+    db->committed_txn = db->txn;
+    db->txn++;
+
+    if (rebuild_free_list(db) != 0) {
+        fprintf(stderr, "%s: the tree is damaged\n", path);
+        pagedb_close(db);
+        return NULL;
+    }
+    return db;
+}
+
+void pagedb_close(PageDb* db)
+{
+    if (!db)
+        return;
+    if (db->fd >= 0)
+        close(db->fd);
+    free(db->frames);
+    free(db->frame_data);
+    free(db->buckets);
+    free(db->free_pages);
+    free(db->pending_free);
+    free(db);
+}
+
+void pagedb_begin(PageDb* db)
+{
+    pthread_mutex_lock(&db->txn_lock);
+}
+
+static void rollback_locked(PageDb* db)
+{
+    for (int i = 0; i < db->frame_count; i++) {
+        Frame* f = &db->frames[i];
+        if (f->pgno && header(f->data)->txn == db->txn)
+            cache_unlink(db, f);
+    }
+    db->root = db->committed_root;
+    db->page_count = db->committed_pages;
+    db->pending_count = 0;
+    if (rebuild_free_list(db) != 0)
+        db->free_count = 0; // leaks pages until the next open, never reuses live ones
+}
+
+int pagedb_commit(PageDb* db, uint64_t user_lsn)
+{
+    pthread_mutex_lock(&db->lock);
+    int dirty = 0;
+    for (int i = 0; i < db->frame_count; i++)
+        dirty |= db->frames[i].pgno && db->frames[i].dirty;
+
+    int rc = 0;
+    if (dirty || db->root != db->committed_root || user_lsn != db->user_lsn) {
+        for (int i = 0; i < db->frame_count && rc == 0; i++) {
+            Frame* f = &db->frames[i];
+            if (f->pgno && f->dirty) {
+                rc = write_page(db, f->pgno, f->data);
+                f->dirty = rc != 0;
+            }
+        }
+        // New pages reach the disk before the meta page that makes them live
+        uint64_t old_lsn = db->user_lsn;
+        db->user_lsn = user_lsn;
+        if (rc == 0 && (fdatasync(db->fd) != 0 || write_meta(db) != 0))
+            rc = -1;
+        if (rc == 0) {
+            db->committed_root = db->root;
+            db->committed_pages = db->page_count;
+            db->committed_txn = db->txn;
+            db->txn++;
+            db->stats.commits++;
+            for (int i = 0; i < db->pending_count; i++)
+                push_page(&db->free_pages, &db->free_count, &db->free_cap, db->pending_free[i]);
+            db->pending_count = 0;
+        } else {
+            db->user_lsn = old_lsn;
+            rollback_locked(db);
+        }
+    }
+    pthread_mutex_unlock(&db->lock);
+    pthread_mutex_unlock(&db->txn_lock);
+    return rc;
+}
+
+void pagedb_rollback(PageDb* db)
+{
+    pthread_mutex_lock(&db->lock);
+    rollback_locked(db);
+    pthread_mutex_unlock(&db->lock);
+    pthread_mutex_unlock(&db->txn_lock);
+}
+
+uint64_t pagedb_user_lsn(PageDb* db)
+{
+    pthread_mutex_lock(&db->lock);
+    uint64_t lsn = db->user_lsn;
+    pthread_mutex_unlock(&db->lock);
+    return lsn;
+}
+
+int pagedb_put(PageDb* db, const void* key, size_t key_len, const void* value, size_t value_len)
+{
+    if (key_len == 0 || key_len > PAGEDB_MAX_KEY || value_len > UINT32_MAX)
+        return -1;
+
+    unsigned char cell[4 + PAGEDB_MAX_KEY + PAGEDB_MAX_INLINE_VALUE];
+    size_t size = 4 + key_len;
+    wr16(cell, (uint16_t)key_len);
+    memcpy(cell + 4, key, key_len);
+
+    pthread_mutex_lock(&db->lock);
+    int rc = 0;
+    if (value_len > PAGEDB_MAX_INLINE_VALUE) {
+        uint32_t first = 0;
+        rc = overflow_write(db, value, value_len, &first);
+        wr16(cell + 2, OVERFLOW_VALUE);
+        wr32(cell + size, first);
+        wr32(cell + size + 4, (uint32_t)value_len);
+        size += 8;
+    } else {
+        wr16(cell + 2, (uint16_t)value_len);
+        memcpy(cell + size, value, value_len);
+        size += value_len;
+    }
+
+    if (rc == 0 && !db->root) {
+        Frame* f = page_alloc(db, PAGE_LEAF);
+        if (f) {
+            page_insert_cell(f->data, 0, cell, size);
+            db->root = f->pgno;
+            page_release(f);
+        } else {
+            rc = -1;
+        }
+    } else if (rc == 0) {
+        uint32_t root = db->root;
+        SplitResult split;
+        rc = insert_rec(db, &root, key, key_len, cell, size, &split);
+        if (rc == 0 && split.split) {
+            Frame* f = page_alloc(db, PAGE_BRANCH);
+            if (f) {
+                unsigned char branch_cell[6 + PAGEDB_MAX_KEY];
+                header(f->data)->link = root;
+                page_insert_cell(f->data, 0, branch_cell,
+                                 make_branch_cell(branch_cell, split.right, split.key, split.key_len));
+                root = f->pgno;
+                page_release(f);
+            } else {
+                rc = -1;
+            }
+        }
+        if (rc == 0)
+            db->root = root;
+    }
+    pthread_mutex_unlock(&db->lock);
+    return rc;
+}
+
+int pagedb_delete(PageDb* db, const void* key, size_t key_len)
+{
+    pthread_mutex_lock(&db->lock);
+    int rc = 1;
+    if (db->root) {
+        uint32_t root = db->root;
+        rc = delete_rec(db, &root, key, key_len);
+        if (rc == 0)
+            db->root = root;
+    }
+    pthread_mutex_unlock(&db->lock);
+    return rc;
+}
+
+typedef struct
+{
+    void* value;
+    size_t len;
+} ValueCopy;
+
+static int copy_value(const void* key, size_t key_len, const void* value, size_t value_len, void* ctx)
+{
+    (void)key;
+    (void)key_len;
+    ValueCopy* copy = ctx;
+    copy->value = malloc(value_len ? value_len : 1);
+    if (copy->value) {
+        memcpy(copy->value, value, value_len);
+        copy->len = value_len;
+    }
+    return 1;
+}
+
+int pagedb_get(PageDb* db, const void* key, size_t key_len, void** value, size_t* value_len)
+{
+    pthread_mutex_lock(&db->lock);
+    int rc = 1;
+    uint32_t pgno = db->root;
+    while (pgno) {
+        Frame* f = page_fetch(db, pgno);
+        if (!f) {
+            rc = -1;
+            break;
+        }
+        if (header(f->data)->type == PAGE_BRANCH) {
+            pgno = branch_child(f->data, branch_child_index(f->data, key, key_len));
+            page_release(f);
+            continue;
+        }
+        int found;
+        int i = page_search(f->data, key, key_len, &found);
+        if (found) {
+            ValueCopy copy = { NULL, 0 };
+            rc = emit_cell(db, f->data, i, copy_value, &copy) < 0 || !copy.value ? -1 : 0;
+            *value = copy.value;
+            *value_len = copy.len;
+        }
+        page_release(f);
+        break;
+    }
+    pthread_mutex_unlock(&db->lock);
+    return rc;
+}
+
+int pagedb_scan(PageDb* db, const void* from, size_t from_len, PageDbScanFn fn, void* ctx)
+{
+    pthread_mutex_lock(&db->lock);
+    int rc = db->root ? scan_rec(db, db->root, from, from_len, 1, fn, ctx) : 0;
+    pthread_mutex_unlock(&db->lock);
+    return rc < 0 ? -1 : 0;
+}
+
+int pagedb_last_below(PageDb* db, const void* below, size_t below_len, PageDbScanFn fn, void* ctx)
+{
+    pthread_mutex_lock(&db->lock);
+    int rc = db->root ? last_below_rec(db, db->root, below, below_len, fn, ctx) : 1;
+    pthread_mutex_unlock(&db->lock);
+    return rc;
+}
+
+void pagedb_get_stats(PageDb* db, PageDbStats* out)
+{
+    pthread_mutex_lock(&db->lock);
+    *out = db->stats;
+    out->txn = db->committed_txn;
+    out->pages = db->page_count;
+    out->free_pages = (unsigned int)db->free_count;
+    out->cache_pages = (unsigned int)db->frame_count;
+    pthread_mutex_unlock(&db->lock);
+}
@@ -0,0 +1,234 @@
+#include "qbk.h"
+#include "json_arena.h"
+#include "protocol.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    char* data;
+    size_t len;
+    size_t cap;
+} HeapBuffer;
+
+static int heap_add(HeapBuffer* heap, const char* s, size_t len, uint32_t* offset)
+{
+    size_t need = heap->len + len + 1;
+    if (need > UINT32_MAX)
+        return -1;
+    if (need > heap->cap) {
+        size_t cap = heap->cap ? heap->cap : 4096;
+        while (cap < need)
+            cap *= 2;
+        char* grown = realloc(heap->data, cap);
+        if (!grown)
+            return -1;
+        heap->data = grown;
+        heap->cap = cap;
+    }
+    memcpy(heap->data + heap->len, s, len);
+    heap->data[heap->len + len] = '\0';
+    *offset = (uint32_t)heap->len;
+    heap->len = need;
+    return 0;
+}
+
+static int is_string_array(const cJSON* item)
+{
+    if (!cJSON_IsArray(item))
+        return 0;
+    for (const cJSON* c = item->child; c; c = c->next) {
+        if (!cJSON_IsString(c))
+            return 0;
+    }
+    return 1;
+}
+
+static int is_answer(const cJSON* item)
+{
+    return cJSON_IsNumber(item) && item->valuedouble == (double)item->valueint && item->valueint != QBK_NO_ANSWER;
+}
+
+static int encode_question(const cJSON* q, QbkQuestion* out, QbkString* options, uint32_t* next_option,
+                           HeapBuffer* heap)
+{
+    memset(out, 0, sizeof(*out));
+    out->correct_index = QBK_NO_ANSWER;
+    cJSON* extra = NULL;
+    int rc = 0;
+
+    for (const cJSON* item = q->child; item && rc == 0; item = item->next) {
+        if (!(out->flags & QBK_HAS_TEXT) && strcmp(item->string, JSON_KEY_QUESTION) == 0
+            && cJSON_IsString(item)) {
+            out->text_len = (uint32_t)strlen(item->valuestring);
+            rc = heap_add(heap, item->valuestring, out->text_len, &out->text);
+            out->flags |= QBK_HAS_TEXT;
+        } else if (!(out->flags & QBK_HAS_OPTIONS) && strcmp(item->string, JSON_KEY_OPTIONS) == 0
+                   && is_string_array(item)) {
+            out->options = *next_option;
+            for (const cJSON* opt = item->child; opt && rc == 0; opt = opt->next) {
+                QbkString* s = &options[(*next_option)++];
+                s->len = (uint32_t)strlen(opt->valuestring);
+                rc = heap_add(heap, opt->valuestring, s->len, &s->offset);
+                out->option_count++;
+            }
+            out->flags |= QBK_HAS_OPTIONS;
+        } else if (out->correct_index == QBK_NO_ANSWER && strcmp(item->string, JSON_KEY_CORRECT_INDEX) == 0
+                   && is_answer(item)) {
+            out->correct_index = item->valueint;
+        } else {
+            // Anything else is carried through as JSON
+            if (!extra)
+                extra = cJSON_CreateObject();
+            cJSON_AddItemToObject(extra, item->string, cJSON_Duplicate(item, 1));
+        }
+    }
+
+    if (extra && rc == 0) {
+        char* text = cJSON_PrintUnformatted(extra);
+        if (text) {
+            out->extra_len = (uint32_t)strlen(text);
+            rc = heap_add(heap, text, out->extra_len, &out->extra);
+        } else {
+            rc = -1;
+        }
+        cJSON_free(text);
+    }
+    json_release(extra);
+    return rc;
+}
+
+char* qbk_encode(const cJSON* questions, size_t* size)
+{
+    if (!cJSON_IsArray(questions))
+        return NULL;
+
+    uint32_t count = 0;
+    uint32_t option_count = 0;
+    for (const cJSON* q = questions->child; q; q = q->next) {
+        if (!cJSON_IsObject(q))
+            return NULL;
+        count++;
+        // Upper bound: options that turn out not to be strings go to extra instead
+        for (const cJSON* item = q->child; item; item = item->next) {
+            if (strcmp(item->string, JSON_KEY_OPTIONS) == 0)
+                option_count += (uint32_t)cJSON_GetArraySize(item);
+        }
+    }
+
+    QbkQuestion* entries = calloc(count ? count : 1, sizeof(QbkQuestion));
+    QbkString* options = calloc(option_count ? option_count : 1, sizeof(QbkString));
+    HeapBuffer heap = { NULL, 0, 0 };
+    uint32_t used_options = 0;
+    int rc = entries && options ? 0 : -1;
+
+    uint32_t k = 0;
+    for (const cJSON* q = questions->child; q && rc == 0; q = q->next)
+        rc = encode_question(q, &entries[k++], options, &used_options, &heap);
+
+    char* out = NULL;
+    if (rc == 0) {
+        size_t entries_size = (size_t)count * sizeof(QbkQuestion);
+        size_t options_size = (size_t)used_options * sizeof(QbkString);
+        *size = sizeof(QbkHeader) + entries_size + options_size + heap.len;
+        out = malloc(*size);
+    }
+    if (out) {
+        QbkHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, QBK_MAGIC, sizeof(header.magic));
+        header.version = QBK_VERSION;
+        header.count = count;
+        header.option_count = used_options;
+        header.heap_size = heap.len;
+
+        char* p = out;
+        memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+        memcpy(p, entries, (size_t)count * sizeof(QbkQuestion));
+        p += (size_t)count * sizeof(QbkQuestion);
+        memcpy(p, options, (size_t)used_options * sizeof(QbkString));
+        p += (size_t)used_options * sizeof(QbkString);
+        if (heap.len)
+            memcpy(p, heap.data, heap.len);
+    }
+
+    free(entries);
+    free(options);
+    free(heap.data);
+    return out;
+}
+
+static int string_ok(const char* heap, uint64_t heap_size, uint32_t offset, uint32_t len)
+{
+    return offset < heap_size && len < heap_size - offset && heap[offset + len] == '\0';
+}
+
+int qbk_view_open(QbkView* view, const void* data, size_t size)
+{
+    if (size < sizeof(QbkHeader))
+        return -1;
+    const QbkHeader* header = data;
+    if (memcmp(header->magic, QBK_MAGIC, sizeof(header->magic)) != 0 || header->version != QBK_VERSION)
+        return -1;
+
+    size_t tables = sizeof(QbkHeader) + (size_t)header->count * sizeof(QbkQuestion)
+                    + (size_t)header->option_count * sizeof(QbkString);
+    if (tables > size || header->heap_size != size - tables)
+        return -1;
+
+    const char* base = data;
+    view->count = header->count;
+    view->questions = (const QbkQuestion*)(base + sizeof(QbkHeader));
+    view->options = (const QbkString*)(view->questions + header->count);
+    view->heap = base + tables;
+
+    uint64_t heap_size = header->heap_size;
+    for (uint32_t i = 0; i < header->option_count; i++) {
+        if (!string_ok(view->heap, heap_size, view->options[i].offset, view->options[i].len))
+            return -1;
+    }
+    for (uint32_t k = 0; k < header->count; k++) {
+        const QbkQuestion* q = &view->questions[k];
+        if ((q->flags & QBK_HAS_TEXT) && !string_ok(view->heap, heap_size, q->text, q->text_len))
+            return -1;
+        if (q->options > header->option_count || q->option_count > header->option_count - q->options)
+            return -1;
+        if (q->extra_len && !string_ok(view->heap, heap_size, q->extra, q->extra_len))
+            return -1;
+    }
+    return 0;
+}
+
+cJSON* qbk_question_to_json(const QbkView* view, uint32_t k)
+{
+    const QbkQuestion* q = &view->questions[k];
+    cJSON* obj = cJSON_CreateObject();
+    if (q->flags & QBK_HAS_TEXT)
+        cJSON_AddStringToObject(obj, JSON_KEY_QUESTION, view->heap + q->text);
+    if (q->flags & QBK_HAS_OPTIONS) {
+        cJSON* options = cJSON_AddArrayToObject(obj, JSON_KEY_OPTIONS);
+        for (uint32_t i = 0; i < q->option_count; i++)
+            cJSON_AddItemToArray(options, cJSON_CreateString(view->heap + view->options[q->options + i].offset));
+    }
+    if (q->correct_index != QBK_NO_ANSWER)
+        cJSON_AddNumberToObject(obj, JSON_KEY_CORRECT_INDEX, q->correct_index);
+
+    if (q->extra_len) {
+        cJSON* extra = cJSON_ParseWithLength(view->heap + q->extra, q->extra_len);
+        while (extra && extra->child) {
+            cJSON* item = cJSON_DetachItemViaPointer(extra, extra->child);
+            cJSON_AddItemToObject(obj, item->string, item);
+        }
+        json_release(extra);
+    }
+    return obj;
+}
+
+cJSON* qbk_to_json(const QbkView* view)
+{
+    cJSON* array = cJSON_CreateArray();
+    for (uint32_t k = 0; k < view->count; k++)
+        cJSON_AddItemToArray(array, qbk_question_to_json(view, k));
+    return array;
+}
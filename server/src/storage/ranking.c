@@ -0,0 +1,264 @@
+#include "ranking.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LEVEL 24
+#define USERNAME_SIZE 32
+
+typedef struct RankNode RankNode;
+
+typedef struct
+{
+    RankNode* next;
+    long span; // entries this link moves forward by
+} RankLink;
+
+struct RankNode
+{
+    char username[USERNAME_SIZE];
+    int score;
+    long timestamp;
+    int level;
+    RankLink links[]; // level of them
+};
+
+struct Ranking
+{
+    RankNode* head; // MAX_LEVEL links, holds no entry
+    int level;
+    long count;
+    uint32_t seed;
+    // username -> node, open addressing; users are never removed
+    RankNode** users;
+    int user_cap; // power of two
+};
+
+static unsigned int hash_name(const char* s)
+{
+    unsigned int h = 2166136261u;
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+// Whether a ranks above b
+static int ranks_before(const RankNode* a, const RankNode* b)
+{
+    if (a->score != b->score)
+        return a->score > b->score;
+    if (a->timestamp != b->timestamp)
+        return a->timestamp < b->timestamp;
+    return strcmp(a->username, b->username) < 0;
+}
+
+// One level more with probability 1/4
+static int random_level(Ranking* r)
+{
+    int level = 1;
+    while (level < MAX_LEVEL) {
+        r->seed ^= r->seed << 13;
+        r->seed ^= r->seed >> 17;
+        r->seed ^= r->seed << 5;
+        if (r->seed & 3)
+            break;
+        level++;
+    }
+    return level;
+}
+
+static RankNode* new_node(int level)
+{
+    RankNode* node = calloc(1, sizeof(RankNode) + level * sizeof(RankLink));
+    if (node)
+        node->level = level;
+    return node;
+}
+
+Ranking* ranking_create(void)
+{
+    Ranking* r = calloc(1, sizeof(Ranking));
+    if (!r)
+        return NULL;
+    r->head = new_node(MAX_LEVEL);
+    if (!r->head) {
+        free(r);
+        return NULL;
+    }
+    r->level = 1;
+    r->seed = 2463534242u;
+    return r;
+}
+
+void ranking_free(Ranking* r)
+{
+    if (!r)
+        return;
+    RankNode* x = r->head;
+    while (x) {
+        RankNode* next = x->links[0].next;
+        free(x);
+        x = next;
+    }
+    free(r->users);
+    free(r);
+}
+
+static RankNode** find_user_slot(const Ranking* r, const char* username)
+{
+    if (!r->user_cap)
+        return NULL;
+    unsigned int mask = r->user_cap - 1;
+    unsigned int slot = hash_name(username) & mask;
+    while (r->users[slot] && strcmp(r->users[slot]->username, username) != 0)
+        slot = (slot + 1) & mask;
+    return &r->users[slot];
+}
+
+static int add_user(Ranking* r, RankNode* node)
+{
+    if ((r->count + 1) * 2 > r->user_cap) {
+        int cap = r->user_cap ? r->user_cap * 2 : 64;
+        RankNode** users = calloc(cap, sizeof(RankNode*));
+        if (!users)
+            return -1;
+        for (int i = 0; i < r->user_cap; i++) {
+            if (!r->users[i])
+                continue;
+            unsigned int slot = hash_name(r->users[i]->username) & (cap - 1);
+            while (users[slot])
+                slot = (slot + 1) & (cap - 1);
+            users[slot] = r->users[i];
+        }
+        free(r->users);
+        r->users = users;
+        r->user_cap = cap;
+    }
+    *find_user_slot(r, node->username) = node;
+    return 0;
+}
+
+// Fills update[] with the last node before node on each level and rank[]
+// with how many entries precede update[i]
+static void find_predecessors(const Ranking* r, const RankNode* node, RankNode** update, long* rank)
+{
+    RankNode* x = r->head;
+    for (int i = r->level - 1; i >= 0; i--) {
+        rank[i] = i == r->level - 1 ? 0 : rank[i + 1];
+        while (x->links[i].next && ranks_before(x->links[i].next, node)) {
+            rank[i] += x->links[i].span;
+            x = x->links[i].next;
+        }
+        update[i] = x;
+    }
+}
+
+static void link_node(Ranking* r, RankNode* node)
+{
+    RankNode* update[MAX_LEVEL];
+    long rank[MAX_LEVEL];
+    find_predecessors(r, node, update, rank);
+    if (node->level > r->level) {
+        for (int i = r->level; i < node->level; i++) {
+            rank[i] = 0;
+            update[i] = r->head;
+            update[i]->links[i].span = r->count;
+        }
+        r->level = node->level;
+    }
+    for (int i = 0; i < node->level; i++) {
+        node->links[i].next = update[i]->links[i].next;
+        update[i]->links[i].next = node;
+        node->links[i].span = update[i]->links[i].span - (rank[0] - rank[i]);
+        update[i]->links[i].span = rank[0] - rank[i] + 1;
+    }
+    for (int i = node->level; i < r->level; i++)
+        update[i]->links[i].span++;
+    r->count++;
+}
+
+static void unlink_node(Ranking* r, RankNode* node)
+{
+    RankNode* update[MAX_LEVEL];
+    long rank[MAX_LEVEL];
+    find_predecessors(r, node, update, rank);
+    for (int i = 0; i < r->level; i++) {
+        if (update[i]->links[i].next == node) {
+            update[i]->links[i].span += node->links[i].span - 1;
+            update[i]->links[i].next = node->links[i].next;
+        } else {
+            update[i]->links[i].span--;
+        }
+    }
+    while (r->level > 1 && !r->head->links[r->level - 1].next)
+        r->level--;
+    r->count--;
+}
+
+int ranking_update(Ranking* r, const char* username, int score, long timestamp)
+{
+    RankNode** slot = find_user_slot(r, username);
+    RankNode* node = slot ? *slot : NULL;
+    if (node) {
+        if (score < node->score || (score == node->score && timestamp >= node->timestamp))
+            return 0;
+        // The node keeps its level and its place in the user table
+        unlink_node(r, node);
+    } else {
+        node = new_node(random_level(r));
+        if (!node)
+            return -1;
+        size_t len = strlen(username);
+        if (len > USERNAME_SIZE - 1)
+            len = USERNAME_SIZE - 1;
+        memcpy(node->username, username, len);
+        if (add_user(r, node) != 0) {
+            free(node);
+            return -1;
+        }
+    }
+    node->score = score;
+    node->timestamp = timestamp;
+    link_node(r, node);
+    return 1;
+}
+
+long ranking_count(const Ranking* r)
+{
+    return r->count;
+}
+
+long ranking_rank(const Ranking* r, const char* username)
+{
+    RankNode** slot = find_user_slot(r, username);
+    const RankNode* node = slot ? *slot : NULL;
+    if (!node)
+        return 0;
+    long rank = 0;
+    const RankNode* x = r->head;
+    for (int i = r->level - 1; i >= 0; i--) {
+        while (x->links[i].next && !ranks_before(node, x->links[i].next)) {
+            rank += x->links[i].span;
+            x = x->links[i].next;
+        }
+        if (x == node)
+            return rank;
+    }
+    return 0;
+}
+
+void ranking_range(const Ranking* r, long first, long count, RankingFn fn, void* ctx)
+{
+    if (first < 1 || first > r->count || count <= 0)
+        return;
+    long traversed = 0;
+    const RankNode* x = r->head;
+    for (int i = r->level - 1; i >= 0 && traversed < first; i--) {
+        while (x->links[i].next && traversed + x->links[i].span <= first) {
+            traversed += x->links[i].span;
+            x = x->links[i].next;
+        }
+    }
+    for (long rank = first; x && rank < first + count; rank++, x = x->links[0].next)
+        fn(rank, x->username, x->score, x->timestamp, ctx);
+}
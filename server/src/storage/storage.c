@@ -1,169 +1,423 @@
 #include "storage.h"
 #include "cJSON.h"
-#include <dirent.h>
+#include "config.h"
+#include "journal.h"
+#include "json_arena.h"
+#include "json_keys.h"
+#include "password.h"
+#include "qbk.h"
+#include "request.h"
+#include "storage_engine.h"
+#include "trace.h"
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
-#define MAX_USERS 100
 #define MAX_NAME_LEN 32
-#define MAX_PASS_LEN 32
 #define MAX_ROLE_LEN 16
-#define MAX_LINE_LEN 128
-#define DEFAUlT_USER_FILE "data/users.txt"
-#define ROOMS_FILE "data/rooms.json"
-#define QUESTION_BANK_DIR "data/questions/"
 
 typedef struct
 {
     char username[MAX_NAME_LEN];
-    char password[MAX_PASS_LEN];
+    char password[PASSWORD_HASH_MAX]; // hashed, or plaintext from an old file
     char role[MAX_ROLE_LEN];
 } User;
 
-static User users[MAX_USERS];
+// Users live in a dense array in file order. The index is an open-addressing
+// table of {hash, position} slots with linear probing, kept at most half
+// full, so a lookup scans a few adjacent 8-byte slots and touches a record
+// only when the full hash matches.
+typedef struct
+{
+    unsigned int hash;
+    int pos; // -1 = empty
+} UserSlot;
+
+// A user changed since the last snapshot, by array position. Positions
+// only move when the whole table is cleared, which clears this too.
+typedef struct
+{
+    int pos;
+    uint64_t lsn;
+} PendingUser;
+
+static User* users;
 static int user_count = 0;
-static const char* user_file_path = DEFAUlT_USER_FILE;
+static int user_cap;
+static UserSlot* user_index;
+static unsigned int user_index_cap; // power of two
+static PendingUser* pending_users;
+static int pending_user_count;
+static int pending_user_cap;
+static long bank_cache_budget = 64 * 1024 * 1024; // QUIZZIE_BANK_CACHE_BYTES
+
+#ifdef QUIZZIE_SQLITE
+static const StorageEngine* const engines[] = { &storage_engine_files, &storage_engine_paged, &storage_engine_sqlite };
+static const StorageEngine* engine = &storage_engine_sqlite;
+#else
+static const StorageEngine* const engines[] = { &storage_engine_files, &storage_engine_paged };
+static const StorageEngine* engine = &storage_engine_files;
+#endif
+
+static void note_journaled(void);
+static uint64_t journal_json(int type, cJSON* record);
+static void open_journal(void);
+static void clear_users(void);
+static int add_user_batch(const StorageUser* batch, int count, int expected, void* ctx);
+static int load_engine_rooms(void);
+
+static void select_engine(void)
+{
+    const char* name = config_get_str("QUIZZIE_STORAGE_ENGINE", engine->name);
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        if (strcmp(engines[i]->name, name) == 0) {
+            engine = engines[i];
+            return;
+        }
+    }
+    printf("Unknown storage engine %s, using %s\n", name, engine->name);
+}
 
 void storage_init()
 {
-    user_count = 0;
-
-    // Ensure directories exist
-    mkdir("data", 0777);
-    mkdir(QUESTION_BANK_DIR, 0777);
+    select_engine();
+    if (engine->open() != 0) {
+        printf("Could not open the %s storage engine\n", engine->name);
+        exit(1);
+    }
 
-    if (storage_load_users(user_file_path) < 0) {
-        printf("Failed to load users from %s\n", user_file_path);
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    clear_users();
+    if (engine->load_users(add_user_batch, NULL) < 0) {
+        printf("Failed to load users from the %s storage engine\n", engine->name);
     } else {
-        printf("Loaded %d users.\n", user_count);
+        clock_gettime(CLOCK_MONOTONIC, &finished);
+        double ms = (finished.tv_sec - started.tv_sec) * 1e3 + (finished.tv_nsec - started.tv_nsec) / 1e6;
+        printf("Loaded %d users in %.1f ms.\n", user_count, ms);
     }
+
+    bank_cache_budget = config_get_long("QUIZZIE_BANK_CACHE_BYTES", bank_cache_budget);
+
+    printf("Loaded %d rooms from the %s storage engine.\n", load_engine_rooms(), engine->name);
+    open_journal();
 }
 
-int storage_load_users(const char* filename)
+static int find_user_hashed(const char* username, unsigned int hash)
 {
-    FILE* f = fopen(filename, "r");
-    if (!f)
+    if (!user_index)
         return -1;
+    unsigned int mask = user_index_cap - 1;
+    for (unsigned int slot = hash & mask; user_index[slot].pos >= 0; slot = (slot + 1) & mask) {
+        if (user_index[slot].hash == hash && strcmp(users[user_index[slot].pos].username, username) == 0)
+            return user_index[slot].pos;
+    }
+    return -1;
+}
 
-    char line[MAX_LINE_LEN];
-    while (fgets(line, sizeof(line), f)) {
-        if (user_count >= MAX_USERS)
-            break;
+static int find_user(const char* username)
+{
+    return find_user_hashed(username, cJSON_HashKey(username));
+}
 
-        // Remove newline
-        line[strcspn(line, "\r\n")] = 0;
+static void index_user(unsigned int hash, int pos)
+{
+    unsigned int mask = user_index_cap - 1;
+    unsigned int slot = hash & mask;
+    while (user_index[slot].pos >= 0)
+        slot = (slot + 1) & mask;
+    user_index[slot].hash = hash;
+    user_index[slot].pos = pos;
+}
 
-        char* user = strtok(line, ":");
-        char* pass = strtok(NULL, ":");
-        char* role = strtok(NULL, ":");
+// Sizes the array and index for `count` users, so loading a file grows them once
+static int reserve_users(int count)
+{
+    if (count > user_cap) {
+        int cap = user_cap ? user_cap : 128;
+        while (cap < count)
+            cap *= 2;
+        User* grown = realloc(users, cap * sizeof(User));
+        if (!grown)
+            return -1;
+        users = grown;
+        user_cap = cap;
+    }
 
-        if (user && pass) {
-            strncpy(users[user_count].username, user, MAX_NAME_LEN - 1);
-            users[user_count].username[MAX_NAME_LEN - 1] = '\0';
+    if ((unsigned int)count * 2 > user_index_cap) {
+        unsigned int cap = user_index_cap ? user_index_cap : 256;
+        while (cap < (unsigned int)count * 2)
+            cap *= 2;
+        UserSlot* index = malloc(cap * sizeof(UserSlot));
+        if (!index)
+            return -1;
+        memset(index, 0xff, cap * sizeof(UserSlot));
+        UserSlot* old = user_index;
+        unsigned int old_cap = user_index_cap;
+        user_index = index;
+        user_index_cap = cap;
+        // Hashes are kept in the slots, so growing never rehashes a username
+        for (unsigned int i = 0; i < old_cap; i++) {
+            if (old[i].pos >= 0)
+                index_user(old[i].hash, old[i].pos);
+        }
+        free(old);
+    }
+    return 0;
+}
 
-            strncpy(users[user_count].password, pass, MAX_PASS_LEN - 1);
-            users[user_count].password[MAX_PASS_LEN - 1] = '\0';
+static void copy_field(char* dst, size_t size, const char* src, size_t len)
+{
+    if (len > size - 1)
+        len = size - 1;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
 
-            if (role) {
-                strncpy(users[user_count].role, role, MAX_ROLE_LEN - 1);
-                users[user_count].role[MAX_ROLE_LEN - 1] = '\0';
-            } else {
-                strcpy(users[user_count].role, "participant");
-            }
+static void fill_user(User* user, const char* username, size_t username_len, const char* password,
+                      size_t password_len, const char* role, size_t role_len)
+{
+    copy_field(user->username, sizeof(user->username), username, username_len);
+    copy_field(user->password, sizeof(user->password), password, password_len);
+    if (role && role_len)
+        copy_field(user->role, sizeof(user->role), role, role_len);
+    else
+        strcpy(user->role, "participant");
+}
 
-            user_count++;
-        }
+// Indexes the record already written to users[user_count]. A later line for a
+// known username replaces its password and role, so changes are appended.
+static void commit_user(unsigned int hash)
+{
+    int pos = find_user_hashed(users[user_count].username, hash);
+    if (pos >= 0) {
+        users[pos] = users[user_count];
+        return;
     }
-    fclose(f);
+    index_user(hash, user_count);
+    user_count++;
+}
+
+static int reserve_pending_user(void)
+{
+    if (pending_user_count < pending_user_cap)
+        return 0;
+    int cap = pending_user_cap ? pending_user_cap * 2 : 64;
+    PendingUser* grown = realloc(pending_users, cap * sizeof(PendingUser));
+    if (!grown)
+        return -1;
+    pending_users = grown;
+    pending_user_cap = cap;
     return 0;
 }
 
-int storage_check_credentials(const char* username, const char* password)
+// Room was reserved by reserve_pending_user
+static void add_pending_user(int pos, uint64_t lsn)
 {
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0 && strcmp(users[i].password, password) == 0) {
-            return 1;
-        }
+    pending_users[pending_user_count].pos = pos;
+    pending_users[pending_user_count].lsn = lsn;
+    pending_user_count++;
+}
+
+static void drop_pending_users(uint64_t upto_lsn)
+{
+    int kept = 0;
+    for (int i = 0; i < pending_user_count; i++) {
+        if (pending_users[i].lsn > upto_lsn)
+            pending_users[kept++] = pending_users[i];
     }
-    return 0;
+    pending_user_count = kept;
 }
 
-int storage_user_exists(const char* username)
+static uint64_t journal_user(const User* user)
 {
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            return 1;
-        }
+    cJSON* record = cJSON_CreateObject();
+    cJSON_AddStringToObject(record, JSON_KEY_USERNAME, user->username);
+    cJSON_AddStringToObject(record, JSON_KEY_PASSWORD, user->password);
+    cJSON_AddStringToObject(record, JSON_KEY_ROLE, user->role);
+    return journal_json(JOURNAL_USER_PUT, record);
+}
+
+static void clear_users(void)
+{
+    user_count = 0;
+    pending_user_count = 0;
+    if (user_index)
+        memset(user_index, 0xff, user_index_cap * sizeof(UserSlot));
+}
+
+// Users arrive from the engine in batches whose index slots are prefetched
+// before any of them is inserted, so the cache misses of a batch overlap.
+// The engine's expected total sizes the table once.
+static int add_user_batch(const StorageUser* batch, int count, int expected, void* ctx)
+{
+    (void)ctx;
+    User parsed[STORAGE_USER_BATCH];
+    unsigned int hashes[STORAGE_USER_BATCH];
+    if (count > STORAGE_USER_BATCH || reserve_users(expected > user_count + count ? expected : user_count + count) != 0)
+        return -1;
+    for (int i = 0; i < count; i++) {
+        const StorageUser* u = &batch[i];
+        fill_user(&parsed[i], u->name, u->name_len, u->password, u->password_len, u->role, u->role_len);
+        hashes[i] = cJSON_HashKey(parsed[i].username);
+        __builtin_prefetch(&user_index[hashes[i] & (user_index_cap - 1)]);
+    }
+    for (int i = 0; i < count; i++) {
+        users[user_count] = parsed[i];
+        commit_user(hashes[i]);
     }
     return 0;
 }
 
+// Replaces the users in memory with a users.txt-format file's
+int storage_load_users(const char* filename)
+{
+    clear_users();
+    return storage_file_scan_users(filename, add_user_batch, NULL);
+}
+
+const char* storage_get_password(const char* username)
+{
+    int pos = find_user(username);
+    return pos >= 0 ? users[pos].password : NULL;
+}
+
+// User changes are journaled and reach the engine with the next snapshot
+int storage_set_password(const char* username, const char* password)
+{
+    int pos = find_user(username);
+    if (pos < 0 || reserve_pending_user() != 0)
+        return -1;
+    User changed = users[pos];
+    copy_field(changed.password, sizeof(changed.password), password, strlen(password));
+    uint64_t lsn = journal_user(&changed);
+    if (!lsn)
+        return -3;
+    users[pos] = changed;
+    add_pending_user(pos, lsn);
+    return 0;
+}
+
+int storage_user_exists(const char* username)
+{
+    return find_user(username) >= 0;
+}
+
 const char* storage_get_role(const char* username)
 {
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            return users[i].role;
-        }
-    }
-    return "participant";
+    int pos = find_user(username);
+    return pos >= 0 ? users[pos].role : "participant";
 }
 
 int storage_add_user(const char* username, const char* password, const char* role)
 {
-    if (user_count >= MAX_USERS)
-        return -1;
-    if (storage_user_exists(username))
+    if (find_user(username) >= 0)
         return -2;
+    if (reserve_users(user_count + 1) != 0 || reserve_pending_user() != 0)
+        return -1;
+    User* user = &users[user_count];
+    fill_user(user, username, strlen(username), password, strlen(password), role, role ? strlen(role) : 0);
+    uint64_t lsn = journal_user(user);
+    if (!lsn)
+        return -3;
+    add_pending_user(user_count, lsn);
+    commit_user(cJSON_HashKey(user->username));
+    return 0;
+}
 
-    strncpy(users[user_count].username, username, MAX_NAME_LEN - 1);
-    users[user_count].username[MAX_NAME_LEN - 1] = '\0';
-
-    strncpy(users[user_count].password, password, MAX_PASS_LEN - 1);
-    users[user_count].password[MAX_PASS_LEN - 1] = '\0';
+// Replays a journaled user over whatever the engine loaded
+static void apply_user_put(const UserRecord* record, uint64_t lsn)
+{
+    if (reserve_users(user_count + 1) != 0 || reserve_pending_user() != 0)
+        return;
+    User* user = &users[user_count];
+    fill_user(user, record->username, strlen(record->username), record->password, strlen(record->password),
+              record->role, record->role ? strlen(record->role) : 0);
+    unsigned int hash = cJSON_HashKey(user->username);
+    int pos = find_user_hashed(user->username, hash);
+    add_pending_user(pos >= 0 ? pos : user_count, lsn);
+    commit_user(hash);
+}
 
-    if (role) {
-        strncpy(users[user_count].role, role, MAX_ROLE_LEN - 1);
-        users[user_count].role[MAX_ROLE_LEN - 1] = '\0';
-    } else {
-        strcpy(users[user_count].role, "participant");
-    }
+// Room Management
+//
+// Rooms are served from memory: an array in insertion order (the order
+// LIST_ROOMS returns) plus an open-addressing index from id to array
+// position. Every mutation is first appended to the journal, so its cost is
+// one sequential write; the snapshot files are rewritten by compaction.
+
+static Room* rooms;
+static int room_count;
+static int room_cap;
+static int* room_index; // array positions, -1 = empty slot
+static int room_index_cap; // power of two, kept at least twice room_count
+
+// Bumped on every change to the room list so callers can cache what they derive from it
+static unsigned long rooms_version = 1;
+
+unsigned long storage_rooms_version(void)
+{
+    return rooms_version;
+}
 
-    user_count++;
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    // Append to file
-    FILE* f = fopen(user_file_path, "a");
-    if (f) {
-        fprintf(f, "%s:%s:%s\n", username, password, users[user_count - 1].role);
-        fclose(f);
-        return 0;
+// Keeps the first room for an id, matching the old first-match lookups
+static void index_room(int pos)
+{
+    unsigned int mask = room_index_cap - 1;
+    unsigned int slot = cJSON_HashKey(rooms[pos].id) & mask;
+    while (room_index[slot] >= 0) {
+        if (strcmp(rooms[room_index[slot]].id, rooms[pos].id) == 0)
+            return;
+        slot = (slot + 1) & mask;
     }
-    return -3;
+    room_index[slot] = pos;
 }
 
-// Room Management
-int storage_save_room(const Room* room)
+static void rebuild_room_index(void)
 {
-    cJSON* root = NULL;
-    FILE* f = fopen(ROOMS_FILE, "r");
-    if (f) {
-        fseek(f, 0, SEEK_END);
-        long len = ftell(f);
-        fseek(f, 0, SEEK_SET);
-        char* data = malloc(len + 1);
-        fread(data, 1, len, f);
-        data[len] = '\0';
-        fclose(f);
-        root = cJSON_Parse(data);
-        free(data);
+    int cap = room_index_cap ? room_index_cap : 128;
+    while (cap < room_count * 2)
+        cap *= 2;
+    if (cap != room_index_cap) {
+        int* index = realloc(room_index, cap * sizeof(int));
+        if (!index)
+            return; // the old index stays valid for the rooms it covers
+        room_index = index;
+        room_index_cap = cap;
     }
+    memset(room_index, 0xff, room_index_cap * sizeof(int));
+    for (int i = 0; i < room_count; i++)
+        index_room(i);
+}
 
-    if (!root) {
-        root = cJSON_CreateArray();
+static int find_room(const char* room_id)
+{
+    if (!room_index_cap)
+        return -1;
+    unsigned int mask = room_index_cap - 1;
+    unsigned int slot = cJSON_HashKey(room_id) & mask;
+    while (room_index[slot] >= 0) {
+        if (strcmp(rooms[room_index[slot]].id, room_id) == 0)
+            return room_index[slot];
+        slot = (slot + 1) & mask;
     }
+    return -1;
+}
 
+cJSON* storage_room_to_json(const Room* room)
+{
     cJSON* room_obj = cJSON_CreateObject();
     cJSON_AddStringToObject(room_obj, "id", room->id);
     cJSON_AddStringToObject(room_obj, "name", room->name);
@@ -173,346 +427,1449 @@ int storage_save_room(const Room* room)
     cJSON_AddStringToObject(room_obj, "status", room->status);
     cJSON_AddNumberToObject(room_obj, "num_questions", room->num_questions);
     cJSON_AddNumberToObject(room_obj, "allowed_attempts", room->allowed_attempts);
+    return room_obj;
+}
 
-    cJSON_AddItemToArray(root, room_obj);
-
-    char* json_str = cJSON_Print(root);
-    f = fopen(ROOMS_FILE, "w");
-    if (f) {
-        fprintf(f, "%s", json_str);
-        fclose(f);
-        free(json_str);
-        cJSON_Delete(root);
+// In-memory half of a room write, shared by callers and journal replay
+static int apply_room_put(const Room* room)
+{
+    int pos = find_room(room->id);
+    if (pos >= 0) {
+        rooms[pos] = *room;
+        rooms_version++;
         return 0;
     }
 
-    free(json_str);
-    cJSON_Delete(root);
-    return -1;
+    if (room_count == room_cap) {
+        int cap = room_cap ? room_cap * 2 : 64;
+        Room* grown = realloc(rooms, cap * sizeof(Room));
+        if (!grown)
+            return -1;
+        rooms = grown;
+        room_cap = cap;
+    }
+    rooms[room_count] = *room;
+    room_count++;
+    if (room_count * 2 > room_index_cap) {
+        rebuild_room_index();
+        if (room_count * 2 > room_index_cap) {
+            room_count--;
+            return -1;
+        }
+    } else {
+        index_room(room_count - 1);
+    }
+    rooms_version++;
+    return 0;
+}
+
+static int apply_room_delete(const char* room_id)
+{
+    // Like the file-backed version, every room carrying the id goes
+    int kept = 0;
+    for (int i = 0; i < room_count; i++) {
+        if (strcmp(rooms[i].id, room_id) != 0)
+            rooms[kept++] = rooms[i];
+    }
+    if (kept == room_count)
+        return -1;
+    room_count = kept;
+    rebuild_room_index();
+    rooms_version++;
+    return 0;
+}
+
+static uint64_t journal_json(int type, cJSON* record)
+{
+    char* payload = cJSON_PrintUnformatted(record);
+    uint64_t lsn = payload ? journal_append(type, payload, strlen(payload)) : 0;
+    cJSON_free(payload);
+    json_release(record);
+    if (lsn)
+        note_journaled();
+    return lsn;
+}
+
+static void clear_rooms(void)
+{
+    room_count = 0;
+    rebuild_room_index();
+    rooms_version++;
+}
+
+static void add_loaded_room(const Room* room, void* ctx)
+{
+    (void)ctx;
+    apply_room_put(room);
+}
+
+static int load_engine_rooms(void)
+{
+    clear_rooms();
+    engine->load_rooms(add_loaded_room, NULL);
+    return room_count;
+}
+
+int storage_load_rooms(const char* filename)
+{
+    clear_rooms();
+    if (storage_file_scan_rooms(filename, add_loaded_room, NULL) != 0)
+        return -1;
+    return room_count;
+}
+
+int storage_room_exists(const char* room_id)
+{
+    return find_room(room_id) >= 0;
+}
+
+int storage_save_room(const Room* room)
+{
+    if (!journal_json(JOURNAL_ROOM_PUT, storage_room_to_json(room)))
+        return -1;
+    return apply_room_put(room);
 }
 
 int storage_get_rooms(cJSON* rooms_array)
 {
-    FILE* f = fopen(ROOMS_FILE, "r");
-    if (!f)
+    for (int i = 0; i < room_count; i++)
+        cJSON_AddItemToArray(rooms_array, storage_room_to_json(&rooms[i]));
+    return 0;
+}
+
+// Positions of the rooms ordered by start_time, then id; rebuilt on the
+// first page query after the room list changes, which is rare next to reads
+static int* rooms_by_start;
+static int rooms_by_start_cap;
+static unsigned long rooms_by_start_version;
+
+static int compare_room_key(const Room* room, long start_time, const char* id)
+{
+    if (room->start_time != start_time)
+        return room->start_time < start_time ? -1 : 1;
+    return strcmp(room->id, id);
+}
+
+static int compare_rooms_by_start(const void* a, const void* b)
+{
+    const Room* rb = &rooms[*(const int*)b];
+    return compare_room_key(&rooms[*(const int*)a], rb->start_time, rb->id);
+}
+
+static int sort_rooms_by_start(void)
+{
+    if (rooms_by_start_version == rooms_version)
+        return 0;
+    if (room_count > rooms_by_start_cap) {
+        int cap = rooms_by_start_cap ? rooms_by_start_cap : 64;
+        while (cap < room_count)
+            cap *= 2;
+        int* grown = realloc(rooms_by_start, cap * sizeof(int));
+        if (!grown)
+            return -1;
+        rooms_by_start = grown;
+        rooms_by_start_cap = cap;
+    }
+    for (int i = 0; i < room_count; i++)
+        rooms_by_start[i] = i;
+    qsort(rooms_by_start, room_count, sizeof(int), compare_rooms_by_start);
+    rooms_by_start_version = rooms_version;
+    return 0;
+}
+
+// First index in rooms_by_start whose key is above (start_time, id), or at least start_time when id is NULL
+static int rooms_by_start_after(long start_time, const char* id)
+{
+    int lo = 0, hi = room_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        const Room* room = &rooms[rooms_by_start[mid]];
+        int below = id ? compare_room_key(room, start_time, id) <= 0 : room->start_time < start_time;
+        if (below)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int storage_list_rooms_page(const RoomPageQuery* query, StorageRoomFn fn, void* ctx, char next[STORAGE_CURSOR_SIZE])
+{
+    next[0] = '\0';
+    if (query->limit <= 0)
         return 0;
+    if (sort_rooms_by_start() != 0)
+        return -1;
+
+    int i = rooms_by_start_after(query->from, NULL);
+    if (query->cursor) {
+        // "<start_time>:<id>" of the last room sent
+        char* end;
+        long start_time = strtol(query->cursor, &end, 10);
+        if (end == query->cursor || *end != ':')
+            return -1;
+        int after = rooms_by_start_after(start_time, end + 1);
+        if (after > i)
+            i = after;
+    }
 
-    fseek(f, 0, SEEK_END);
-    long len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char* data = malloc(len + 1);
-    fread(data, 1, len, f);
-    data[len] = '\0';
-    fclose(f);
-
-    cJSON* root = cJSON_Parse(data);
-    free(data);
-
-    if (root && cJSON_IsArray(root)) {
-        cJSON* item = NULL;
-        cJSON_ArrayForEach(item, root)
-        {
-            cJSON_AddItemToArray(rooms_array, cJSON_Duplicate(item, 1));
+    int sent = 0;
+    const Room* last = NULL;
+    for (; i < room_count; i++) {
+        const Room* room = &rooms[rooms_by_start[i]];
+        if (query->to && room->start_time >= query->to)
+            break;
+        if (query->status && strcmp(room->status, query->status) != 0)
+            continue;
+        if (sent == query->limit) {
+            snprintf(next, STORAGE_CURSOR_SIZE, "%ld:%s", last->start_time, last->id);
+            break;
         }
+        fn(room, ctx);
+        last = room;
+        sent++;
     }
+    return 0;
+}
 
-    cJSON_Delete(root);
+cJSON* storage_get_room(const char* room_id)
+{
+    int pos = find_room(room_id);
+    return pos >= 0 ? storage_room_to_json(&rooms[pos]) : NULL;
+}
+
+int storage_get_room_info(const char* room_id, Room* room)
+{
+    int pos = find_room(room_id);
+    if (pos < 0)
+        return -1;
+    *room = rooms[pos];
     return 0;
 }
 
+int storage_update_room_status(const char* room_id, const char* status)
+{
+    int pos = find_room(room_id);
+    if (pos < 0)
+        return -1;
+    Room room = rooms[pos];
+    strncpy(room.status, status, sizeof(room.status) - 1);
+    room.status[sizeof(room.status) - 1] = '\0';
+    return storage_save_room(&room);
+}
+
+int storage_delete_room(const char* room_id)
+{
+    if (find_room(room_id) < 0)
+        return -1;
+    cJSON* record = cJSON_CreateObject();
+    cJSON_AddStringToObject(record, "id", room_id);
+    if (!journal_json(JOURNAL_ROOM_DELETE, record))
+        return -1;
+    return apply_room_delete(room_id);
+}
+
 // Question Management
-int storage_save_question_bank(const char* bank_name, cJSON* questions)
+//
+// Banks are stored by the engine in the .qbk format (see qbk.h) and served
+// from an LRU cache of what it loaded (a read-only mapping for the files
+// engine), bounded by QUIZZIE_BANK_CACHE_BYTES. Grading and single
+// questions read the bank in place; the JSON export the editor asks for is
+// built on first use and cached with the entry. Saving or deleting a bank
+// drops its entry; where banks can change behind our back the engine's
+// bank_is_current notices and the bank is loaded again. The loop is single
+// threaded, so when a room starts the first request loads the bank and
+// everyone queued behind it in the same poll round hits the entry.
+//
+// Saves and deletes are journaled like rooms. Until a snapshot hands a
+// change to the engine it is kept as a pending bank, whose bytes the cache
+// serves in place of the engine's.
+
+#define BANK_CACHE_BUCKETS 256
+
+typedef struct BankEntry
 {
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s%s.json", QUESTION_BANK_DIR, bank_name);
+    char id[256];
+    unsigned int hash;
+    StorageBank stored;
+    QbkView view;
+    char* json; // export, NULL until requested
+    size_t json_len;
+    size_t bytes; // charged against the budget
+    int pending; // stored borrows a pending bank's bytes rather than the engine's
+    struct BankEntry* prev; // LRU list, most recently used first
+    struct BankEntry* next;
+    struct BankEntry* hash_next;
+} BankEntry;
 
-    char* json_str = cJSON_Print(questions);
-    FILE* f = fopen(filepath, "w");
-    if (f) {
-        fprintf(f, "%s", json_str);
-        fclose(f);
-        free(json_str);
-        return 0;
+typedef struct
+{
+    char id[256];
+    char* data; // qbk bytes, NULL = deleted
+    size_t size;
+    uint64_t lsn;
+} PendingBank;
+
+static BankEntry* bank_buckets[BANK_CACHE_BUCKETS];
+static BankEntry* bank_lru_head;
+static BankEntry* bank_lru_tail;
+static size_t bank_cache_bytes;
+static int bank_cache_entries;
+static struct
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long reloads; // entry found stale in the engine
+    unsigned long evictions;
+} bank_cache_stats;
+// Few banks change between snapshots, so a scan finds them
+static PendingBank* pending_banks;
+static int pending_bank_count;
+static int pending_bank_cap;
+
+static PendingBank* find_pending_bank(const char* bank_id)
+{
+    for (int i = 0; i < pending_bank_count; i++) {
+        if (strcmp(pending_banks[i].id, bank_id) == 0)
+            return &pending_banks[i];
     }
-    free(json_str);
-    return -1;
+    return NULL;
 }
 
-int storage_list_question_banks(cJSON* banks_array)
+static BankEntry* find_bank_entry(const char* bank_id, unsigned int hash)
 {
-    DIR* d;
-    struct dirent* dir;
-    d = opendir(QUESTION_BANK_DIR);
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (strstr(dir->d_name, ".json")) {
-                char bank_id[256];
-                strncpy(bank_id, dir->d_name, sizeof(bank_id));
-                // remove extension
-                char* ext = strstr(bank_id, ".json");
-                if (ext)
-                    *ext = '\0';
-
-                cJSON_AddItemToArray(banks_array, cJSON_CreateString(bank_id));
-            }
-        }
-        closedir(d);
-        return 0;
+    for (BankEntry* e = bank_buckets[hash % BANK_CACHE_BUCKETS]; e; e = e->hash_next) {
+        if (e->hash == hash && strcmp(e->id, bank_id) == 0)
+            return e;
     }
-    return -1;
+    return NULL;
 }
 
-int storage_get_question_bank(const char* bank_id, cJSON** questions)
+static void lru_unlink(BankEntry* e)
 {
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s%s.json", QUESTION_BANK_DIR, bank_id);
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        bank_lru_head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        bank_lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
 
-    FILE* f = fopen(filepath, "r");
-    if (!f)
-        return -1;
+static void lru_push_front(BankEntry* e)
+{
+    e->next = bank_lru_head;
+    if (bank_lru_head)
+        bank_lru_head->prev = e;
+    bank_lru_head = e;
+    if (!bank_lru_tail)
+        bank_lru_tail = e;
+}
 
-    fseek(f, 0, SEEK_END);
-    long len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char* data = malloc(len + 1);
-    fread(data, 1, len, f);
-    data[len] = '\0';
-    fclose(f);
+static void drop_bank_entry(BankEntry* e)
+{
+    BankEntry** link = &bank_buckets[e->hash % BANK_CACHE_BUCKETS];
+    while (*link != e)
+        link = &(*link)->hash_next;
+    *link = e->hash_next;
+    lru_unlink(e);
+    bank_cache_bytes -= e->bytes;
+    bank_cache_entries--;
+    if (!e->pending)
+        engine->release_bank(&e->stored);
+    free(e->json);
+    free(e);
+}
 
-    *questions = cJSON_Parse(data);
-    free(data);
+static void invalidate_question_bank(const char* bank_id)
+{
+    BankEntry* e = find_bank_entry(bank_id, cJSON_HashKey(bank_id));
+    if (e)
+        drop_bank_entry(e);
+}
 
-    return (*questions) ? 0 : -1;
+// The newest entry stays even if it alone is over budget, callers hold a view of it
+static void evict_banks(const BankEntry* keep)
+{
+    while (bank_cache_bytes > (size_t)bank_cache_budget && bank_lru_tail && bank_lru_tail != keep) {
+        drop_bank_entry(bank_lru_tail);
+        bank_cache_stats.evictions++;
+    }
 }
 
-int storage_update_question_bank(const char* bank_id, cJSON* questions)
+static BankEntry* load_bank_entry(const char* bank_id, unsigned int hash)
 {
-    return storage_save_question_bank(bank_id, questions);
+    const PendingBank* p = find_pending_bank(bank_id);
+    StorageBank stored = { 0 };
+    if (p) {
+        stored.data = p->data;
+        stored.size = p->size;
+    } else if (engine->load_bank(bank_id, &stored) != 0) {
+        return NULL;
+    }
+
+    BankEntry* e = calloc(1, sizeof(BankEntry));
+    if (!e || qbk_view_open(&e->view, stored.data, stored.size) != 0) {
+        fprintf(stderr, "Question bank %s is not a valid qbk bank\n", bank_id);
+        if (!p)
+            engine->release_bank(&stored);
+        free(e);
+        return NULL;
+    }
+    snprintf(e->id, sizeof(e->id), "%s", bank_id);
+    e->hash = hash;
+    e->stored = stored;
+    e->pending = p != NULL;
+    e->bytes = sizeof(BankEntry) + stored.size;
+    return e;
 }
 
-int storage_delete_question_bank(const char* bank_id)
+// An entry is dropped whenever its pending bank changes or goes, so a pending entry is always current
+static BankEntry* acquire_bank_entry(const char* bank_id)
 {
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s%s.json", QUESTION_BANK_DIR, bank_id);
-    if (remove(filepath) == 0) {
-        return 0;
+    const PendingBank* p = find_pending_bank(bank_id);
+    if (p && !p->data)
+        return NULL;
+    unsigned int hash = cJSON_HashKey(bank_id);
+    BankEntry* e = find_bank_entry(bank_id, hash);
+
+    if (e && (e->pending || !engine->bank_is_current || engine->bank_is_current(bank_id, &e->stored))) {
+        bank_cache_stats.hits++;
+        lru_unlink(e);
+        lru_push_front(e);
+        return e;
     }
-    return -1;
+
+    if (e) {
+        bank_cache_stats.reloads++;
+        drop_bank_entry(e);
+    }
+    bank_cache_stats.misses++;
+    e = load_bank_entry(bank_id, hash);
+    if (!e)
+        return NULL;
+    BankEntry** bucket = &bank_buckets[hash % BANK_CACHE_BUCKETS];
+    e->hash_next = *bucket;
+    *bucket = e;
+    lru_push_front(e);
+    bank_cache_bytes += e->bytes;
+    bank_cache_entries++;
+    evict_banks(e);
+    return e;
 }
 
-// Room updates
-int storage_update_room_status(const char* room_id, const char* status)
+int storage_get_question_bank(const char* bank_id, QbkView* bank)
 {
-    // Naive implementation: Load all, find, update, save all.
-    // Ideally use database or individual files.
-    cJSON* root = NULL;
-    FILE* f = fopen(ROOMS_FILE, "r");
-    if (!f)
+    BankEntry* e = acquire_bank_entry(bank_id);
+    if (!e)
         return -1;
+    *bank = e->view;
+    return 0;
+}
 
-    fseek(f, 0, SEEK_END);
-    long len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char* data = malloc(len + 1);
-    fread(data, 1, len, f);
-    data[len] = '\0';
-    fclose(f);
-    root = cJSON_Parse(data);
-    free(data);
-
-    if (!root)
+int storage_export_question_bank(const char* bank_id, const char** json, size_t* len)
+{
+    BankEntry* e = acquire_bank_entry(bank_id);
+    if (!e)
         return -1;
 
-    int found = 0;
-    cJSON* item = NULL;
-    cJSON_ArrayForEach(item, root)
-    {
-        cJSON* id = cJSON_GetObjectItem(item, "id");
-        if (id && strcmp(id->valuestring, room_id) == 0) {
-            cJSON_ReplaceItemInObject(item, "status", cJSON_CreateString(status));
-            found = 1;
-            break;
+    if (!e->json) {
+        uint64_t span = trace_span_begin();
+        cJSON* questions = qbk_to_json(&e->view);
+        char* text = cJSON_PrintUnformatted(questions);
+        size_t text_len = text ? strlen(text) : 0;
+        e->json = text ? malloc(text_len + 1) : NULL;
+        if (e->json) {
+            memcpy(e->json, text, text_len + 1);
+            e->json_len = text_len;
+            e->bytes += text_len + 1;
+            bank_cache_bytes += text_len + 1;
         }
+        cJSON_free(text);
+        json_release(questions);
+        trace_span_end("storage.print", span);
+        if (!e->json)
+            return -1;
+        evict_banks(e);
+    }
+    *json = e->json;
+    *len = e->json_len;
+    return 0;
+}
+
+cJSON* storage_bank_cache_stats_to_json(void)
+{
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "entries", bank_cache_entries);
+    cJSON_AddNumberToObject(obj, "bytes", (double)bank_cache_bytes);
+    cJSON_AddNumberToObject(obj, "budget", (double)bank_cache_budget);
+    cJSON_AddNumberToObject(obj, "hits", (double)bank_cache_stats.hits);
+    cJSON_AddNumberToObject(obj, "misses", (double)bank_cache_stats.misses);
+    cJSON_AddNumberToObject(obj, "reloads", (double)bank_cache_stats.reloads);
+    cJSON_AddNumberToObject(obj, "evictions", (double)bank_cache_stats.evictions);
+    return obj;
+}
+
+// Makes room for one more pending bank, so a journaled change always has a place
+static int reserve_pending_bank(void)
+{
+    if (pending_bank_count < pending_bank_cap)
+        return 0;
+    int cap = pending_bank_cap ? pending_bank_cap * 2 : 16;
+    PendingBank* grown = realloc(pending_banks, cap * sizeof(PendingBank));
+    if (!grown)
+        return -1;
+    pending_banks = grown;
+    pending_bank_cap = cap;
+    return 0;
+}
+
+// Takes ownership of data (malloc'd, NULL = deleted), replacing any earlier
+// change; room was reserved by reserve_pending_bank
+static void set_pending_bank(const char* bank_id, char* data, size_t size, uint64_t lsn)
+{
+    PendingBank* p = find_pending_bank(bank_id);
+    if (!p) {
+        p = &pending_banks[pending_bank_count++];
+        snprintf(p->id, sizeof(p->id), "%s", bank_id);
+        p->data = NULL;
     }
+    invalidate_question_bank(bank_id);
+    free(p->data);
+    p->data = data;
+    p->size = size;
+    p->lsn = lsn;
+}
 
-    if (found) {
-        char* json_str = cJSON_Print(root);
-        f = fopen(ROOMS_FILE, "w");
-        if (f) {
-            fprintf(f, "%s", json_str);
-            fclose(f);
-            free(json_str);
-            cJSON_Delete(root);
-            return 0;
+static void drop_pending_banks(uint64_t upto_lsn)
+{
+    int kept = 0;
+    for (int i = 0; i < pending_bank_count; i++) {
+        PendingBank* p = &pending_banks[i];
+        if (p->lsn > upto_lsn) {
+            pending_banks[kept++] = *p;
+            continue;
         }
-        free(json_str);
+        // The engine has it now; the next use loads it from there
+        invalidate_question_bank(p->id);
+        free(p->data);
     }
-    cJSON_Delete(root);
-    return -1;
+    pending_bank_count = kept;
 }
 
-int storage_delete_room(const char* room_id)
+// The payload is the bank id, a NUL and the qbk bytes
+static uint64_t journal_bank_put(const char* bank_id, const char* data, size_t size)
 {
-    cJSON* root = NULL;
-    FILE* f = fopen(ROOMS_FILE, "r");
-    if (!f)
-        return -1;
+    size_t id_len = strlen(bank_id) + 1;
+    char* payload = malloc(id_len + size);
+    if (!payload)
+        return 0;
+    memcpy(payload, bank_id, id_len);
+    memcpy(payload + id_len, data, size);
+    uint64_t lsn = journal_append(JOURNAL_BANK_PUT, payload, id_len + size);
+    free(payload);
+    if (lsn)
+        note_journaled();
+    return lsn;
+}
 
-    fseek(f, 0, SEEK_END);
-    long len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char* data = malloc(len + 1);
-    fread(data, 1, len, f);
-    data[len] = '\0';
-    fclose(f);
-    root = cJSON_Parse(data);
-    free(data);
-
-    if (!root)
+int storage_save_question_bank(const char* bank_name, cJSON* questions)
+{
+    uint64_t span = trace_span_begin();
+    size_t size = 0;
+    char* data = qbk_encode(questions, &size);
+    trace_span_end("storage.print", span);
+    uint64_t lsn = data && reserve_pending_bank() == 0 ? journal_bank_put(bank_name, data, size) : 0;
+    if (!lsn) {
+        free(data);
         return -1;
+    }
+    set_pending_bank(bank_name, data, size, lsn);
+    return 0;
+}
 
-    cJSON* new_root = cJSON_CreateArray();
-    int found = 0;
-    cJSON* item = NULL;
-    cJSON_ArrayForEach(item, root)
-    {
-        cJSON* id = cJSON_GetObjectItem(item, "id");
-        if (id && strcmp(id->valuestring, room_id) == 0) {
-            found = 1;
-            // Skip adding to new root
-        } else {
-            cJSON_AddItemToArray(new_root, cJSON_Duplicate(item, 1));
-        }
+static void add_bank_name(const char* bank_id, void* ctx)
+{
+    if (!find_pending_bank(bank_id))
+        cJSON_AddItemToArray((cJSON*)ctx, cJSON_CreateString(bank_id));
+}
+
+int storage_list_question_banks(cJSON* banks_array)
+{
+    if (engine->list_banks(add_bank_name, banks_array) != 0)
+        return -1;
+    for (int i = 0; i < pending_bank_count; i++) {
+        if (pending_banks[i].data)
+            cJSON_AddItemToArray(banks_array, cJSON_CreateString(pending_banks[i].id));
     }
+    return 0;
+}
+
+int storage_update_question_bank(const char* bank_id, cJSON* questions)
+{
+    return storage_save_question_bank(bank_id, questions);
+}
+
+int storage_delete_question_bank(const char* bank_id)
+{
+    // Only existence is checked, so a bank that no longer loads can still go
+    const PendingBank* p = find_pending_bank(bank_id);
+    if (!(p ? p->data != NULL : engine->bank_exists(bank_id)) || reserve_pending_bank() != 0)
+        return -1;
+    uint64_t lsn = journal_append(JOURNAL_BANK_DELETE, bank_id, strlen(bank_id));
+    if (!lsn)
+        return -1;
+    note_journaled();
+    set_pending_bank(bank_id, NULL, 0, lsn);
+    return 0;
+}
+
+// Result Management
+//
+// Results are journaled and kept in memory per room until compaction hands
+// them to the engine. Each stored result carries its journal lsn as seq, so
+// readers and compaction skip pending results the engine already holds, and
+// replaying a record twice cannot duplicate it.
 
-    cJSON_Delete(root);
+typedef struct
+{
+    RoomResult result;
+    int next; // next pending result of the same room, -1 = last
+} PendingResult;
+
+typedef struct
+{
+    char room_id[32]; // "" = empty slot
+    int first;
+    int last;
+} PendingRoom;
+
+typedef struct
+{
+    char username[32];
+    int score;
+    long timestamp;
+    long seq;
+} IndexedResult;
 
-    if (found) {
-        char* json_str = cJSON_Print(new_root);
-        f = fopen(ROOMS_FILE, "w");
-        if (f) {
-            fprintf(f, "%s", json_str);
-            fclose(f);
-            free(json_str);
-            cJSON_Delete(new_root);
-            return 0;
+// A room's results in submission order, with their positions by score
+typedef struct
+{
+    IndexedResult* items;
+    int count;
+    int cap;
+    int* by_score; // score desc, then position
+} ResultList;
+
+typedef struct
+{
+    char username[32]; // "" = empty slot
+    int count;
+} AttemptSlot;
+
+// Results per user in a room, open addressing; users are never removed
+typedef struct
+{
+    AttemptSlot* slots;
+    int count;
+    int cap; // power of two
+    int failed; // a count was lost to allocation failure, the table is rebuilt
+} AttemptTable;
+
+// What storage keeps per room over its results, each built on first use
+typedef struct
+{
+    char room_id[32]; // "" = empty slot
+    RoomStats* stats; // on the heap so pointers survive growth
+    Ranking* ranking;
+    ResultList* list;
+    AttemptTable* attempts;
+} ResultIndex;
+
+static PendingResult* pending;
+static int pending_count;
+static int pending_cap;
+static PendingRoom* pending_rooms;
+static int pending_room_count;
+static int pending_room_cap; // power of two
+
+static PendingRoom* find_pending_room(const char* room_id, int create)
+{
+    if (create && (pending_room_count + 1) * 2 > pending_room_cap) {
+        int cap = pending_room_cap ? pending_room_cap * 2 : 64;
+        PendingRoom* slots = calloc(cap, sizeof(PendingRoom));
+        if (!slots)
+            return NULL;
+        for (int i = 0; i < pending_room_cap; i++) {
+            if (!pending_rooms[i].room_id[0])
+                continue;
+            unsigned int slot = cJSON_HashKey(pending_rooms[i].room_id) & (cap - 1);
+            while (slots[slot].room_id[0])
+                slot = (slot + 1) & (cap - 1);
+            slots[slot] = pending_rooms[i];
         }
-        free(json_str);
+        free(pending_rooms);
+        pending_rooms = slots;
+        pending_room_cap = cap;
     }
-    cJSON_Delete(new_root);
-    return -1;
+    if (!pending_room_cap)
+        return NULL;
+
+    unsigned int mask = pending_room_cap - 1;
+    unsigned int slot = cJSON_HashKey(room_id) & mask;
+    while (pending_rooms[slot].room_id[0]) {
+        if (strcmp(pending_rooms[slot].room_id, room_id) == 0)
+            return &pending_rooms[slot];
+        slot = (slot + 1) & mask;
+    }
+    if (!create)
+        return NULL;
+    PendingRoom* room = &pending_rooms[slot];
+    snprintf(room->room_id, sizeof(room->room_id), "%s", room_id);
+    room->first = room->last = -1;
+    pending_room_count++;
+    return room;
 }
 
-// Result Management
-#define RESULT_DIR "data/results/"
-
-int storage_save_result(const RoomResult* result)
-{
-    mkdir(RESULT_DIR, 0777);
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s%s.json", RESULT_DIR, result->room_id);
-
-    // Results per room are stored in a single JSON array file
-    cJSON* root = NULL;
-    FILE* f = fopen(filepath, "r");
-    if (f) {
-        fseek(f, 0, SEEK_END);
-        long len = ftell(f);
-        fseek(f, 0, SEEK_SET);
-        char* data = malloc(len + 1);
-        fread(data, 1, len, f);
-        data[len] = '\0';
-        fclose(f);
-        root = cJSON_Parse(data);
-        free(data);
+// Makes room for one more pending result in the room, so adding it cannot fail
+static PendingRoom* reserve_pending_result(const char* room_id)
+{
+    if (pending_count == pending_cap) {
+        int cap = pending_cap ? pending_cap * 2 : 256;
+        PendingResult* grown = realloc(pending, cap * sizeof(PendingResult));
+        if (!grown)
+            return NULL;
+        pending = grown;
+        pending_cap = cap;
     }
+    return find_pending_room(room_id, 1);
+}
 
-    if (!root) {
-        root = cJSON_CreateArray();
+static int add_pending_result(const RoomResult* result)
+{
+    PendingRoom* room = reserve_pending_result(result->room_id);
+    if (!room)
+        return -1;
+
+    pending[pending_count].result = *result;
+    pending[pending_count].next = -1;
+    if (room->last >= 0)
+        pending[room->last].next = pending_count;
+    else
+        room->first = pending_count;
+    room->last = pending_count;
+    pending_count++;
+    return 0;
+}
+
+// Forgets pending results a completed snapshot now holds
+static void drop_pending_results(uint64_t upto_lsn)
+{
+    PendingResult* old = pending;
+    int old_count = pending_count;
+
+    pending = NULL;
+    pending_count = pending_cap = 0;
+    free(pending_rooms);
+    pending_rooms = NULL;
+    pending_room_count = pending_room_cap = 0;
+
+    for (int i = 0; i < old_count; i++) {
+        if ((uint64_t)old[i].result.seq > upto_lsn)
+            add_pending_result(&old[i].result);
     }
+    free(old);
+}
 
+cJSON* storage_result_to_json(const RoomResult* result, int with_seq)
+{
     cJSON* res_obj = cJSON_CreateObject();
     cJSON_AddStringToObject(res_obj, "username", result->username);
     cJSON_AddNumberToObject(res_obj, "score", result->score);
     cJSON_AddNumberToObject(res_obj, "timestamp", result->timestamp);
+    if (with_seq && result->seq)
+        cJSON_AddNumberToObject(res_obj, "seq", result->seq);
+    return res_obj;
+}
 
-    cJSON_AddItemToArray(root, res_obj);
-
-    char* json_str = cJSON_Print(root);
-    f = fopen(filepath, "w");
-    if (f) {
-        fprintf(f, "%s", json_str);
-        fclose(f);
-        free(json_str);
-        cJSON_Delete(root);
-        return 0;
+// Stored results followed by the pending ones the file does not hold yet, up to upto_lsn
+static void for_each_result(const char* room_id, uint64_t upto_lsn, StorageResultFn fn, void* ctx)
+{
+    long stored_seq = engine->for_each_result(room_id, fn, ctx);
+    PendingRoom* room = find_pending_room(room_id, 0);
+    for (int i = room ? room->first : -1; i >= 0; i = pending[i].next) {
+        const RoomResult* result = &pending[i].result;
+        if (result->seq > stored_seq && (uint64_t)result->seq <= upto_lsn)
+            fn(result, ctx);
     }
-    free(json_str);
-    cJSON_Delete(root);
-    return -1;
+}
+
+static ResultIndex* find_result_index(const char* room_id, int create);
+static void add_to_stats(const RoomResult* result, void* ctx);
+static void add_to_list(ResultList* list, const RoomResult* result);
+static void add_attempt(const RoomResult* result, void* ctx);
+
+int storage_save_result(RoomResult* result)
+{
+    // Once journaled the result replays on restart, so nothing after may fail
+    if (!reserve_pending_result(result->room_id))
+        return -1;
+    cJSON* record = storage_result_to_json(result, 0);
+    cJSON_AddStringToObject(record, "room_id", result->room_id);
+    uint64_t lsn = journal_json(JOURNAL_RESULT_ADD, record);
+    if (!lsn)
+        return -1;
+
+    result->seq = (long)lsn;
+    add_pending_result(result);
+    // Rooms nobody asked about yet get their indexes on first query
+    ResultIndex* index = find_result_index(result->room_id, 0);
+    if (index && index->stats)
+        add_to_stats(result, index->stats);
+    if (index && index->ranking)
+        ranking_update(index->ranking, result->username, result->score, result->timestamp);
+    if (index && index->list)
+        add_to_list(index->list, result);
+    if (index && index->attempts)
+        add_attempt(result, index->attempts);
+    return 0;
+}
+
+static void add_result_to_array(const RoomResult* result, void* ctx)
+{
+    cJSON_AddItemToArray((cJSON*)ctx, storage_result_to_json(result, 0));
 }
 
 int storage_get_room_results(const char* room_id, cJSON* results_array)
 {
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "%s%s.json", RESULT_DIR, room_id);
-
-    FILE* f = fopen(filepath, "r");
-    if (!f)
-        return 0; // No results is fine
-
-    fseek(f, 0, SEEK_END);
-    long len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char* data = malloc(len + 1);
-    fread(data, 1, len, f);
-    data[len] = '\0';
-    fclose(f);
-
-    cJSON* root = cJSON_Parse(data);
-    free(data);
-
-    if (root && cJSON_IsArray(root)) {
-        cJSON* item;
-        cJSON_ArrayForEach(item, root)
-        {
-            cJSON_AddItemToArray(results_array, cJSON_Duplicate(item, 1));
+    for_each_result(room_id, UINT64_MAX, add_result_to_array, results_array);
+    return 0;
+}
+
+int storage_for_each_room_result(const char* room_id, StorageResultFn fn, void* ctx)
+{
+    for_each_result(room_id, UINT64_MAX, fn, ctx);
+    return 0;
+}
+
+// Per-room indexes: aggregates and the leaderboard, in one open-addressing
+// table that never shrinks. Results stay stored when a room is deleted, so
+// its indexes stay valid.
+
+static ResultIndex* result_indexes;
+static int result_index_count;
+static int result_index_cap; // power of two
+
+static ResultIndex* find_result_index(const char* room_id, int create)
+{
+    if (create && (result_index_count + 1) * 2 > result_index_cap) {
+        int cap = result_index_cap ? result_index_cap * 2 : 64;
+        ResultIndex* slots = calloc(cap, sizeof(ResultIndex));
+        if (!slots)
+            return NULL;
+        for (int i = 0; i < result_index_cap; i++) {
+            if (!result_indexes[i].room_id[0])
+                continue;
+            unsigned int slot = cJSON_HashKey(result_indexes[i].room_id) & (cap - 1);
+            while (slots[slot].room_id[0])
+                slot = (slot + 1) & (cap - 1);
+            slots[slot] = result_indexes[i];
         }
+        free(result_indexes);
+        result_indexes = slots;
+        result_index_cap = cap;
     }
-    cJSON_Delete(root);
-    return 0;
+    if (!result_index_cap)
+        return NULL;
+
+    unsigned int mask = result_index_cap - 1;
+    unsigned int slot = cJSON_HashKey(room_id) & mask;
+    while (result_indexes[slot].room_id[0]) {
+        if (strcmp(result_indexes[slot].room_id, room_id) == 0)
+            return &result_indexes[slot];
+        slot = (slot + 1) & mask;
+    }
+    if (!create)
+        return NULL;
+    ResultIndex* index = &result_indexes[slot];
+    snprintf(index->room_id, sizeof(index->room_id), "%s", room_id);
+    result_index_count++;
+    return index;
 }
 
-cJSON* storage_get_room(const char* room_id)
+static void add_to_stats(const RoomResult* result, void* ctx)
 {
-    FILE* f = fopen(ROOMS_FILE, "r");
-    if (!f)
+    RoomStats* stats = ctx;
+    int score = result->score;
+    if (stats->count == 0 || score < stats->min_score)
+        stats->min_score = score;
+    if (stats->count == 0 || score > stats->max_score)
+        stats->max_score = score;
+    stats->count++;
+    stats->sum += score;
+    stats->sum_squares += (double)score * score;
+    int slot = score < 0 ? 0 : score < ROOM_STATS_SCORE_SLOTS ? score : ROOM_STATS_SCORE_SLOTS - 1;
+    stats->histogram[slot]++;
+}
+
+const RoomStats* storage_get_room_stats(const char* room_id)
+{
+    // No result can name a room id that does not fit
+    static const RoomStats none;
+    if (strlen(room_id) >= sizeof(result_indexes->room_id))
+        return &none;
+
+    ResultIndex* index = find_result_index(room_id, 1);
+    if (!index)
         return NULL;
+    if (!index->stats) {
+        index->stats = calloc(1, sizeof(RoomStats));
+        if (!index->stats)
+            return NULL;
+        for_each_result(room_id, UINT64_MAX, add_to_stats, index->stats);
+    }
+    return index->stats;
+}
+
+static void add_to_ranking(const RoomResult* result, void* ctx)
+{
+    ranking_update(ctx, result->username, result->score, result->timestamp);
+}
 
-    fseek(f, 0, SEEK_END);
-    long len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char* data = malloc(len + 1);
-    fread(data, 1, len, f);
-    data[len] = '\0';
-    fclose(f);
+const Ranking* storage_get_room_ranking(const char* room_id)
+{
+    if (strlen(room_id) >= sizeof(result_indexes->room_id))
+        return NULL;
+    ResultIndex* index = find_result_index(room_id, 1);
+    if (!index)
+        return NULL;
+    if (!index->ranking) {
+        index->ranking = ranking_create();
+        if (!index->ranking)
+            return NULL;
+        for_each_result(room_id, UINT64_MAX, add_to_ranking, index->ranking);
+    }
+    return index->ranking;
+}
 
-    cJSON* root = cJSON_Parse(data);
-    free(data);
+static AttemptSlot* find_attempt_slot(const AttemptTable* table, const char* username)
+{
+    unsigned int mask = table->cap - 1;
+    unsigned int slot = cJSON_HashKey(username) & mask;
+    while (table->slots[slot].username[0] && strcmp(table->slots[slot].username, username) != 0)
+        slot = (slot + 1) & mask;
+    return &table->slots[slot];
+}
 
-    if (!root)
+static void add_attempt(const RoomResult* result, void* ctx)
+{
+    AttemptTable* table = ctx;
+    if (table->failed)
+        return;
+    if ((table->count + 1) * 2 > table->cap) {
+        int cap = table->cap ? table->cap * 2 : 64;
+        AttemptSlot* slots = calloc(cap, sizeof(AttemptSlot));
+        if (!slots) {
+            table->failed = 1;
+            return;
+        }
+        AttemptTable grown = { slots, table->count, cap, 0 };
+        for (int i = 0; i < table->cap; i++) {
+            if (table->slots[i].username[0])
+                *find_attempt_slot(&grown, table->slots[i].username) = table->slots[i];
+        }
+        free(table->slots);
+        *table = grown;
+    }
+    AttemptSlot* slot = find_attempt_slot(table, result->username);
+    if (!slot->username[0]) {
+        snprintf(slot->username, sizeof(slot->username), "%s", result->username);
+        table->count++;
+    }
+    slot->count++;
+}
+
+typedef struct
+{
+    const char* username;
+    int attempts;
+} AttemptCount;
+
+static void count_attempt(const RoomResult* result, void* ctx)
+{
+    AttemptCount* count = ctx;
+    if (strcmp(result->username, count->username) == 0)
+        count->attempts++;
+}
+
+int storage_count_attempts(const char* room_id, const char* username)
+{
+    if (strlen(room_id) >= sizeof(result_indexes->room_id))
+        return 0;
+    ResultIndex* index = find_result_index(room_id, 1);
+    if (index && index->attempts && index->attempts->failed) {
+        free(index->attempts->slots);
+        free(index->attempts);
+        index->attempts = NULL;
+    }
+    if (index && !index->attempts) {
+        index->attempts = calloc(1, sizeof(AttemptTable));
+        if (index->attempts)
+            for_each_result(room_id, UINT64_MAX, add_attempt, index->attempts);
+    }
+    if (!index || !index->attempts || index->attempts->failed) {
+        // Out of memory: count the slow way rather than refuse the submission
+        AttemptCount count = { username, 0 };
+        for_each_result(room_id, UINT64_MAX, count_attempt, &count);
+        return count.attempts;
+    }
+    if (!index->attempts->cap)
+        return 0;
+    return find_attempt_slot(index->attempts, username)->count;
+}
+
+static int list_grow(ResultList* list)
+{
+    int cap = list->cap ? list->cap * 2 : 64;
+    IndexedResult* items = realloc(list->items, cap * sizeof(IndexedResult));
+    if (!items)
+        return -1;
+    list->items = items;
+    int* by_score = realloc(list->by_score, cap * sizeof(int));
+    if (!by_score)
+        return -1;
+    list->by_score = by_score;
+    list->cap = cap;
+    return 0;
+}
+
+// Whether the result at position a comes before (score, b) by score
+static int scores_before(const ResultList* list, int a, int score, int b)
+{
+    if (list->items[a].score != score)
+        return list->items[a].score > score;
+    return a < b;
+}
+
+// First index in by_score not before (score, pos)
+static int by_score_lower_bound(const ResultList* list, int count, int score, int pos)
+{
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (scores_before(list, list->by_score[mid], score, pos))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Appends the result, leaving its by_score entry to the caller; -1 if full
+static int push_result(ResultList* list, const RoomResult* result)
+{
+    if (list->count == list->cap && list_grow(list) != 0)
+        return -1;
+    IndexedResult* item = &list->items[list->count];
+    snprintf(item->username, sizeof(item->username), "%s", result->username);
+    item->score = result->score;
+    item->timestamp = result->timestamp;
+    item->seq = result->seq;
+    return list->count++;
+}
+
+static void add_to_list(ResultList* list, const RoomResult* result)
+{
+    int pos = push_result(list, result);
+    if (pos < 0)
+        return;
+    // The newest result goes after every other with its score
+    int at = by_score_lower_bound(list, pos, result->score, pos);
+    memmove(&list->by_score[at + 1], &list->by_score[at], (pos - at) * sizeof(int));
+    list->by_score[at] = pos;
+}
+
+// Loading appends in order and sorts by_score once at the end
+static void append_to_list(const RoomResult* result, void* ctx)
+{
+    ResultList* list = ctx;
+    int pos = push_result(list, result);
+    if (pos >= 0)
+        list->by_score[pos] = pos;
+}
+
+static const ResultList* sorting_list; // qsort has no context argument
+
+static int compare_by_score(const void* a, const void* b)
+{
+    int pa = *(const int*)a, pb = *(const int*)b;
+    const ResultList* list = sorting_list;
+    if (list->items[pa].score != list->items[pb].score)
+        return list->items[pa].score > list->items[pb].score ? -1 : 1;
+    return pa < pb ? -1 : pa > pb;
+}
+
+static const ResultList* get_result_list(const char* room_id)
+{
+    if (strlen(room_id) >= sizeof(result_indexes->room_id))
         return NULL;
+    ResultIndex* index = find_result_index(room_id, 1);
+    if (!index)
+        return NULL;
+    if (!index->list) {
+        index->list = calloc(1, sizeof(ResultList));
+        if (!index->list)
+            return NULL;
+        for_each_result(room_id, UINT64_MAX, append_to_list, index->list);
+        sorting_list = index->list;
+        qsort(index->list->by_score, index->list->count, sizeof(int), compare_by_score);
+    }
+    return index->list;
+}
 
-    cJSON* target = NULL;
-    cJSON* item = NULL;
-    cJSON_ArrayForEach(item, root)
-    {
-        cJSON* id = cJSON_GetObjectItem(item, "id");
-        if (id && strcmp(id->valuestring, room_id) == 0) {
-            target = cJSON_Duplicate(item, 1);
-            break;
+int storage_room_results_page(const char* room_id, const ResultPageQuery* query, StorageResultFn fn, void* ctx,
+                              char next[STORAGE_CURSOR_SIZE])
+{
+    next[0] = '\0';
+    if (query->limit <= 0)
+        return 0;
+    // Cursors are "<position>" in submission order, "<score>:<position>" by score
+    int score = 0;
+    long pos = -1;
+    if (query->cursor) {
+        char* end;
+        if (query->by_score) {
+            score = (int)strtol(query->cursor, &end, 10);
+            if (end == query->cursor || *end != ':')
+                return -1;
+            const char* p = end + 1;
+            pos = strtol(p, &end, 10);
+            if (end == p || *end || pos < 0)
+                return -1;
+        } else {
+            pos = strtol(query->cursor, &end, 10);
+            if (end == query->cursor || *end || pos < 0)
+                return -1;
+        }
+    }
+
+    static const ResultList none;
+    const ResultList* list = get_result_list(room_id);
+    if (!list)
+        list = &none;
+
+    if (pos >= list->count)
+        pos = list->count - 1;
+    int i = (int)pos + 1;
+    if (query->by_score)
+        i = query->cursor ? by_score_lower_bound(list, list->count, score, i) : 0;
+
+    RoomResult result;
+    memset(&result, 0, sizeof(result));
+    snprintf(result.room_id, sizeof(result.room_id), "%s", room_id);
+    int sent = 0;
+    for (; i < list->count && sent < query->limit; i++, sent++) {
+        int at = query->by_score ? list->by_score[i] : i;
+        const IndexedResult* item = &list->items[at];
+        memcpy(result.username, item->username, sizeof(result.username));
+        result.score = item->score;
+        result.timestamp = item->timestamp;
+        result.seq = item->seq;
+        fn(&result, ctx);
+        if (i + 1 < list->count && sent + 1 == query->limit) {
+            if (query->by_score)
+                snprintf(next, STORAGE_CURSOR_SIZE, "%d:%d", item->score, at);
+            else
+                snprintf(next, STORAGE_CURSOR_SIZE, "%d", at);
+        }
+    }
+    return 0;
+}
+
+// Journal, snapshots and compaction
+//
+// data/journal.log receives every mutation. Compaction rotates it to
+// data/journal.old, lets the engine copy the rooms and pending results on
+// the event loop, and hands the writing, fsyncs and the journal.old cleanup
+// to a background thread. The engine records the snapshot's lsn last;
+// startup loads the snapshot and replays both journals past it.
+#define JOURNAL_FILE "data/journal.log"
+#define JOURNAL_OLD_FILE "data/journal.old"
+#define SNAPSHOT_POLL_MS 10
+
+typedef struct
+{
+    void* engine_job;
+    uint64_t lsn;
+    int rc;
+} SnapshotJob;
+
+static long snapshot_bytes = 4 * 1024 * 1024; // QUIZZIE_SNAPSHOT_BYTES
+static long snapshot_ms = 30000; // QUIZZIE_SNAPSHOT_MS
+static JournalFsyncPolicy journal_policy = JOURNAL_FSYNC_GROUP; // QUIZZIE_JOURNAL_FSYNC
+static uint64_t snapshot_lsn; // covered by the last completed or running snapshot
+static uint64_t unsnapshotted_since_ms;
+static SnapshotJob snapshot_job;
+static pthread_t snapshot_thread;
+static int snapshot_running;
+static int snapshot_done; // set by the thread, read with __atomic builtins
+
+static void note_journaled(void)
+{
+    if (journal_next_lsn() - 1 == snapshot_lsn + 1)
+        unsnapshotted_since_ms = now_ms();
+}
+
+static int has_unsnapshotted(void)
+{
+    return journal_next_lsn() - 1 > snapshot_lsn;
+}
+
+static void* run_snapshot_job(void* arg)
+{
+    SnapshotJob* job = arg;
+    if (job->rc == 0)
+        job->rc = engine->write_snapshot(job->engine_job);
+    // journal.old only holds records the snapshot now covers
+    if (job->rc == 0 && unlink(JOURNAL_OLD_FILE) != 0 && errno != ENOENT)
+        job->rc = -1;
+
+    __atomic_store_n(&snapshot_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void prepare_snapshot(SnapshotJob* job)
+{
+    memset(job, 0, sizeof(*job));
+    job->lsn = journal_next_lsn() - 1;
+
+    // A journal.old left by a failed snapshot is covered by this one, so it stays put
+    if (access(JOURNAL_OLD_FILE, F_OK) != 0 && journal_size() > 0 && journal_rotate(JOURNAL_OLD_FILE) != 0)
+        perror("journal rotate");
+
+    // Pending results up to the snapshot, grouped by room
+    RoomResult* results = malloc((pending_count + 1) * sizeof(RoomResult));
+    int result_count = 0;
+    for (int i = 0; results && i < pending_room_cap; i++) {
+        if (!pending_rooms[i].room_id[0])
+            continue;
+        for (int r = pending_rooms[i].first; r >= 0; r = pending[r].next) {
+            if ((uint64_t)pending[r].result.seq <= job->lsn)
+                results[result_count++] = pending[r].result;
         }
     }
-    cJSON_Delete(root);
-    return target;
+
+    // Changed users and banks as they are now, which is as of the snapshot
+    StorageUser* changed_users = malloc((pending_user_count + 1) * sizeof(StorageUser));
+    int changed_user_count = 0;
+    for (int i = 0; changed_users && i < pending_user_count; i++) {
+        const User* u = &users[pending_users[i].pos];
+        changed_users[changed_user_count++] = (StorageUser){ u->username, strlen(u->username), u->password,
+                                                             strlen(u->password), u->role, strlen(u->role) };
+    }
+    StorageBankChange* changed_banks = malloc((pending_bank_count + 1) * sizeof(StorageBankChange));
+    for (int i = 0; changed_banks && i < pending_bank_count; i++)
+        changed_banks[i] = (StorageBankChange){ pending_banks[i].id, pending_banks[i].data, pending_banks[i].size };
+
+    StorageSnapshot snapshot = { job->lsn,     rooms,         room_count,    results,           result_count,
+                                 changed_users, changed_user_count, changed_banks, pending_bank_count };
+    job->engine_job = results && changed_users && changed_banks ? engine->prepare_snapshot(&snapshot) : NULL;
+    if (!job->engine_job)
+        job->rc = -1;
+    free(results);
+    free(changed_users);
+    free(changed_banks);
+    snapshot_lsn = job->lsn;
+}
+
+static void finish_snapshot(SnapshotJob* job)
+{
+    if (job->rc == 0) {
+        drop_pending_results(job->lsn);
+        drop_pending_users(job->lsn);
+        drop_pending_banks(job->lsn);
+    } else {
+        printf("Snapshot at lsn %llu failed, retrying later\n", (unsigned long long)job->lsn);
+        snapshot_lsn = 0;
+        unsnapshotted_since_ms = now_ms();
+    }
+    engine->free_snapshot(job->engine_job);
+    memset(job, 0, sizeof(*job));
+}
+
+static void wait_for_snapshot(void)
+{
+    if (!snapshot_running)
+        return;
+    pthread_join(snapshot_thread, NULL);
+    snapshot_running = 0;
+    finish_snapshot(&snapshot_job);
+}
+
+static int snapshot_due_ms(void)
+{
+    if (snapshot_running || !has_unsnapshotted())
+        return -1;
+    if (journal_size() >= (size_t)snapshot_bytes)
+        return 0;
+    uint64_t due = unsnapshotted_since_ms + snapshot_ms;
+    uint64_t now = now_ms();
+    return now >= due ? 0 : (int)(due - now);
+}
+
+static void start_snapshot(void)
+{
+    prepare_snapshot(&snapshot_job);
+    __atomic_store_n(&snapshot_done, 0, __ATOMIC_RELEASE);
+    if (pthread_create(&snapshot_thread, NULL, run_snapshot_job, &snapshot_job) == 0) {
+        snapshot_running = 1;
+        return;
+    }
+    run_snapshot_job(&snapshot_job);
+    finish_snapshot(&snapshot_job);
+}
+
+static void apply_journal_record(uint64_t lsn, int type, const char* payload, size_t len, void* ctx)
+{
+    uint64_t checkpoint = *(uint64_t*)ctx;
+    if (lsn <= checkpoint)
+        return;
+
+    if (type == JOURNAL_BANK_PUT || type == JOURNAL_BANK_DELETE) {
+        char bank_id[256];
+        const char* end = type == JOURNAL_BANK_PUT ? memchr(payload, '\0', len) : payload + len;
+        size_t id_len = end ? (size_t)(end - payload) : 0;
+        if (id_len == 0 || id_len >= sizeof(bank_id) || reserve_pending_bank() != 0)
+            return;
+        memcpy(bank_id, payload, id_len);
+        bank_id[id_len] = '\0';
+        size_t size = type == JOURNAL_BANK_PUT ? len - id_len - 1 : 0;
+        char* data = type == JOURNAL_BANK_PUT ? malloc(size) : NULL;
+        if (type == JOURNAL_BANK_PUT && !data)
+            return;
+        if (data)
+            memcpy(data, end + 1, size);
+        set_pending_bank(bank_id, data, size, lsn);
+        return;
+    }
+
+    cJSON* record = cJSON_ParseWithLength(payload, len);
+    Room room;
+    RoomResult result;
+    UserRecord user;
+    switch (type) {
+    case JOURNAL_ROOM_PUT:
+        if (request_decode(&room_record_schema, record, &room) == NULL)
+            apply_room_put(&room);
+        break;
+    case JOURNAL_ROOM_DELETE:
+        if (cJSON_IsString(json_get(record, KEY_ID)))
+            apply_room_delete(json_get(record, KEY_ID)->valuestring);
+        break;
+    case JOURNAL_RESULT_ADD:
+        if (request_decode(&result_record_schema, record, &result) == NULL) {
+            result.seq = (long)lsn;
+            add_pending_result(&result);
+        }
+        break;
+    case JOURNAL_USER_PUT:
+        if (request_decode(&user_record_schema, record, &user) == NULL)
+            apply_user_put(&user, lsn);
+        break;
+    }
+    cJSON_Delete(record);
+}
+
+static void open_journal(void)
+{
+    snapshot_bytes = config_get_long("QUIZZIE_SNAPSHOT_BYTES", snapshot_bytes);
+    snapshot_ms = config_get_long("QUIZZIE_SNAPSHOT_MS", snapshot_ms);
+    journal_policy = journal_parse_policy(config_get_str("QUIZZIE_JOURNAL_FSYNC", "group"));
+    long interval_ms = config_get_long("QUIZZIE_JOURNAL_FSYNC_MS", 1000);
+    journal_set_group_commit(config_get_long("QUIZZIE_GROUP_COMMIT_US", 1000),
+                             (int)config_get_long("QUIZZIE_GROUP_COMMIT_MAX", 256));
+
+    uint64_t checkpoint = engine->checkpoint_lsn();
+    journal_set_next_lsn(checkpoint + 1);
+    long replayed = 0;
+    long n = journal_replay(JOURNAL_OLD_FILE, apply_journal_record, &checkpoint);
+    replayed += n > 0 ? n : 0;
+    n = journal_replay(JOURNAL_FILE, apply_journal_record, &checkpoint);
+    replayed += n > 0 ? n : 0;
+
+    snapshot_lsn = checkpoint;
+    unsnapshotted_since_ms = now_ms();
+    if (journal_open(JOURNAL_FILE, journal_policy, interval_ms) != 0)
+        perror("journal open");
+    printf("Journal: replayed %ld records past lsn %llu, fsync %s\n", replayed,
+           (unsigned long long)checkpoint, journal_policy_name(journal_policy));
+}
+
+// The interval policy gives up durability for latency, so nothing waits on it
+int storage_is_durable(long seq)
+{
+    return journal_policy == JOURNAL_FSYNC_INTERVAL || (uint64_t)seq <= journal_durable_lsn();
+}
+
+cJSON* storage_journal_stats_to_json(void)
+{
+    JournalStats st;
+    journal_get_stats(&st);
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "fsync", journal_policy_name(journal_policy));
+    cJSON_AddNumberToObject(obj, "appends", (double)st.appends);
+    cJSON_AddNumberToObject(obj, "bytes", (double)st.bytes);
+    cJSON_AddNumberToObject(obj, "writes", (double)st.writes);
+    cJSON_AddNumberToObject(obj, "commits", (double)st.syncs);
+    cJSON_AddNumberToObject(obj, "avg_batch", st.syncs ? (double)st.synced_records / st.syncs : 0);
+    cJSON_AddNumberToObject(obj, "max_batch", (double)st.max_batch);
+    cJSON_AddNumberToObject(obj, "avg_commit_us", st.syncs ? (double)(st.commit_wait_us / st.syncs) : 0);
+    cJSON_AddNumberToObject(obj, "max_commit_us", (double)st.max_commit_wait_us);
+    cJSON_AddNumberToObject(obj, "rotations", (double)st.rotations);
+    return obj;
+}
+
+cJSON* storage_engine_stats_to_json(void)
+{
+    cJSON* obj = engine->stats_to_json ? engine->stats_to_json() : cJSON_CreateObject();
+    cJSON_AddStringToObject(obj, "name", engine->name);
+    return obj;
+}
+
+int storage_flush(void)
+{
+    wait_for_snapshot();
+    journal_sync();
+    if (!has_unsnapshotted())
+        return 0;
+    prepare_snapshot(&snapshot_job);
+    run_snapshot_job(&snapshot_job);
+    int rc = snapshot_job.rc;
+    finish_snapshot(&snapshot_job);
+    return rc;
+}
+
+int storage_sync(void)
+{
+    return journal_sync();
+}
+
+int storage_flush_timeout_ms(void)
+{
+    int timeout = journal_timeout_ms();
+    int due = snapshot_running ? SNAPSHOT_POLL_MS : snapshot_due_ms();
+    if (due >= 0 && (timeout < 0 || due < timeout))
+        timeout = due;
+    return timeout;
+}
+
+void storage_tick(void)
+{
+    journal_tick();
+    if (snapshot_running && __atomic_load_n(&snapshot_done, __ATOMIC_ACQUIRE))
+        wait_for_snapshot();
+    if (snapshot_due_ms() == 0)
+        start_snapshot();
 }
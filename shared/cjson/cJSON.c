@@ -44,6 +44,7 @@
 #include <limits.h>
 #include <ctype.h>
 #include <float.h>
+#include <stdint.h>
 
 #ifdef ENABLE_LOCALES
 #include <locale.h>
@@ -293,6 +294,7 @@ typedef struct
     size_t offset;
     size_t depth; /* How deeply nested (in arrays/objects) is the input at the current offset. */
     internal_hooks hooks;
+    cJSON_bool in_situ; /* strings are unescaped into content itself, which must be writable */
 } parse_buffer;
 
 /* check if the given size is left to read in a given parse buffer (starting with 1) */
@@ -587,71 +589,422 @@ static cJSON_bool compare_double(double a, double b)
     return (fabs(a - b) <= maxVal * DBL_EPSILON);
 }
 
-/* Render the number nicely from the given item into a string. */
-static cJSON_bool print_number(const cJSON * const item, printbuffer * const output_buffer)
+/* Number formatting without sprintf: integers go through a digit pair table,
+ * other doubles through Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly
+ * and Accurately with Integers"). Its digits always read back as the same double
+ * but are not always the shortest that do: -89.42149878552151 comes out where
+ * %.15g would give -89.4214987855215. */
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* writes value without terminator, returns the number of digits */
+static int format_uint32(uint32_t value, char *output)
 {
-    unsigned char *output_pointer = NULL;
-    double d = item->valuedouble;
+    char digits[10];
+    int position = 10;
     int length = 0;
-    size_t i = 0;
-    unsigned char number_buffer[26] = {0}; /* temporary buffer to print the number into */
-    unsigned char decimal_point = get_decimal_point();
-    double test = 0.0;
 
-    if (output_buffer == NULL)
+    while (value >= 100)
     {
-        return false;
+        unsigned int pair = (value % 100) * 2;
+        value /= 100;
+        digits[--position] = digit_pairs[pair + 1];
+        digits[--position] = digit_pairs[pair];
+    }
+    if (value >= 10)
+    {
+        digits[--position] = digit_pairs[value * 2 + 1];
+        digits[--position] = digit_pairs[value * 2];
+    }
+    else
+    {
+        digits[--position] = (char)('0' + value);
     }
 
-    /* This checks for NaN and Infinity */
-    if (isnan(d) || isinf(d))
+    length = 10 - position;
+    memcpy(output, digits + position, (size_t)length);
+    return length;
+}
+
+typedef struct
+{
+    uint64_t f;
+    int e;
+} diy_fp;
+
+static const uint64_t cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const short cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const uint64_t powers_of_ten[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+#define DIY_SIGNIFICAND_SIZE 64
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_HIDDEN_BIT ((uint64_t)1 << DP_SIGNIFICAND_SIZE)
+
+static diy_fp diy_fp_from_double(double d)
+{
+    diy_fp fp;
+    uint64_t bits = 0;
+    int biased_e = 0;
+    uint64_t significand = 0;
+
+    memcpy(&bits, &d, sizeof(bits));
+    biased_e = (int)((bits >> DP_SIGNIFICAND_SIZE) & 0x7FF);
+    significand = bits & (DP_HIDDEN_BIT - 1);
+    if (biased_e != 0)
+    {
+        fp.f = significand + DP_HIDDEN_BIT;
+        fp.e = biased_e - DP_EXPONENT_BIAS;
+    }
+    else
+    {
+        fp.f = significand;
+        fp.e = 1 - DP_EXPONENT_BIAS;
+    }
+    return fp;
+}
+
+static diy_fp diy_fp_multiply(diy_fp x, diy_fp y)
+{
+    const uint64_t mask32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32;
+    uint64_t b = x.f & mask32;
+    uint64_t c = y.f >> 32;
+    uint64_t d = y.f & mask32;
+    uint64_t ac = a * c;
+    uint64_t bc = b * c;
+    uint64_t ad = a * d;
+    uint64_t bd = b * d;
+    uint64_t middle = (bd >> 32) + (ad & mask32) + (bc & mask32);
+    diy_fp product;
+
+    middle += (uint64_t)1 << 31; /* round */
+    product.f = ac + (ad >> 32) + (bc >> 32) + (middle >> 32);
+    product.e = x.e + y.e + 64;
+    return product;
+}
+
+static diy_fp diy_fp_normalize(diy_fp fp)
+{
+    while (!(fp.f & ((uint64_t)1 << 63)))
     {
-        length = sprintf((char*)number_buffer, "null");
+        fp.f <<= 1;
+        fp.e--;
     }
-    else if(d == (double)item->valueint)
+    return fp;
+}
+
+/* the boundaries halfway to the neighbouring doubles, sharing the exponent of plus */
+static void diy_fp_boundaries(diy_fp v, diy_fp *minus, diy_fp *plus)
+{
+    diy_fp upper;
+    diy_fp lower;
+
+    upper.f = (v.f << 1) + 1;
+    upper.e = v.e - 1;
+    while (!(upper.f & (DP_HIDDEN_BIT << 1)))
     {
-        length = sprintf((char*)number_buffer, "%d", item->valueint);
+        upper.f <<= 1;
+        upper.e--;
+    }
+    upper.f <<= DIY_SIGNIFICAND_SIZE - DP_SIGNIFICAND_SIZE - 2;
+    upper.e -= DIY_SIGNIFICAND_SIZE - DP_SIGNIFICAND_SIZE - 2;
+
+    if (v.f == DP_HIDDEN_BIT)
+    {
+        /* the lower neighbour is closer at a power of two */
+        lower.f = (v.f << 2) - 1;
+        lower.e = v.e - 2;
     }
     else
     {
-        /* Try 15 decimal places of precision to avoid nonsignificant nonzero digits */
-        length = sprintf((char*)number_buffer, "%1.15g", d);
+        lower.f = (v.f << 1) - 1;
+        lower.e = v.e - 1;
+    }
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+
+    *minus = lower;
+    *plus = upper;
+}
+
+/* a cached power of ten c with -60 <= e + c.e <= -32; stores its decimal exponent negated in K */
+static diy_fp cached_power(int e, int *K)
+{
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    unsigned int index = 0;
+    diy_fp power;
+
+    if ((dk - k) > 0.0)
+    {
+        k++;
+    }
+    index = (unsigned int)((k >> 3) + 1);
+    *K = -(-348 + (int)(index * 8));
+    power.f = cached_powers_f[index];
+    power.e = cached_powers_e[index];
+    return power;
+}
 
-        /* Check whether the original double can be recovered */
-        if ((sscanf((char*)number_buffer, "%lg", &test) != 1) || !compare_double((double)test, d))
+static void grisu_round(char *buffer, int length, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while ((rest < wp_w) && ((delta - rest) >= ten_kappa) &&
+           (((rest + ten_kappa) < wp_w) || ((wp_w - rest) > (rest + ten_kappa - wp_w))))
+    {
+        buffer[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static int count_decimal_digits(uint32_t n)
+{
+    int digits = 1;
+    while ((digits < 10) && (n >= powers_of_ten[digits]))
+    {
+        digits++;
+    }
+    return digits;
+}
+
+static void grisu_digit_gen(diy_fp w, diy_fp mp, uint64_t delta, char *buffer, int *length, int *K)
+{
+    const int shift = -mp.e;
+    const uint64_t one = (uint64_t)1 << shift;
+    const uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> shift);
+    uint64_t p2 = mp.f & (one - 1);
+    int kappa = count_decimal_digits(p1);
+
+    *length = 0;
+    while (kappa > 0)
+    {
+        uint32_t divisor = (uint32_t)powers_of_ten[kappa - 1];
+        uint32_t digit = p1 / divisor;
+        uint64_t rest = 0;
+
+        p1 %= divisor;
+        if ((digit != 0) || (*length != 0))
         {
-            /* If not, print with 17 decimal places of precision */
-            length = sprintf((char*)number_buffer, "%1.17g", d);
+            buffer[(*length)++] = (char)('0' + digit);
+        }
+        kappa--;
+        rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta)
+        {
+            *K += kappa;
+            grisu_round(buffer, *length, delta, rest, powers_of_ten[kappa] << shift, wp_w);
+            return;
         }
     }
 
-    /* sprintf failed or buffer overrun occurred */
-    if ((length < 0) || (length > (int)(sizeof(number_buffer) - 1)))
+    for (;;)
     {
-        return false;
+        char digit = 0;
+
+        p2 *= 10;
+        delta *= 10;
+        digit = (char)(p2 >> shift);
+        if ((digit != 0) || (*length != 0))
+        {
+            buffer[(*length)++] = (char)('0' + digit);
+        }
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta)
+        {
+            *K += kappa;
+            grisu_round(buffer, *length, delta, p2, one, wp_w * ((-kappa < 20) ? powers_of_ten[-kappa] : 0));
+            return;
+        }
     }
+}
 
-    /* reserve appropriate space in the output */
-    output_pointer = ensure(output_buffer, (size_t)length + sizeof(""));
-    if (output_pointer == NULL)
+/* shortest digits of a positive finite value, value = digits * 10^K */
+static void grisu2(double value, char *buffer, int *length, int *K)
+{
+    diy_fp v = diy_fp_from_double(value);
+    diy_fp w_minus;
+    diy_fp w_plus;
+    diy_fp c_mk;
+    diy_fp w;
+    diy_fp wp;
+    diy_fp wm;
+
+    diy_fp_boundaries(v, &w_minus, &w_plus);
+    c_mk = cached_power(w_plus.e, K);
+    w = diy_fp_multiply(diy_fp_normalize(v), c_mk);
+    wp = diy_fp_multiply(w_plus, c_mk);
+    wm = diy_fp_multiply(w_minus, c_mk);
+    wm.f++;
+    wp.f--;
+    grisu_digit_gen(w, wp, wp.f - wm.f, buffer, length, K);
+}
+
+/* lays out digits * 10^K like %g would: plain for exponents in [-4, 15), scientific otherwise */
+static int format_digits(char *output, const char *digits, int length, int K)
+{
+    int exponent = length + K - 1; /* of the first digit */
+    int position = 0;
+    int i = 0;
+
+    if ((exponent >= -4) && (exponent < 15))
     {
-        return false;
+        if (exponent < 0)
+        {
+            output[position++] = '0';
+            output[position++] = '.';
+            for (i = exponent; i < -1; i++)
+            {
+                output[position++] = '0';
+            }
+            memcpy(output + position, digits, (size_t)length);
+            return position + length;
+        }
+        if (length <= (exponent + 1))
+        {
+            memcpy(output, digits, (size_t)length);
+            position = length;
+            for (i = length; i <= exponent; i++)
+            {
+                output[position++] = '0';
+            }
+            return position;
+        }
+        memcpy(output, digits, (size_t)(exponent + 1));
+        position = exponent + 1;
+        output[position++] = '.';
+        memcpy(output + position, digits + exponent + 1, (size_t)(length - exponent - 1));
+        return position + length - exponent - 1;
+    }
+
+    output[position++] = digits[0];
+    if (length > 1)
+    {
+        output[position++] = '.';
+        memcpy(output + position, digits + 1, (size_t)(length - 1));
+        position += length - 1;
+    }
+    output[position++] = 'e';
+    if (exponent < 0)
+    {
+        output[position++] = '-';
+        exponent = -exponent;
+    }
+    else
+    {
+        output[position++] = '+';
+    }
+    if (exponent < 10)
+    {
+        output[position++] = '0';
+    }
+    return position + format_uint32((uint32_t)exponent, output + position);
+}
+
+CJSON_PUBLIC(int) cJSON_FormatNumber(double number, char *buffer)
+{
+    int length = 0;
+
+    /* This checks for NaN and Infinity */
+    if (isnan(number) || isinf(number))
+    {
+        memcpy(buffer, "null", sizeof("null"));
+        return 4;
     }
 
-    /* copy the printed number to the output and replace locale
-     * dependent decimal point with '.' */
-    for (i = 0; i < ((size_t)length); i++)
+    if ((number >= INT_MIN) && (number <= INT_MAX) && (number == (double)(int)number))
     {
-        if (number_buffer[i] == decimal_point)
+        int integer = (int)number;
+        uint32_t magnitude = (uint32_t)integer;
+        /* -0.0 compares equal to 0 but keeps its sign, as printf prints it */
+        if ((integer < 0) || ((integer == 0) && signbit(number)))
         {
-            output_pointer[i] = '.';
-            continue;
+            buffer[length++] = '-';
+            magnitude = 0U - magnitude;
         }
+        length += format_uint32(magnitude, buffer + length);
+    }
+    else
+    {
+        char digits[24];
+        int digit_count = 0;
+        int K = 0;
+
+        if (number < 0)
+        {
+            buffer[length++] = '-';
+            number = -number;
+        }
+        grisu2(number, digits, &digit_count, &K);
+        length += format_digits(buffer + length, digits, digit_count, K);
+    }
+
+    buffer[length] = '\0';
+    return length;
+}
+
+/* Render the number nicely from the given item into a string. */
+static cJSON_bool print_number(const cJSON * const item, printbuffer * const output_buffer)
+{
+    unsigned char *output_pointer = NULL;
+    int length = 0;
+
+    if (output_buffer == NULL)
+    {
+        return false;
+    }
 
-        output_pointer[i] = number_buffer[i];
+    /* reserve appropriate space in the output */
+    output_pointer = ensure(output_buffer, CJSON_NUMBER_BUFFER_SIZE);
+    if (output_pointer == NULL)
+    {
+        return false;
     }
-    output_pointer[i] = '\0';
 
+    length = cJSON_FormatNumber(item->valuedouble, (char*)output_pointer);
     output_buffer->offset += (size_t)length;
 
     return true;
@@ -815,6 +1168,158 @@ fail:
     return 0;
 }
 
+/* Byte scanning for string bodies and whitespace runs.
+ * On x86 the widest of AVX2 and SSE2 is picked at runtime, elsewhere the scalar loop is used. */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(CJSON_NO_SIMD)
+#define CJSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+typedef enum
+{
+    scan_quote_or_backslash, /* stop at '"' or '\\' */
+    scan_needs_escape, /* stop at '"', '\\' or a control character */
+    scan_non_whitespace /* stop at the first byte above ' ' */
+} scan_kind;
+
+typedef size_t (*scan_function)(const unsigned char *input, size_t length, scan_kind kind);
+
+/* returns the offset of the first byte matching kind, or length if there is none */
+static size_t scan_scalar(const unsigned char *input, size_t length, scan_kind kind)
+{
+    size_t i = 0;
+    for (i = 0; i < length; i++)
+    {
+        unsigned char c = input[i];
+        if (kind == scan_non_whitespace)
+        {
+            if (c > 32)
+            {
+                break;
+            }
+        }
+        else if ((c == '\"') || (c == '\\') || ((kind == scan_needs_escape) && (c < 32)))
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+#ifdef CJSON_SIMD_X86
+/* bit i is set when byte i of the 16 byte chunk matches kind */
+__attribute__((target("sse2")))
+static inline unsigned int match_mask_16(__m128i chunk, scan_kind kind)
+{
+    if (kind == scan_non_whitespace)
+    {
+        /* c <= 32 exactly when max(c, 32) == 32 */
+        const __m128i space = _mm_set1_epi8(32);
+        return ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(chunk, space), space)) & 0xFFFFu;
+    }
+    else
+    {
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')));
+        if (kind == scan_needs_escape)
+        {
+            /* c < 32 exactly when min(c, 31) == c */
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(chunk, _mm_set1_epi8(31)), chunk));
+        }
+        return (unsigned int)_mm_movemask_epi8(hit);
+    }
+}
+
+__attribute__((target("sse2")))
+static size_t scan_sse2(const unsigned char *input, size_t length, scan_kind kind)
+{
+    size_t i = 0;
+    for (i = 0; (i + 16) <= length; i += 16)
+    {
+        unsigned int mask = match_mask_16(_mm_loadu_si128((const __m128i*)(const void*)(input + i)), kind);
+        if (mask != 0)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return i + scan_scalar(input + i, length - i, kind);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const unsigned char *input, size_t length, scan_kind kind)
+{
+    size_t i = 0;
+    unsigned int mask = 0;
+
+    for (i = 0; (i + 32) <= length; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(const void*)(input + i));
+        if (kind == scan_non_whitespace)
+        {
+            const __m256i space = _mm256_set1_epi8(32);
+            mask = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(chunk, space), space));
+        }
+        else
+        {
+            __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\"')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\')));
+            if (kind == scan_needs_escape)
+            {
+                hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, _mm256_set1_epi8(31)), chunk));
+            }
+            mask = (unsigned int)_mm256_movemask_epi8(hit);
+        }
+        if (mask != 0)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    /* finish with one 16 byte step here rather than calling scan_sse2:
+     * its non-VEX instructions after 256 bit ones cost a state transition */
+    if ((i + 16) <= length)
+    {
+        mask = match_mask_16(_mm_loadu_si128((const __m128i*)(const void*)(input + i)), kind);
+        if (mask != 0)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+        i += 16;
+    }
+    return i + scan_scalar(input + i, length - i, kind);
+}
+#endif
+
+static scan_function select_scan(void)
+{
+#ifdef CJSON_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return scan_avx2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return scan_sse2;
+    }
+#endif
+    return scan_scalar;
+}
+
+static size_t scan_bytes(const unsigned char *input, size_t length, scan_kind kind)
+{
+    static scan_function scan = NULL;
+
+    /* short runs are not worth an indirect call */
+    if (length < 16)
+    {
+        return scan_scalar(input, length, kind);
+    }
+    if (scan == NULL)
+    {
+        scan = select_scan();
+    }
+    return scan(input, length, kind);
+}
+
 /* Parse the input text into an unescaped cinput, and populate item. */
 static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_buffer)
 {
@@ -833,32 +1338,42 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
         /* calculate approximate size of the output (overestimate) */
         size_t allocation_length = 0;
         size_t skipped_bytes = 0;
-        while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"'))
+        while ((size_t)(input_end - input_buffer->content) < input_buffer->length)
         {
+            input_end += scan_bytes(input_end, input_buffer->length - (size_t)(input_end - input_buffer->content), scan_quote_or_backslash);
+            if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end == '\"'))
+            {
+                break;
+            }
             /* is escape sequence */
-            if (input_end[0] == '\\')
+            if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length)
             {
-                if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length)
-                {
-                    /* prevent buffer overflow when last input character is a backslash */
-                    goto fail;
-                }
-                skipped_bytes++;
-                input_end++;
+                /* prevent buffer overflow when last input character is a backslash */
+                goto fail;
             }
-            input_end++;
+            skipped_bytes++;
+            input_end += 2;
         }
         if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"'))
         {
             goto fail; /* string ended unexpectedly */
         }
 
-        /* This is at most how much we need for the output */
-        allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
-        output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
-        if (output == NULL)
+        if (input_buffer->in_situ)
         {
-            goto fail; /* allocation failure */
+            /* unescaping never grows the string, so the output can overwrite the input
+             * it has already consumed, and the terminator lands at most on the closing quote */
+            output = (unsigned char*)input_pointer;
+        }
+        else
+        {
+            /* This is at most how much we need for the output */
+            allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
+            output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+            if (output == NULL)
+            {
+                goto fail; /* allocation failure */
+            }
         }
     }
 
@@ -868,7 +1383,15 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     {
         if (*input_pointer != '\\')
         {
-            *output_pointer++ = *input_pointer++;
+            /* copy the run up to the next escape sequence at once (the regions overlap when in situ);
+             * the current byte always goes, a malformed \u sequence can leave us on a quote */
+            size_t run = 1 + scan_bytes(input_pointer + 1, (size_t)(input_end - input_pointer - 1), scan_quote_or_backslash);
+            if (output_pointer != input_pointer)
+            {
+                memmove(output_pointer, input_pointer, run);
+            }
+            output_pointer += run;
+            input_pointer += run;
         }
         /* escape sequence */
         else
@@ -923,6 +1446,11 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     *output_pointer = '\0';
 
     item->type = cJSON_String;
+    if (input_buffer->in_situ)
+    {
+        /* the string belongs to the input buffer, not to the item */
+        item->type |= cJSON_IsReference;
+    }
     item->valuestring = (char*)output;
 
     input_buffer->offset = (size_t) (input_end - input_buffer->content);
@@ -931,7 +1459,7 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     return true;
 
 fail:
-    if (output != NULL)
+    if ((output != NULL) && !input_buffer->in_situ)
     {
         input_buffer->hooks.deallocate(output);
         output = NULL;
@@ -949,8 +1477,10 @@ fail:
 static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffer * const output_buffer)
 {
     const unsigned char *input_pointer = NULL;
+    const unsigned char *input_end = NULL;
     unsigned char *output = NULL;
     unsigned char *output_pointer = NULL;
+    size_t input_length = 0;
     size_t output_length = 0;
     /* numbers of additional characters needed for escaping */
     size_t escape_characters = 0;
@@ -973,8 +1503,11 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
         return true;
     }
 
+    input_length = strlen((const char*)input);
+    input_end = input + input_length;
+
     /* set "flag" to 1 if something needs to be escaped */
-    for (input_pointer = input; *input_pointer; input_pointer++)
+    for (input_pointer = input; (input_pointer += scan_bytes(input_pointer, (size_t)(input_end - input_pointer), scan_needs_escape)) < input_end; input_pointer++)
     {
         switch (*input_pointer)
         {
@@ -997,7 +1530,7 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
                 break;
         }
     }
-    output_length = (size_t)(input_pointer - input) + escape_characters;
+    output_length = input_length + escape_characters;
 
     output = ensure(output_buffer, output_length + sizeof("\"\""));
     if (output == NULL)
@@ -1019,46 +1552,48 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
     output[0] = '\"';
     output_pointer = output + 1;
     /* copy the string */
-    for (input_pointer = input; *input_pointer != '\0'; (void)input_pointer++, output_pointer++)
+    for (input_pointer = input; input_pointer < input_end; (void)input_pointer++, output_pointer++)
     {
-        if ((*input_pointer > 31) && (*input_pointer != '\"') && (*input_pointer != '\\'))
+        /* normal characters are copied in runs */
+        size_t run = scan_bytes(input_pointer, (size_t)(input_end - input_pointer), scan_needs_escape);
+        memcpy(output_pointer, input_pointer, run);
+        output_pointer += run;
+        input_pointer += run;
+        if (input_pointer == input_end)
         {
-            /* normal character, copy */
-            *output_pointer = *input_pointer;
+            break;
         }
-        else
+
+        /* character needs to be escaped */
+        *output_pointer++ = '\\';
+        switch (*input_pointer)
         {
-            /* character needs to be escaped */
-            *output_pointer++ = '\\';
-            switch (*input_pointer)
-            {
-                case '\\':
-                    *output_pointer = '\\';
-                    break;
-                case '\"':
-                    *output_pointer = '\"';
-                    break;
-                case '\b':
-                    *output_pointer = 'b';
-                    break;
-                case '\f':
-                    *output_pointer = 'f';
-                    break;
-                case '\n':
-                    *output_pointer = 'n';
-                    break;
-                case '\r':
-                    *output_pointer = 'r';
-                    break;
-                case '\t':
-                    *output_pointer = 't';
-                    break;
-                default:
-                    /* escape and print as unicode codepoint */
-                    sprintf((char*)output_pointer, "u%04x", *input_pointer);
-                    output_pointer += 4;
-                    break;
-            }
+            case '\\':
+                *output_pointer = '\\';
+                break;
+            case '\"':
+                *output_pointer = '\"';
+                break;
+            case '\b':
+                *output_pointer = 'b';
+                break;
+            case '\f':
+                *output_pointer = 'f';
+                break;
+            case '\n':
+                *output_pointer = 'n';
+                break;
+            case '\r':
+                *output_pointer = 'r';
+                break;
+            case '\t':
+                *output_pointer = 't';
+                break;
+            default:
+                /* escape and print as unicode codepoint */
+                sprintf((char*)output_pointer, "u%04x", *input_pointer);
+                output_pointer += 4;
+                break;
         }
     }
     output[output_length + 1] = '\"';
@@ -1094,9 +1629,9 @@ static parse_buffer *buffer_skip_whitespace(parse_buffer * const buffer)
         return buffer;
     }
 
-    while (can_access_at_index(buffer, 0) && (buffer_at_offset(buffer)[0] <= 32))
+    if (can_access_at_index(buffer, 0) && (buffer_at_offset(buffer)[0] <= 32))
     {
-       buffer->offset++;
+       buffer->offset += scan_bytes(buffer_at_offset(buffer), buffer->length - buffer->offset, scan_non_whitespace);
     }
 
     if (buffer->offset == buffer->length)
@@ -1141,7 +1676,7 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return
 /* Parse an object - create a new root, and populate. */
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
 {
-    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 }, false };
     cJSON *item = NULL;
 
     /* reset error position */
@@ -1229,6 +1764,69 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_len
     return cJSON_ParseWithLengthOpts(value, buffer_length, 0, 0);
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_ParseInSitu(char *buffer, size_t buffer_length)
+{
+    parse_buffer input = { 0, 0, 0, 0, { 0, 0, 0 }, true };
+    cJSON *item = NULL;
+
+    global_error.json = NULL;
+    global_error.position = 0;
+
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+    if (buffer_length == 0)
+    {
+        goto fail;
+    }
+
+    input.content = (const unsigned char*)buffer;
+    input.length = buffer_length;
+    input.hooks = global_hooks;
+
+    item = cJSON_New_Item(&global_hooks);
+    if (item == NULL)
+    {
+        goto fail;
+    }
+
+    if (!parse_value(item, buffer_skip_whitespace(skip_utf8_bom(&input))))
+    {
+        goto fail;
+    }
+
+    /* hand the buffer to the root so cJSON_Delete releases it with the tree */
+    if (cJSON_IsString(item))
+    {
+        /* a bare string already points into the buffer, move it to the front */
+        memmove(buffer, item->valuestring, strlen(item->valuestring) + sizeof(""));
+        item->valuestring = buffer;
+        item->type &= ~cJSON_IsReference;
+    }
+    else if (cJSON_IsArray(item) || cJSON_IsObject(item))
+    {
+        /* containers have no string value of their own, so it can hold the buffer */
+        item->valuestring = buffer;
+    }
+    else
+    {
+        /* numbers and literals reference nothing */
+        global_hooks.deallocate(buffer);
+    }
+
+    return item;
+
+fail:
+    if (item != NULL)
+    {
+        cJSON_Delete(item);
+    }
+    global_hooks.deallocate(buffer);
+
+    return NULL;
+}
+
 #define cjson_min(a, b) (((a) < (b)) ? (a) : (b))
 
 static unsigned char *print(const cJSON * const item, cJSON_bool format, const internal_hooks * const hooks)
@@ -1722,6 +2320,12 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
         /* swap valuestring and string, because we parsed the name */
         current_item->string = current_item->valuestring;
         current_item->valuestring = NULL;
+        current_item->string_hash = cJSON_HashKey(current_item->string);
+        if (input_buffer->in_situ)
+        {
+            /* keys point into the input buffer, keep cJSON_Delete away from them */
+            current_item->type = cJSON_StringIsConst;
+        }
 
         if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
         {
@@ -1735,6 +2339,11 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
         {
             goto fail; /* failed to parse value */
         }
+        if (input_buffer->in_situ)
+        {
+            /* parse_value resets the type */
+            current_item->type |= cJSON_StringIsConst;
+        }
         buffer_skip_whitespace(input_buffer);
     }
     while (can_access_at_index(input_buffer, 0) && (buffer_at_offset(input_buffer)[0] == ','));
@@ -1975,6 +2584,53 @@ CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const objec
     return get_object_item(object, string, true);
 }
 
+/* 32 bit FNV-1a, never 0 so that 0 can mean "not computed" */
+CJSON_PUBLIC(unsigned int) cJSON_HashKey(const char *string)
+{
+    const unsigned char *pointer = (const unsigned char*)string;
+    unsigned int hash = 2166136261u;
+
+    if (string == NULL)
+    {
+        return 0;
+    }
+    while (*pointer != '\0')
+    {
+        hash ^= *pointer++;
+        hash *= 16777619u;
+    }
+    return (hash != 0) ? hash : 1;
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemHashed(const cJSON * const object, const char * const string, unsigned int hash)
+{
+    cJSON *current_element = NULL;
+
+    if ((object == NULL) || (string == NULL))
+    {
+        return NULL;
+    }
+
+    for (current_element = object->child; current_element != NULL; current_element = current_element->next)
+    {
+        if (current_element->string == NULL)
+        {
+            continue;
+        }
+        if (current_element->string_hash == 0)
+        {
+            /* keys set outside the parser are hashed on first lookup */
+            current_element->string_hash = cJSON_HashKey(current_element->string);
+        }
+        if ((current_element->string_hash == hash) && (strcmp(string, current_element->string) == 0))
+        {
+            return current_element;
+        }
+    }
+
+    return NULL;
+}
+
 CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string)
 {
     return cJSON_GetObjectItem(object, string) ? 1 : 0;
@@ -2004,6 +2660,7 @@ static cJSON *create_reference(const cJSON *item, const internal_hooks * const h
 
     memcpy(reference, item, sizeof(cJSON));
     reference->string = NULL;
+    reference->string_hash = 0;
     reference->type |= cJSON_IsReference;
     reference->next = reference->prev = NULL;
     return reference;
@@ -2096,6 +2753,7 @@ static cJSON_bool add_item_to_object(cJSON * const object, const char * const st
     }
 
     item->string = new_key;
+    item->string_hash = 0;
     item->type = new_type;
 
     return add_item_to_array(object, item);
@@ -2422,6 +3080,7 @@ static cJSON_bool replace_item_in_object(cJSON *object, const char *string, cJSO
         cJSON_free(replacement->string);
     }
     replacement->string = (char*)cJSON_strdup((const unsigned char*)string, &global_hooks);
+    replacement->string_hash = 0;
     if (replacement->string == NULL)
     {
         return false;
@@ -2790,10 +3449,12 @@ cJSON * cJSON_Duplicate_rec(const cJSON *item, size_t depth, cJSON_bool recurse)
         goto fail;
     }
     /* Copy over all vars */
-    newitem->type = item->type & (~cJSON_IsReference);
+    /* keys are always copied: const keys may point into an in-situ parse buffer owned by the source tree */
+    newitem->type = item->type & (~(cJSON_IsReference | cJSON_StringIsConst));
     newitem->valueint = item->valueint;
     newitem->valuedouble = item->valuedouble;
-    if (item->valuestring)
+    /* on arrays and objects valuestring can only be an in-situ parse buffer, which is not copied */
+    if (item->valuestring && !cJSON_IsArray(item) && !cJSON_IsObject(item))
     {
         newitem->valuestring = (char*)cJSON_strdup((unsigned char*)item->valuestring, &global_hooks);
         if (!newitem->valuestring)
@@ -2803,7 +3464,8 @@ cJSON * cJSON_Duplicate_rec(const cJSON *item, size_t depth, cJSON_bool recurse)
     }
     if (item->string)
     {
-        newitem->string = (item->type&cJSON_StringIsConst) ? item->string : (char*)cJSON_strdup((unsigned char*)item->string, &global_hooks);
+        newitem->string = (char*)cJSON_strdup((unsigned char*)item->string, &global_hooks);
+        newitem->string_hash = item->string_hash;
         if (!newitem->string)
         {
             goto fail;
@@ -115,6 +115,8 @@ typedef struct cJSON
     char *valuestring;
     /* writing to valueint is DEPRECATED, use cJSON_SetNumberValue instead */
     int valueint;
+    /* cJSON_HashKey(string), 0 while not yet computed; sits in what was padding */
+    unsigned int string_hash;
     /* The item's number, if type==cJSON_Number */
     double valuedouble;
 
@@ -157,6 +159,15 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_len
 /* If you supply a ptr in return_parse_end and parsing fails, then return_parse_end will contain a pointer to the error so will match cJSON_GetErrorPtr(). */
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated);
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated);
+/* ParseInSitu unescapes strings inside buffer and points the tree at it instead of copying them.
+ * buffer must come from the cJSON allocator; ownership passes to the returned root (or it is freed on failure).
+ * Items detached from the tree must not outlive the root. */
+CJSON_PUBLIC(cJSON *) cJSON_ParseInSitu(char *buffer, size_t buffer_length);
+
+/* Writes number the way cJSON prints it (a form that reads back as the same double, "null" for NaN and infinity)
+ * into buffer, which must hold CJSON_NUMBER_BUFFER_SIZE bytes. Returns the length without terminator. */
+#define CJSON_NUMBER_BUFFER_SIZE 32
+CJSON_PUBLIC(int) cJSON_FormatNumber(double number, char *buffer);
 
 /* Render a cJSON entity to text for transfer/storage. */
 CJSON_PUBLIC(char *) cJSON_Print(const cJSON *item);
@@ -177,6 +188,10 @@ CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index);
 /* Get item "string" from object. Case insensitive. */
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItem(const cJSON * const object, const char * const string);
 CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemCaseSensitive(const cJSON * const object, const char * const string);
+/* Case sensitive lookup that compares key hashes before strings. hash must be cJSON_HashKey(string),
+ * so callers looking up the same keys repeatedly can compute it once. */
+CJSON_PUBLIC(unsigned int) cJSON_HashKey(const char *string);
+CJSON_PUBLIC(cJSON *) cJSON_GetObjectItemHashed(const cJSON * const object, const char * const string, unsigned int hash);
 CJSON_PUBLIC(cJSON_bool) cJSON_HasObjectItem(const cJSON *object, const char *string);
 /* For analysing failed parses. This returns a pointer to the parse error. You'll probably need to look a few chars back to make sense of it. Defined when cJSON_Parse() returns 0. 0 when cJSON_Parse() succeeds. */
 CJSON_PUBLIC(const char *) cJSON_GetErrorPtr(void);
@@ -24,6 +24,9 @@
 #define ACTION_GET_ROOM_STATS "GET_ROOM_STATS"
 #define ACTION_CLOSE_ROOM "CLOSE_ROOM"
 #define ACTION_DELETE_ROOM "DELETE_ROOM"
+#define ACTION_SUBMIT_RESULT "SUBMIT_RESULT"
+#define ACTION_GET_SERVER_STATS "GET_SERVER_STATS"
+#define ACTION_GET_LEADERBOARD "GET_LEADERBOARD"
 
 // JSON Field Keys
 #define JSON_KEY_ACTION "action"
@@ -32,6 +35,67 @@
 #define JSON_KEY_PASSWORD "password"
 #define JSON_KEY_STATUS "status"
 #define JSON_KEY_MESSAGE "message"
+#define JSON_KEY_ID "id"
+#define JSON_KEY_NAME "name"
+#define JSON_KEY_ROOM_ID "room_id"
+#define JSON_KEY_ROOM_NAME "room_name"
+#define JSON_KEY_START_TIME "start_time"
+#define JSON_KEY_END_TIME "end_time"
+#define JSON_KEY_QUESTION_BANK_ID "question_bank_id"
+#define JSON_KEY_NUM_QUESTIONS "num_questions"
+#define JSON_KEY_ALLOWED_ATTEMPTS "allowed_attempts"
+#define JSON_KEY_BANK_ID "bank_id"
+#define JSON_KEY_BANK_NAME "bank_name"
+#define JSON_KEY_QUESTIONS "questions"
+#define JSON_KEY_QUESTION "question"
+#define JSON_KEY_OPTIONS "options"
+#define JSON_KEY_CORRECT_INDEX "correct_index"
+#define JSON_KEY_ANSWERS "answers"
+#define JSON_KEY_SCORE "score"
+#define JSON_KEY_TIMESTAMP "timestamp"
+#define JSON_KEY_SEQ "seq"
+#define JSON_KEY_INCLUDE_RESULTS "include_results"
+#define JSON_KEY_LIMIT "limit"
+#define JSON_KEY_AROUND "around"
+#define JSON_KEY_CURSOR "cursor"
+#define JSON_KEY_NEXT_CURSOR "next_cursor"
+#define JSON_KEY_FROM "from"
+#define JSON_KEY_TO "to"
+#define JSON_KEY_ORDER "order"
+#define JSON_KEY_ROLE "role"
+
+// Keys the server looks up by precomputed hash (server/include/json_keys.h)
+#define PROTOCOL_KEY_LIST(X)                          \
+    X(KEY_ACTION, JSON_KEY_ACTION)                    \
+    X(KEY_DATA, JSON_KEY_DATA)                        \
+    X(KEY_USERNAME, JSON_KEY_USERNAME)                \
+    X(KEY_PASSWORD, JSON_KEY_PASSWORD)                \
+    X(KEY_STATUS, JSON_KEY_STATUS)                    \
+    X(KEY_ID, JSON_KEY_ID)                            \
+    X(KEY_NAME, JSON_KEY_NAME)                        \
+    X(KEY_ROOM_ID, JSON_KEY_ROOM_ID)                  \
+    X(KEY_ROOM_NAME, JSON_KEY_ROOM_NAME)              \
+    X(KEY_START_TIME, JSON_KEY_START_TIME)            \
+    X(KEY_END_TIME, JSON_KEY_END_TIME)                \
+    X(KEY_QUESTION_BANK_ID, JSON_KEY_QUESTION_BANK_ID) \
+    X(KEY_NUM_QUESTIONS, JSON_KEY_NUM_QUESTIONS)      \
+    X(KEY_ALLOWED_ATTEMPTS, JSON_KEY_ALLOWED_ATTEMPTS) \
+    X(KEY_BANK_ID, JSON_KEY_BANK_ID)                  \
+    X(KEY_BANK_NAME, JSON_KEY_BANK_NAME)              \
+    X(KEY_QUESTIONS, JSON_KEY_QUESTIONS)              \
+    X(KEY_CORRECT_INDEX, JSON_KEY_CORRECT_INDEX)      \
+    X(KEY_ANSWERS, JSON_KEY_ANSWERS)                  \
+    X(KEY_SCORE, JSON_KEY_SCORE)                      \
+    X(KEY_TIMESTAMP, JSON_KEY_TIMESTAMP)              \
+    X(KEY_SEQ, JSON_KEY_SEQ)                          \
+    X(KEY_INCLUDE_RESULTS, JSON_KEY_INCLUDE_RESULTS) \
+    X(KEY_LIMIT, JSON_KEY_LIMIT)                      \
+    X(KEY_AROUND, JSON_KEY_AROUND)                    \
+    X(KEY_CURSOR, JSON_KEY_CURSOR)                    \
+    X(KEY_FROM, JSON_KEY_FROM)                        \
+    X(KEY_TO, JSON_KEY_TO)                            \
+    X(KEY_ORDER, JSON_KEY_ORDER)                      \
+    X(KEY_ROLE, JSON_KEY_ROLE)
 
 // Fixed header size = 4 bytes length + 3 bytes type = 7 bytes
 // Fixed header size = 4 bytes length + 3 bytes type = 7 bytes
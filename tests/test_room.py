@@ -1,7 +1,87 @@
+import os
+import shutil
+import signal
 import socket
+import subprocess
+import sys
+import tempfile
 import time
 import json
-from utils import send_packet, receive_packet, PORT
+from utils import send_packet, receive_packet, PORT, SERVER_BIN
+
+def request(s, action, data=None):
+    payload = {"action": action}
+    if data is not None:
+        payload["data"] = data
+    send_packet(s, "REQ", payload)
+    return receive_packet(s)
+
+def connect_as(username, password, port=PORT, register=False):
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.connect(('127.0.0.1', port))
+    if register:
+        request(s, "REGISTER", {"username": username, "password": password})
+    type, resp = request(s, "LOGIN", {"username": username, "password": password})
+    if type != "RES" or resp["status"] != "SUCCESS":
+        raise Exception(f"Login as {username} failed: {resp}")
+    return s
+
+def start_server(workdir, port):
+    # Own data directory, so the shared server's files are left alone
+    env = dict(os.environ, QUIZZIE_SNAPSHOT_MS="200")
+    proc = subprocess.Popen([os.path.abspath(SERVER_BIN), str(port)], cwd=workdir, env=env,
+                            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    time.sleep(0.5)
+    if proc.poll() is not None:
+        raise Exception(f"Server in {workdir} failed to start")
+    return proc
+
+def test_restart_recovery():
+    workdir = tempfile.mkdtemp()
+    os.makedirs(os.path.join(workdir, "data"))
+    with open(os.path.join(workdir, "data", "users.txt"), "w") as f:
+        f.write("admin:admin:admin\n")
+    port = PORT + 1
+    proc = start_server(workdir, port)
+    try:
+        admin = connect_as("admin", "admin", port)
+        questions = [{"question": f"Q{i}", "options": ["A", "B"], "correct_index": i % 2} for i in range(4)]
+        request(admin, "IMPORT_QUESTIONS", {"bank_name": "restart_bank", "questions": questions})
+        request(admin, "CREATE_ROOM", {"room_name": "Restart", "question_bank_id": "restart_bank",
+                                       "start_time": int(time.time()) - 10, "end_time": int(time.time()) + 3600,
+                                       "num_questions": 4, "allowed_attempts": 0})
+        room_id = request(admin, "LIST_ROOMS")[1]["data"][0]["id"]
+        players = [connect_as(f"r{i}", "pw", port, register=True) for i in range(3)]
+
+        # The first results go into a snapshot, the rest stay in the journal
+        for i, p in enumerate(players):
+            request(p, "SUBMIT_RESULT", {"room_id": room_id, "answers": [0, 1, 0, 1][:i + 1]})
+        time.sleep(1)
+        for i, p in enumerate(players):
+            request(p, "SUBMIT_RESULT", {"room_id": room_id, "answers": [1, 1, 0, 1][:4 - i]})
+
+        before_stats = request(admin, "GET_ROOM_STATS", {"room_id": room_id})[1]["data"]
+        before_board = request(admin, "GET_LEADERBOARD", {"room_id": room_id, "username": "r1"})[1]["data"]
+        if before_stats["stats"]["total_attempts"] != 6 or before_board["total"] != 3:
+            raise Exception(f"Unexpected state before restart: {before_stats['stats']} {before_board}")
+
+        # No shutdown snapshot: whatever came after the last one is replayed
+        proc.send_signal(signal.SIGKILL)
+        proc.wait()
+        proc = start_server(workdir, port)
+
+        admin = connect_as("admin", "admin", port)
+        after_stats = request(admin, "GET_ROOM_STATS", {"room_id": room_id})[1]["data"]
+        after_board = request(admin, "GET_LEADERBOARD", {"room_id": room_id, "username": "r1"})[1]["data"]
+        if after_stats != before_stats:
+            raise Exception(f"Room stats changed across restart: {before_stats} -> {after_stats}")
+        if after_board != before_board:
+            raise Exception(f"Leaderboard changed across restart: {before_board} -> {after_board}")
+        connect_as("r2", "pw", port).close()
+    finally:
+        proc.terminate()
+        proc.wait()
+        shutil.rmtree(workdir, ignore_errors=True)
 
 def test_room_flow():
     # 1. Admin Login
@@ -209,6 +289,74 @@ def test_room_flow():
     else:
         print(f"FAIL: Get room stats failed: {resp}")
 
+    # --- Test Submit Result ---
+    print("--- Testing Submit Result ---")
+    # The bank now holds only "2+2=?", answer index 1, so each attempt scores out of 1
+    suffix = int(time.time())
+    names = [f"p{i}_{suffix}" for i in range(3)]
+    players = [connect_as(name, "pw", register=True) for name in names]
+    for player, answers in zip(players, [[1], [0], [1, 0]]):
+        type, resp = request(player, "SUBMIT_RESULT", {"room_id": room_id, "answers": answers})
+        if type != "RES" or resp["status"] != "SUCCESS":
+            raise Exception(f"Submit result failed: {resp}")
+        expected = 1 if answers[0] == 1 else 0
+        if resp["data"] != {"score": expected, "total": 1}:
+            raise Exception(f"Wrong grade for {answers}: {resp['data']}")
+    print("PASS: Submit result graded")
+
+    # allowed_attempts is 3, so the first player's fourth attempt is refused
+    for _ in range(2):
+        type, resp = request(players[0], "SUBMIT_RESULT", {"room_id": room_id, "answers": [0]})
+        if type != "RES" or resp["data"]["score"] != 0:
+            raise Exception(f"Submit result failed: {resp}")
+    type, resp = request(players[0], "SUBMIT_RESULT", {"room_id": room_id, "answers": [1]})
+    if type != "ERR" or resp.get("message") != "No attempts left":
+        raise Exception(f"Expected 'No attempts left', got {type} {resp}")
+    print("PASS: Attempts limited")
+
+    type, resp = request(s, "GET_ROOM_STATS", {"room_id": room_id})
+    stats = resp["data"]["stats"]
+    if stats["total_attempts"] != 5 or stats["max_score"] != 1 or stats["min_score"] != 0:
+        raise Exception(f"Room stats do not match the attempts: {stats}")
+    print("PASS: Room stats follow submissions")
+
+    # --- Test Leaderboard ---
+    print("--- Testing Leaderboard ---")
+    # Best attempt per player, ties broken by who submitted first: p0, p2, p1
+    type, resp = request(players[0], "GET_LEADERBOARD", {"room_id": room_id, "limit": 2, "around": 1})
+    board = resp["data"]
+    if board["total"] != 3 or [e["username"] for e in board["top"]] != [names[0], names[2]]:
+        raise Exception(f"Unexpected leaderboard top: {board}")
+    if board["me"]["rank"] != 1 or [e["rank"] for e in board["around"]] != [1, 2]:
+        raise Exception(f"Unexpected leaderboard window: {board}")
+
+    # A participant only gets their own position
+    type, resp = request(players[1], "GET_LEADERBOARD", {"room_id": room_id, "around": 1, "username": names[0]})
+    if type != "ERR" or resp.get("message") != "Permission denied":
+        raise Exception(f"A participant looked up another position: {type} {resp}")
+    type, resp = request(players[1], "GET_LEADERBOARD", {"room_id": room_id, "around": 1})
+    board = resp["data"]
+    if board["me"]["username"] != names[1] or board["me"]["rank"] != 3 or board["me"]["score"] != 0:
+        raise Exception(f"Unexpected own position: {board}")
+    if [e["username"] for e in board["around"]] != [names[2], names[1]]:
+        raise Exception(f"Unexpected window around the last rank: {board}")
+
+    # The admin has no attempts, so only the top comes back unless they ask for someone
+    type, resp = request(s, "GET_LEADERBOARD", {"room_id": room_id})
+    if "me" in resp["data"] or len(resp["data"]["top"]) != 3:
+        raise Exception(f"Unexpected admin leaderboard: {resp['data']}")
+    type, resp = request(s, "GET_LEADERBOARD", {"room_id": room_id, "username": names[2]})
+    if resp["data"]["me"]["username"] != names[2] or resp["data"]["me"]["rank"] != 2:
+        raise Exception(f"Admin lookup of {names[2]} failed: {resp['data']}")
+    print("PASS: Leaderboard windows")
+    for player in players:
+        player.close()
+
+    # --- Test Restart Recovery ---
+    print("--- Testing Restart Recovery ---")
+    test_restart_recovery()
+    print("PASS: Stats and leaderboard recovered from snapshot and journal")
+
     # Note: CLOSE_ROOM is removed (auto status).
 
     # --- Test Delete Room ---
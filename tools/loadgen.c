@@ -0,0 +1,750 @@
+#define _GNU_SOURCE
+#include "cJSON.h"
+#include "protocol.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 1024
+#define RECV_CHUNK 65536
+#define HIST_SUB_BUCKETS 32
+#define HIST_BUCKETS (40 * HIST_SUB_BUCKETS)
+
+typedef enum {
+    OP_LOGIN,
+    OP_LIST_ROOMS,
+    OP_GET_BANK,
+    OP_SUBMIT,
+    OP_COUNT
+} Op;
+
+static const char* op_names[OP_COUNT] = { "login", "list_rooms", "get_bank", "submit" };
+
+typedef enum {
+    SIM_IDLE,
+    SIM_CONNECTING,
+    SIM_REGISTERING,
+    SIM_WAITING,
+    SIM_THINKING
+} SimState;
+
+typedef struct
+{
+    int fd;
+    int id;
+    int is_admin;
+    SimState state;
+    int scheduled;
+    Op op;
+    uint64_t op_start;
+    uint64_t wake_at;
+
+    char* out;
+    size_t out_len;
+    size_t out_sent;
+
+    char* in;
+    size_t in_len;
+    size_t in_cap;
+} Sim;
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t errors;
+    uint64_t max_us;
+    uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+typedef struct
+{
+    const char* host;
+    int port;
+    int clients;
+    int admins;
+    int duration_s;
+    int ramp_s;
+    int think_ms;
+    int register_users;
+    int num_answers;
+    const char* user_prefix;
+    const char* password;
+    const char* room_id;
+    const char* bank_id;
+    const char* stats_account;
+    int mix[OP_COUNT];
+} Options;
+
+static Options opts = {
+    .host = "127.0.0.1",
+    .port = 8080,
+    .clients = 1000,
+    .admins = 0,
+    .duration_s = 30,
+    .ramp_s = 5,
+    .think_ms = 100,
+    .register_users = 0,
+    .num_answers = 10,
+    .user_prefix = "load",
+    .password = "load",
+    .room_id = NULL,
+    .bank_id = NULL,
+    .stats_account = NULL,
+    .mix = { 1, 5, 1, 2 },
+};
+
+static Sim* sims;
+static Histogram hist[OP_COUNT];
+static int epfd;
+static struct sockaddr_in server_addr;
+static volatile sig_atomic_t stop_requested = 0;
+
+// Min-heap of sims ordered by wake_at
+static int* timer_heap;
+static int timer_count = 0;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void on_sigint(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+// Log-linear buckets: 32 sub-buckets per power of two, ~3% precision
+static int hist_index(uint64_t v)
+{
+    if (v < 2 * HIST_SUB_BUCKETS)
+        return (int)v;
+    int shift = 63 - __builtin_clzll(v) - 5;
+    int idx = shift * HIST_SUB_BUCKETS + (int)(v >> shift);
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+static uint64_t hist_value(int idx)
+{
+    if (idx < 2 * HIST_SUB_BUCKETS)
+        return (uint64_t)idx;
+    int shift = idx / HIST_SUB_BUCKETS - 1;
+    uint64_t mantissa = (uint64_t)(idx % HIST_SUB_BUCKETS) + HIST_SUB_BUCKETS;
+    return mantissa << shift;
+}
+
+static void hist_record(Histogram* h, uint64_t v)
+{
+    h->count++;
+    h->buckets[hist_index(v)]++;
+    if (v > h->max_us)
+        h->max_us = v;
+}
+
+static double hist_percentile(const Histogram* h, double p)
+{
+    if (h->count == 0)
+        return 0;
+    uint64_t target = (uint64_t)ceil(h->count * p);
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= target)
+            return hist_value(i) / 1000.0;
+    }
+    return h->max_us / 1000.0;
+}
+
+static void timer_swap(int a, int b)
+{
+    int tmp = timer_heap[a];
+    timer_heap[a] = timer_heap[b];
+    timer_heap[b] = tmp;
+}
+
+static void timer_push(Sim* sim, uint64_t at)
+{
+    if (sim->scheduled)
+        return;
+    sim->scheduled = 1;
+    sim->wake_at = at;
+    int i = timer_count++;
+    timer_heap[i] = sim->id;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (sims[timer_heap[parent]].wake_at <= sims[timer_heap[i]].wake_at)
+            break;
+        timer_swap(i, parent);
+        i = parent;
+    }
+}
+
+static Sim* timer_pop_due(uint64_t now)
+{
+    if (timer_count == 0 || sims[timer_heap[0]].wake_at > now)
+        return NULL;
+
+    Sim* sim = &sims[timer_heap[0]];
+    sim->scheduled = 0;
+    timer_heap[0] = timer_heap[--timer_count];
+    int i = 0;
+    while (1) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < timer_count && sims[timer_heap[l]].wake_at < sims[timer_heap[m]].wake_at)
+            m = l;
+        if (r < timer_count && sims[timer_heap[r]].wake_at < sims[timer_heap[m]].wake_at)
+            m = r;
+        if (m == i)
+            break;
+        timer_swap(i, m);
+        i = m;
+    }
+    return sim;
+}
+
+static void sim_username(const Sim* sim, char* out, size_t len)
+{
+    snprintf(out, len, "%s%s%d", opts.user_prefix, sim->is_admin ? "_admin" : "_", sim->id);
+}
+
+// Serializes a request with its 7-byte frame header into sim->out
+static void sim_queue(Sim* sim, const char* action, cJSON* data)
+{
+    cJSON* req = cJSON_CreateObject();
+    cJSON_AddStringToObject(req, JSON_KEY_ACTION, action);
+    if (data)
+        cJSON_AddItemToObject(req, JSON_KEY_DATA, data);
+    char* json = cJSON_PrintUnformatted(req);
+    cJSON_Delete(req);
+
+    size_t payload_len = strlen(json);
+    free(sim->out);
+    sim->out = malloc(HEADER_SIZE + payload_len);
+    PacketHeader header;
+    header.total_length = htonl((uint32_t)(HEADER_SIZE + payload_len));
+    memcpy(header.msg_type, MSG_TYPE_REQ, 3);
+    memcpy(sim->out, &header, HEADER_SIZE);
+    memcpy(sim->out + HEADER_SIZE, json, payload_len);
+    sim->out_len = HEADER_SIZE + payload_len;
+    sim->out_sent = 0;
+    free(json);
+}
+
+static cJSON* credentials(const Sim* sim)
+{
+    char username[64];
+    sim_username(sim, username, sizeof(username));
+    cJSON* data = cJSON_CreateObject();
+    cJSON_AddStringToObject(data, JSON_KEY_USERNAME, username);
+    cJSON_AddStringToObject(data, JSON_KEY_PASSWORD, opts.password);
+    return data;
+}
+
+static void sim_flush(Sim* sim);
+static void sim_close(Sim* sim);
+
+static Op pick_op(const Sim* sim)
+{
+    int weights[OP_COUNT];
+    int total = 0;
+    for (int i = 0; i < OP_COUNT; i++) {
+        weights[i] = opts.mix[i];
+        if (i == OP_GET_BANK && (!sim->is_admin || !opts.bank_id))
+            weights[i] = 0;
+        if (i == OP_SUBMIT && (sim->is_admin || !opts.room_id))
+            weights[i] = 0;
+        total += weights[i];
+    }
+    if (total == 0)
+        return OP_LIST_ROOMS;
+
+    int r = rand() % total;
+    for (int i = 0; i < OP_COUNT; i++) {
+        if (r < weights[i])
+            return (Op)i;
+        r -= weights[i];
+    }
+    return OP_LIST_ROOMS;
+}
+
+static void sim_connect(Sim* sim)
+{
+    sim->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sim->fd < 0) {
+        hist[sim->op].errors++;
+        timer_push(sim, now_us() + 1000000);
+        sim->state = SIM_THINKING;
+        return;
+    }
+    int one = 1;
+    setsockopt(sim->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sim->in_len = 0;
+    sim->state = SIM_CONNECTING;
+    int rc = connect(sim->fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
+    if (rc < 0 && errno != EINPROGRESS) {
+        hist[sim->op].errors++;
+        sim_close(sim);
+        return;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.u32 = (uint32_t)sim->id };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sim->fd, &ev);
+}
+
+static void sim_start_op(Sim* sim, Op op)
+{
+    sim->op = op;
+    sim->op_start = now_us();
+
+    switch (op) {
+    case OP_LOGIN:
+        // A fresh login needs a fresh connection, the server kicks duplicate sessions
+        if (sim->fd >= 0) {
+            epoll_ctl(epfd, EPOLL_CTL_DEL, sim->fd, NULL);
+            close(sim->fd);
+            sim->fd = -1;
+        }
+        if (opts.register_users)
+            sim_queue(sim, ACTION_REGISTER, credentials(sim));
+        else
+            sim_queue(sim, ACTION_LOGIN, credentials(sim));
+        sim_connect(sim);
+        return;
+    case OP_LIST_ROOMS:
+        sim_queue(sim, ACTION_LIST_ROOMS, NULL);
+        break;
+    case OP_GET_BANK: {
+        cJSON* data = cJSON_CreateObject();
+        cJSON_AddStringToObject(data, "bank_id", opts.bank_id);
+        sim_queue(sim, ACTION_GET_QUESTION_BANK, data);
+        break;
+    }
+    case OP_SUBMIT: {
+        cJSON* data = cJSON_CreateObject();
+        cJSON_AddStringToObject(data, "room_id", opts.room_id);
+        cJSON* answers = cJSON_AddArrayToObject(data, "answers");
+        for (int i = 0; i < opts.num_answers; i++)
+            cJSON_AddItemToArray(answers, cJSON_CreateNumber(rand() % 4));
+        sim_queue(sim, ACTION_SUBMIT_RESULT, data);
+        break;
+    }
+    default:
+        break;
+    }
+    sim->state = SIM_WAITING;
+    sim_flush(sim);
+}
+
+static void sim_close(Sim* sim)
+{
+    if (sim->fd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, sim->fd, NULL);
+        close(sim->fd);
+        sim->fd = -1;
+    }
+    // Retry with a new login after a back-off
+    sim->state = SIM_IDLE;
+    timer_push(sim, now_us() + 1000000);
+}
+
+static void sim_think(Sim* sim)
+{
+    sim->state = SIM_THINKING;
+    uint64_t jitter = opts.think_ms > 0 ? (uint64_t)(rand() % (opts.think_ms * 2 + 1)) : 0;
+    timer_push(sim, now_us() + jitter * 1000);
+}
+
+static void sim_flush(Sim* sim)
+{
+    while (sim->out_sent < sim->out_len) {
+        ssize_t n = send(sim->fd, sim->out + sim->out_sent, sim->out_len - sim->out_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            hist[sim->op].errors++;
+            sim_close(sim);
+            return;
+        }
+        sim->out_sent += (size_t)n;
+    }
+
+    uint32_t events = EPOLLIN | (sim->out_sent < sim->out_len ? EPOLLOUT : 0);
+    struct epoll_event ev = { .events = events, .data.u32 = (uint32_t)sim->id };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, sim->fd, &ev);
+}
+
+static void sim_on_response(Sim* sim, const char* msg_type)
+{
+    int ok = strncmp(msg_type, MSG_TYPE_RES, 3) == 0;
+
+    if (sim->state == SIM_REGISTERING) {
+        // "Username already exists" is fine, the account is there either way
+        sim->state = SIM_WAITING;
+        sim->op_start = now_us();
+        sim_queue(sim, ACTION_LOGIN, credentials(sim));
+        sim_flush(sim);
+        return;
+    }
+    if (sim->state != SIM_WAITING)
+        return;
+
+    if (ok)
+        hist_record(&hist[sim->op], now_us() - sim->op_start);
+    else
+        hist[sim->op].errors++;
+
+    if (sim->op == OP_LOGIN && !ok) {
+        sim_close(sim);
+        return;
+    }
+    sim_think(sim);
+}
+
+static void sim_on_readable(Sim* sim)
+{
+    while (1) {
+        if (sim->in_cap - sim->in_len < RECV_CHUNK) {
+            sim->in_cap = sim->in_cap ? sim->in_cap * 2 : RECV_CHUNK * 2;
+            sim->in = realloc(sim->in, sim->in_cap);
+        }
+        ssize_t n = recv(sim->fd, sim->in + sim->in_len, sim->in_cap - sim->in_len, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            hist[sim->op].errors++;
+            sim_close(sim);
+            return;
+        }
+        if (n < 0)
+            break;
+        sim->in_len += (size_t)n;
+    }
+
+    size_t offset = 0;
+    while (sim->in_len - offset >= HEADER_SIZE) {
+        PacketHeader header;
+        memcpy(&header, sim->in + offset, HEADER_SIZE);
+        uint32_t total = ntohl(header.total_length);
+        if (total < HEADER_SIZE || total > HEADER_SIZE + MAX_PAYLOAD_SIZE) {
+            hist[sim->op].errors++;
+            sim_close(sim);
+            return;
+        }
+        if (sim->in_len - offset < total)
+            break;
+
+        char msg_type[4] = { header.msg_type[0], header.msg_type[1], header.msg_type[2], '\0' };
+        offset += total;
+        sim_on_response(sim, msg_type);
+        if (sim->fd < 0)
+            return;
+    }
+    memmove(sim->in, sim->in + offset, sim->in_len - offset);
+    sim->in_len -= offset;
+}
+
+static void sim_on_event(Sim* sim, uint32_t events)
+{
+    if (sim->state == SIM_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(sim->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+            hist[OP_LOGIN].errors++;
+            sim_close(sim);
+            return;
+        }
+        sim->state = opts.register_users ? SIM_REGISTERING : SIM_WAITING;
+        sim_flush(sim);
+        return;
+    }
+
+    if (events & EPOLLOUT)
+        sim_flush(sim);
+    if (sim->fd >= 0 && (events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+        sim_on_readable(sim);
+}
+
+static void print_report(double elapsed_s)
+{
+    printf("\n%-12s %10s %8s %10s %9s %9s %9s %9s\n", "action", "ok", "errors", "ops/s", "p50_ms", "p99_ms",
+           "p999_ms", "max_ms");
+    for (int i = 0; i < OP_COUNT; i++) {
+        const Histogram* h = &hist[i];
+        printf("%-12s %10llu %8llu %10.1f %9.3f %9.3f %9.3f %9.3f\n", op_names[i], (unsigned long long)h->count,
+               (unsigned long long)h->errors, h->count / elapsed_s, hist_percentile(h, 0.50),
+               hist_percentile(h, 0.99), hist_percentile(h, 0.999), h->max_us / 1000.0);
+    }
+}
+
+static int read_full(int fd, void* buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = recv(fd, (char*)buf + done, len - done, 0);
+        if (n <= 0)
+            return -1;
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// Blocking request/response used outside the event loop
+static cJSON* blocking_request(int fd, Sim* scratch, const char* action, cJSON* data)
+{
+    sim_queue(scratch, action, data);
+    if (send(fd, scratch->out, scratch->out_len, MSG_NOSIGNAL) != (ssize_t)scratch->out_len)
+        return NULL;
+
+    PacketHeader header;
+    if (read_full(fd, &header, HEADER_SIZE) < 0)
+        return NULL;
+    uint32_t payload_len = ntohl(header.total_length) - HEADER_SIZE;
+    char* payload = malloc(payload_len + 1);
+    if (!payload || read_full(fd, payload, payload_len) < 0) {
+        free(payload);
+        return NULL;
+    }
+    payload[payload_len] = '\0';
+    cJSON* resp = cJSON_Parse(payload);
+    free(payload);
+    return resp;
+}
+
+// Logs in with "user:password" and prints the server's GET_SERVER_STATS data
+static void print_server_stats(const char* account)
+{
+    char username[64];
+    const char* colon = strchr(account, ':');
+    if (!colon || (size_t)(colon - account) >= sizeof(username)) {
+        fprintf(stderr, "Stats account must be user:password\n");
+        return;
+    }
+    memcpy(username, account, colon - account);
+    username[colon - account] = '\0';
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("stats connect");
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+
+    Sim scratch;
+    memset(&scratch, 0, sizeof(scratch));
+    cJSON* login = cJSON_CreateObject();
+    cJSON_AddStringToObject(login, JSON_KEY_USERNAME, username);
+    cJSON_AddStringToObject(login, JSON_KEY_PASSWORD, colon + 1);
+    cJSON_Delete(blocking_request(fd, &scratch, ACTION_LOGIN, login));
+
+    cJSON* resp = blocking_request(fd, &scratch, ACTION_GET_SERVER_STATS, NULL);
+    cJSON* data = cJSON_GetObjectItem(resp, JSON_KEY_DATA);
+    if (data) {
+        char* text = cJSON_Print(data);
+        printf("\nserver stats:\n%s\n", text);
+        free(text);
+    } else {
+        fprintf(stderr, "GET_SERVER_STATS failed\n");
+    }
+    cJSON_Delete(resp);
+    free(scratch.out);
+    close(fd);
+}
+
+static int parse_mix(const char* spec)
+{
+    char* copy = strdup(spec);
+    int mix[OP_COUNT] = { 0 };
+    int rc = 0;
+    for (char* tok = strtok(copy, ","); tok; tok = strtok(NULL, ",")) {
+        char* eq = strchr(tok, '=');
+        if (!eq) {
+            rc = -1;
+            break;
+        }
+        *eq = '\0';
+        int found = 0;
+        for (int i = 0; i < OP_COUNT; i++) {
+            if (strcmp(tok, op_names[i]) == 0) {
+                mix[i] = atoi(eq + 1);
+                found = 1;
+            }
+        }
+        if (!found) {
+            rc = -1;
+            break;
+        }
+    }
+    free(copy);
+    if (rc == 0)
+        memcpy(opts.mix, mix, sizeof(mix));
+    return rc;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -H host         server address (default 127.0.0.1)\n"
+            "  -p port         server port (default 8080)\n"
+            "  -c clients      simulated participants (default 1000)\n"
+            "  -a admins       simulated admins (default 0)\n"
+            "  -d seconds      test duration after ramp-up (default 30)\n"
+            "  -r seconds      ramp-up time for connecting all clients (default 5)\n"
+            "  -t ms           mean think time between actions (default 100)\n"
+            "  -m mix          action weights, e.g. login=1,list_rooms=5,get_bank=1,submit=2\n"
+            "  -R room_id      room used by submit\n"
+            "  -B bank_id      bank used by get_bank (admins only)\n"
+            "  -n answers      answers per submission (default 10)\n"
+            "  -u prefix       username prefix (default \"load\")\n"
+            "  -P password     password for all simulated users (default \"load\")\n"
+            "  -g              register users before the first login\n"
+            "  -s user:pass    admin account used to print GET_SERVER_STATS at the end\n",
+            prog);
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:c:a:d:r:t:m:R:B:n:u:P:s:gh")) != -1) {
+        switch (opt) {
+        case 'H': opts.host = optarg; break;
+        case 'p': opts.port = atoi(optarg); break;
+        case 'c': opts.clients = atoi(optarg); break;
+        case 'a': opts.admins = atoi(optarg); break;
+        case 'd': opts.duration_s = atoi(optarg); break;
+        case 'r': opts.ramp_s = atoi(optarg); break;
+        case 't': opts.think_ms = atoi(optarg); break;
+        case 'm':
+            if (parse_mix(optarg) < 0) {
+                fprintf(stderr, "Invalid mix: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'R': opts.room_id = optarg; break;
+        case 'B': opts.bank_id = optarg; break;
+        case 'n': opts.num_answers = atoi(optarg); break;
+        case 'u': opts.user_prefix = optarg; break;
+        case 'P': opts.password = optarg; break;
+        case 'g': opts.register_users = 1; break;
+        case 's': opts.stats_account = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    int total = opts.clients + opts.admins;
+    if (total <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(opts.port);
+    if (inet_pton(AF_INET, opts.host, &server_addr.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid address: %s\n", opts.host);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_sigint);
+    srand((unsigned)time(NULL));
+
+    sims = calloc(total, sizeof(Sim));
+    timer_heap = calloc(total, sizeof(int));
+    epfd = epoll_create1(0);
+    if (!sims || !timer_heap || epfd < 0) {
+        perror("setup");
+        return 1;
+    }
+
+    // Ramp-up: spread the first login of every client evenly over the ramp period
+    uint64_t start = now_us();
+    for (int i = 0; i < total; i++) {
+        sims[i].id = i;
+        sims[i].fd = -1;
+        sims[i].is_admin = i >= opts.clients;
+        sims[i].state = SIM_IDLE;
+        uint64_t offset = opts.ramp_s > 0 ? (uint64_t)opts.ramp_s * 1000000 * i / total : 0;
+        timer_push(&sims[i], start + offset);
+    }
+
+    printf("loadgen: %d participants, %d admins -> %s:%d, ramp %ds, duration %ds\n", opts.clients, opts.admins,
+           opts.host, opts.port, opts.ramp_s, opts.duration_s);
+
+    uint64_t measure_start = start + (uint64_t)opts.ramp_s * 1000000;
+    uint64_t end = measure_start + (uint64_t)opts.duration_s * 1000000;
+    int reset_after_ramp = opts.ramp_s > 0;
+    uint64_t next_progress = start + 1000000;
+    uint64_t last_ops = 0;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!stop_requested) {
+        uint64_t now = now_us();
+        if (now >= end)
+            break;
+
+        // Only steady-state traffic counts towards the report
+        if (reset_after_ramp && now >= measure_start) {
+            memset(hist, 0, sizeof(hist));
+            reset_after_ramp = 0;
+            last_ops = 0;
+        }
+
+        Sim* sim;
+        while ((sim = timer_pop_due(now)) != NULL) {
+            if (sim->state == SIM_IDLE || sim->fd < 0)
+                sim_start_op(sim, OP_LOGIN);
+            else
+                sim_start_op(sim, pick_op(sim));
+        }
+
+        int timeout_ms = 10;
+        if (timer_count > 0) {
+            uint64_t due = sims[timer_heap[0]].wake_at;
+            timeout_ms = due > now ? (int)((due - now) / 1000) : 0;
+            if (timeout_ms > 10)
+                timeout_ms = 10;
+        }
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout_ms);
+        for (int i = 0; i < n; i++)
+            sim_on_event(&sims[events[i].data.u32], events[i].events);
+
+        if (now >= next_progress) {
+            uint64_t ops = 0;
+            int connected = 0;
+            for (int i = 0; i < OP_COUNT; i++)
+                ops += hist[i].count;
+            for (int i = 0; i < total; i++)
+                connected += sims[i].fd >= 0;
+            printf("[%4llus] connected=%d ops/s=%llu\n", (unsigned long long)((now - start) / 1000000), connected,
+                   (unsigned long long)(ops - last_ops));
+            fflush(stdout);
+            last_ops = ops;
+            next_progress += 1000000;
+        }
+    }
+
+    uint64_t measured_from = now_us() > measure_start ? measure_start : start;
+    print_report((now_us() - measured_from) / 1e6);
+    if (opts.stats_account)
+        print_server_stats(opts.stats_account);
+    return 0;
+}